@@ -0,0 +1,253 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* AllocationTracker.cpp                                                */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "AllocationTracker.h"
+
+#ifdef ALLOCATION_TRACKING
+
+// Qt
+#include <QtCore/QtGlobal>
+// OpenCV
+#include <opencv2/core.hpp>
+// C++
+#include <cstdlib>
+#include <new>
+
+using namespace cv;
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+// glibc's allocator (malloc itself is replaced below)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+#define ALLOCATION_TRACKING_MALLOC
+#endif
+
+namespace {
+
+// Plain struct without a constructor: zero-initialized, so it can be used from
+// malloc at any time (even while the thread is being set up)
+thread_local struct AllocationCounts threadAllocations;
+// Nesting depth of AllocationTracker::pause() (nothing is counted while above zero)
+thread_local int pauseDepth;
+
+inline void countHeap(size_t size)
+{
+    if(pauseDepth>0)
+        return;
+    threadAllocations.nHeap++;
+    threadAllocations.heapBytes+=size;
+}
+
+inline void* rawMalloc(size_t size)
+{
+#ifdef ALLOCATION_TRACKING_MALLOC
+    return __libc_malloc(size);
+#else
+    return std::malloc(size);
+#endif
+}
+
+// Counts Mat data (allocated with fastMalloc, not seen by operator new)
+class CountingMatAllocator : public MatAllocator
+{
+    public:
+        UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           AccessFlag flags, UMatUsageFlags usageFlags) const
+        {
+            // Standard allocator owns the data (and frees it: this allocator is never asked to)
+            UMatData *u=Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+            if(u && !data && pauseDepth==0)
+            {
+                threadAllocations.nMat++;
+                threadAllocations.matBytes+=u->size;
+            }
+            return u;
+        }
+
+        bool allocate(UMatData* data, AccessFlag accessflags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+        }
+
+        void deallocate(UMatData* u) const
+        {
+            Mat::getStdAllocator()->deallocate(u);
+        }
+};
+
+}
+
+bool AllocationTracker::isEnabled()
+{
+    return true;
+}
+
+void AllocationTracker::install()
+{
+    static CountingMatAllocator allocator;
+    Mat::setDefaultAllocator(&allocator);
+}
+
+struct AllocationCounts AllocationTracker::threadCounts()
+{
+    return threadAllocations;
+}
+
+void AllocationTracker::charge(const struct AllocationCounts &counts)
+{
+    threadAllocations.nHeap+=counts.nHeap;
+    threadAllocations.heapBytes+=counts.heapBytes;
+    threadAllocations.nMat+=counts.nMat;
+    threadAllocations.matBytes+=counts.matBytes;
+}
+
+void AllocationTracker::pause()
+{
+    pauseDepth++;
+}
+
+void AllocationTracker::resume()
+{
+    pauseDepth--;
+}
+
+// Global operator new/delete (operator new goes to glibc directly, so it is not counted twice by malloc)
+void* operator new(std::size_t size)
+{
+    countHeap(size);
+    void *p=rawMalloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    countHeap(size);
+    return rawMalloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+#endif
+
+#ifdef ALLOCATION_TRACKING_MALLOC
+// malloc used directly (Qt containers, QImage, C libraries)
+extern "C" void* malloc(size_t size) noexcept
+{
+    countHeap(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) noexcept
+{
+    countHeap(n*size);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void *ptr, size_t size) noexcept
+{
+    countHeap(size);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+#else
+
+bool AllocationTracker::isEnabled()
+{
+    return false;
+}
+
+void AllocationTracker::install()
+{
+}
+
+struct AllocationCounts AllocationTracker::threadCounts()
+{
+    struct AllocationCounts counts={0, 0, 0, 0};
+    return counts;
+}
+
+void AllocationTracker::charge(const struct AllocationCounts &counts)
+{
+    Q_UNUSED(counts);
+}
+
+void AllocationTracker::pause()
+{
+}
+
+void AllocationTracker::resume()
+{
+}
+
+#endif
@@ -0,0 +1,117 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* AllocationTracker.h                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+// Qt
+#include <QtCore/QAtomicInteger>
+// Local
+#include "Structures.h"
+
+// Counts the allocations each thread makes, so per-frame allocations on the
+// capture/processing paths can be seen (and kept at zero in steady state).
+// Only compiled in when built with CONFIG+=alloc_tracking (ALLOCATION_TRACKING):
+// global operator new (and malloc on glibc) and the default cv::MatAllocator are
+// then replaced by counting versions. Otherwise all counts stay zero.
+class AllocationTracker
+{
+    public:
+        static bool isEnabled();
+        // Replaces the default Mat allocator (call once at startup, before any thread is started)
+        static void install();
+        // Totals of the calling thread
+        static struct AllocationCounts threadCounts();
+        // Adds allocations made by other threads on behalf of the calling thread
+        static void charge(const struct AllocationCounts &counts);
+        // Stops/restarts counting on the calling thread (nestable)
+        static void pause();
+        static void resume();
+};
+
+// Pauses counting on the calling thread while in scope. Wraps library calls
+// (OpenCV) whose internal scratch allocations this project does not control,
+// so the counts only show allocations made by the project's own code.
+class AllocationTrackerPause
+{
+    public:
+        AllocationTrackerPause() { AllocationTracker::pause(); }
+        ~AllocationTrackerPause() { AllocationTracker::resume(); }
+};
+
+inline struct AllocationCounts operator-(const struct AllocationCounts &a, const struct AllocationCounts &b)
+{
+    struct AllocationCounts difference;
+    difference.nHeap=a.nHeap-b.nHeap;
+    difference.heapBytes=a.heapBytes-b.heapBytes;
+    difference.nMat=a.nMat-b.nMat;
+    difference.matBytes=a.matBytes-b.matBytes;
+    return difference;
+}
+
+// Allocations added up from several threads at once (e.g. worker pool tasks of one job)
+class AllocationTally
+{
+    public:
+        AllocationTally() : nHeap(0), heapBytes(0), nMat(0), matBytes(0) {}
+        void add(const struct AllocationCounts &counts)
+        {
+            nHeap.fetchAndAddRelaxed(counts.nHeap);
+            heapBytes.fetchAndAddRelaxed(counts.heapBytes);
+            nMat.fetchAndAddRelaxed(counts.nMat);
+            matBytes.fetchAndAddRelaxed(counts.matBytes);
+        }
+        struct AllocationCounts get()
+        {
+            struct AllocationCounts counts;
+            counts.nHeap=nHeap.loadAcquire();
+            counts.heapBytes=heapBytes.loadAcquire();
+            counts.nMat=nMat.loadAcquire();
+            counts.matBytes=matBytes.loadAcquire();
+            return counts;
+        }
+        void reset()
+        {
+            nHeap=0;
+            heapBytes=0;
+            nMat=0;
+            matBytes=0;
+        }
+
+    private:
+        QAtomicInteger<quint64> nHeap;
+        QAtomicInteger<quint64> heapBytes;
+        QAtomicInteger<quint64> nMat;
+        QAtomicInteger<quint64> matBytes;
+};
+
+#endif // ALLOCATIONTRACKER_H
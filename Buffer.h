@@ -39,20 +39,31 @@
 #include <QSemaphore>
 #include <QByteArray>
 #include <QDebug>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+// Local
+#include "Structures.h"
+#include "TraceRecorder.h"
 
 template<class T> class Buffer
 {
     public:
         Buffer(int size);
-        void add(const T& data, bool dropIfFull=false);
+        // Returns false if the item was dropped (buffer full)
+        bool add(const T& data, bool dropIfFull=false);
         T get();
+        bool tryGet(T& data);
         int size();
         int maxSize();
         bool clear();
         bool isFull();
         bool isEmpty();
+        // Counters since the buffer was created (safe to call from any thread)
+        struct BufferStatistics getStatistics();
 
     private:
+        void enqueue(const T& data);
+        T dequeue();
         QMutex queueProtect;
         QQueue<T> queue;
         QSemaphore *freeSlots;
@@ -60,6 +71,16 @@ template<class T> class Buffer
         QSemaphore *clearBuffer_add;
         QSemaphore *clearBuffer_get;
         int bufferSize;
+        // Statistics (relaxed atomics: only updated, never used for synchronization)
+        QAtomicInt depth;
+        QAtomicInt highWaterMark;
+        QAtomicInteger<quint64> nAdded;
+        QAtomicInteger<quint64> nDropped;
+        QAtomicInteger<quint64> nProducerWaits;
+        QAtomicInteger<qint64> producerWaitNs;
+        QAtomicInteger<quint64> nConsumerWaits;
+        QAtomicInteger<qint64> consumerWaitNs;
+        QElapsedTimer lifetime;
 };
 
 template<class T> Buffer<T>::Buffer(int size)
@@ -71,10 +92,13 @@ template<class T> Buffer<T>::Buffer(int size)
     usedSlots = new QSemaphore(0);
     clearBuffer_add = new QSemaphore(1);
     clearBuffer_get = new QSemaphore(1);
+    // Start statistics
+    lifetime.start();
 }
 
-template<class T> void Buffer<T>::add(const T& data, bool dropIfFull)
+template<class T> bool Buffer<T>::add(const T& data, bool dropIfFull)
 {
+    bool added=true;
     // Acquire semaphore
     clearBuffer_add->acquire();
     // If dropping is enabled, do not block if buffer is full
@@ -84,40 +108,57 @@ template<class T> void Buffer<T>::add(const T& data, bool dropIfFull)
         if(freeSlots->tryAcquire())
         {
             // Add item to queue
-            queueProtect.lock();
-            queue.enqueue(data);
-            queueProtect.unlock();
+            enqueue(data);
             // Release semaphore
             usedSlots->release();
         }
+        else
+        {
+            nDropped.fetchAndAddRelaxed(1);
+            TraceRecorder::instant("buffer", "drop");
+            added=false;
+        }
     }
     // If buffer is full, wait on semaphore
     else
     {
-        // Acquire semaphore
-        freeSlots->acquire();
+        // Acquire semaphore (time spent blocked on a full buffer is counted)
+        if(!freeSlots->tryAcquire())
+        {
+            TraceScope trace("buffer", "wait for free slot");
+            QElapsedTimer waitTimer;
+            waitTimer.start();
+            freeSlots->acquire();
+            nProducerWaits.fetchAndAddRelaxed(1);
+            producerWaitNs.fetchAndAddRelaxed(waitTimer.nsecsElapsed());
+        }
         // Add item to queue
-        queueProtect.lock();
-        queue.enqueue(data);
-        queueProtect.unlock();
+        enqueue(data);
         // Release semaphore
         usedSlots->release();
     }
     // Release semaphore
     clearBuffer_add->release();
+    return added;
 }
 
 template<class T> T Buffer<T>::get()
 {
     // Local variable(s)
     T data;
-    // Acquire semaphores
+    // Acquire semaphores (time spent blocked on an empty buffer is counted)
     clearBuffer_get->acquire();
-    usedSlots->acquire();
+    if(!usedSlots->tryAcquire())
+    {
+        TraceScope trace("buffer", "wait for item");
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+        usedSlots->acquire();
+        nConsumerWaits.fetchAndAddRelaxed(1);
+        consumerWaitNs.fetchAndAddRelaxed(waitTimer.nsecsElapsed());
+    }
     // Take item from queue
-    queueProtect.lock();
-    data=queue.dequeue();
-    queueProtect.unlock();
+    data=dequeue();
     // Release semaphores
     freeSlots->release();
     clearBuffer_get->release();
@@ -125,6 +166,25 @@ template<class T> T Buffer<T>::get()
     return data;
 }
 
+template<class T> bool Buffer<T>::tryGet(T& data)
+{
+    // Buffer is being cleared (or another consumer is waiting for an item)
+    if(!clearBuffer_get->tryAcquire())
+        return false;
+    // Buffer is empty: do not wait
+    if(!usedSlots->tryAcquire())
+    {
+        clearBuffer_get->release();
+        return false;
+    }
+    // Take item from queue
+    data=dequeue();
+    // Release semaphores
+    freeSlots->release();
+    clearBuffer_get->release();
+    return true;
+}
+
 template<class T> bool Buffer<T>::clear()
 {
     // Check if buffer contains items
@@ -143,7 +203,10 @@ template<class T> bool Buffer<T>::clear()
                 // Reset usedSlots to zero
                 usedSlots->acquire(queue.size());
                 // Clear buffer
+                queueProtect.lock();
                 queue.clear();
+                depth.storeRelease(0);
+                queueProtect.unlock();
                 // Release all slots
                 freeSlots->release(bufferSize);
                 // Allow get method to resume
@@ -164,7 +227,7 @@ template<class T> bool Buffer<T>::clear()
 
 template<class T> int Buffer<T>::size()
 {
-    return queue.size();
+    return depth.loadAcquire();
 }
 
 template<class T> int Buffer<T>::maxSize()
@@ -174,12 +237,50 @@ template<class T> int Buffer<T>::maxSize()
 
 template<class T> bool Buffer<T>::isFull()
 {
-    return queue.size()==bufferSize;
+    return size()==bufferSize;
 }
 
 template<class T> bool Buffer<T>::isEmpty()
 {
-    return queue.size()==0;
+    return size()==0;
+}
+
+template<class T> struct BufferStatistics Buffer<T>::getStatistics()
+{
+    struct BufferStatistics statistics;
+    statistics.size=size();
+    statistics.maxSize=bufferSize;
+    statistics.highWaterMark=highWaterMark.loadAcquire();
+    statistics.nAdded=nAdded.loadAcquire();
+    statistics.nDropped=nDropped.loadAcquire();
+    statistics.nProducerWaits=nProducerWaits.loadAcquire();
+    statistics.producerWaitNs=producerWaitNs.loadAcquire();
+    statistics.nConsumerWaits=nConsumerWaits.loadAcquire();
+    statistics.consumerWaitNs=consumerWaitNs.loadAcquire();
+    statistics.elapsedNs=lifetime.nsecsElapsed();
+    return statistics;
+}
+
+template<class T> void Buffer<T>::enqueue(const T& data)
+{
+    queueProtect.lock();
+    queue.enqueue(data);
+    // Depth/high-water mark updated under the lock (producers cannot race each other)
+    int newDepth=queue.size();
+    depth.storeRelease(newDepth);
+    if(newDepth>highWaterMark.loadAcquire())
+        highWaterMark.storeRelease(newDepth);
+    queueProtect.unlock();
+    nAdded.fetchAndAddRelaxed(1);
+}
+
+template<class T> T Buffer<T>::dequeue()
+{
+    queueProtect.lock();
+    T data=queue.dequeue();
+    depth.storeRelease(queue.size());
+    queueProtect.unlock();
+    return data;
 }
 
 #endif // BUFFER_H
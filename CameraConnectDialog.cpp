@@ -35,6 +35,8 @@
 // Qt
 #include <QtCore/QThread>
 #include <QMessageBox>
+// Local
+#include "Structures.h"
 
 CameraConnectDialog::CameraConnectDialog(QWidget *parent, bool isStreamSyncEnabled) :
     QDialog(parent),
@@ -63,12 +65,43 @@ CameraConnectDialog::CameraConnectDialog(QWidget *parent, bool isStreamSyncEnabl
     threadPriorities<<"Idle"<<"Lowest"<<"Low"<<"Normal"<<"High"<<"Highest"<<"Time Critical"<<"Inherit";
     ui->capturePrioComboBox->addItems(threadPriorities);
     ui->processingPrioComboBox->addItems(threadPriorities);
+    QStringList schedPolicies;
+    schedPolicies<<"Off"<<"SCHED_FIFO"<<"SCHED_RR";
+    ui->schedPolicyComboBox->addItems(schedPolicies);
+    QStringList captureBackends;
+    captureBackends<<"OpenCV"<<"V4L2 (mmap)"<<"Replay File (mmap)";
+    ui->captureBackendComboBox->addItems(captureBackends);
+    QStringList captureFormats;
+    captureFormats<<"BGR"<<"YUYV"<<"NV12"<<"GREY"<<"MJPEG";
+    ui->captureFormatComboBox->addItems(captureFormats);
+    QStringList mjpegDecodeModes;
+    mjpegDecodeModes<<"In processing thread"<<"Decoder pool (colour)"<<"Decoder pool (grey)";
+    ui->mjpegDecodeComboBox->addItems(mjpegDecodeModes);
+    QStringList mjpegScales;
+    mjpegScales<<"1"<<"2"<<"4"<<"8";
+    ui->mjpegScaleComboBox->addItems(mjpegScales);
+    QStringList threadingModes;
+    threadingModes<<"Dedicated threads per camera"<<"Shared capture engine + processing pool";
+    ui->threadingModeComboBox->addItems(threadingModes);
+    QStringList poolPriorities;
+    poolPriorities<<"Low"<<"Normal"<<"High";
+    ui->poolPriorityComboBox->addItems(poolPriorities);
+    // poolTargetFpsEdit (processing pool fps budget) input validation
+    QRegExp rx6("^[0-9]{1,3}$"); // Integers 0 to 999
+    ui->poolTargetFpsEdit->setValidator(new QRegExpValidator(rx6, this));
+    // captureCoresEdit/processingCoresEdit (CPU cores) input validation
+    QRegExp rx5("^((node)?[0-9]{1,4}(-[0-9]{1,4})?)(,(node)?[0-9]{1,4}(-[0-9]{1,4})?)*$"); // e.g. 0-3,6 or node0
+    ui->captureCoresEdit->setValidator(new QRegExpValidator(rx5, this));
+    ui->processingCoresEdit->setValidator(new QRegExpValidator(rx5, this));
     // Set dialog to defaults
     resetToDefaults();
     // Enable/disable checkbox
     ui->enableFrameProcessingCheckBox->setEnabled(isStreamSyncEnabled);
     // Connect button to slot
     connect(ui->resetToDefaultsPushButton,SIGNAL(released()),SLOT(resetToDefaults()));
+    // Replay file is only used by the replay backend
+    connect(ui->captureBackendComboBox,SIGNAL(currentIndexChanged(int)),SLOT(updateReplayFileEdit(int)));
+    updateReplayFileEdit(ui->captureBackendComboBox->currentIndex());
 }
 
 CameraConnectDialog::~CameraConnectDialog()
@@ -140,6 +173,67 @@ int CameraConnectDialog::getProcessingThreadPrio()
     return ui->processingPrioComboBox->currentIndex();
 }
 
+QString CameraConnectDialog::getCaptureThreadCores()
+{
+    return ui->captureCoresEdit->text();
+}
+
+QString CameraConnectDialog::getProcessingThreadCores()
+{
+    return ui->processingCoresEdit->text();
+}
+
+int CameraConnectDialog::getSchedulingPolicy()
+{
+    return ui->schedPolicyComboBox->currentIndex();
+}
+
+int CameraConnectDialog::getCaptureBackend()
+{
+    return ui->captureBackendComboBox->currentIndex();
+}
+
+QString CameraConnectDialog::getReplayFile()
+{
+    return ui->replayFileEdit->text();
+}
+
+void CameraConnectDialog::updateReplayFileEdit(int captureBackend)
+{
+    ui->replayFileEdit->setEnabled(captureBackend==CAPTURE_BACKEND_REPLAY);
+}
+
+int CameraConnectDialog::getCaptureFormat()
+{
+    return ui->captureFormatComboBox->currentIndex();
+}
+
+int CameraConnectDialog::getMjpegDecodeMode()
+{
+    return ui->mjpegDecodeComboBox->currentIndex();
+}
+
+int CameraConnectDialog::getMjpegScaleDenom()
+{
+    return ui->mjpegScaleComboBox->currentText().toInt();
+}
+
+int CameraConnectDialog::getThreadingMode()
+{
+    return ui->threadingModeComboBox->currentIndex();
+}
+
+int CameraConnectDialog::getPoolTargetFps()
+{
+    // Blank field: no budget
+    return ui->poolTargetFpsEdit->text().toInt();
+}
+
+int CameraConnectDialog::getPoolPriority()
+{
+    return ui->poolPriorityComboBox->currentIndex();
+}
+
 QString CameraConnectDialog::getTabLabel()
 {
     return ui->tabLabelEdit->text();
@@ -161,6 +255,18 @@ void CameraConnectDialog::resetToDefaults()
     ui->imageBufferSizeEdit->setText(QString::number(DEFAULT_IMAGE_BUFFER_SIZE));
     // Drop frames
     ui->dropFrameCheckBox->setChecked(DEFAULT_DROP_FRAMES);
+    // Capture backend
+    ui->captureBackendComboBox->setCurrentIndex(DEFAULT_CAPTURE_BACKEND);
+    ui->replayFileEdit->clear();
+    // Capture format
+    ui->captureFormatComboBox->setCurrentIndex(DEFAULT_CAPTURE_FORMAT);
+    // MJPEG decoding
+    ui->mjpegDecodeComboBox->setCurrentIndex(DEFAULT_MJPEG_DECODE_MODE);
+    ui->mjpegScaleComboBox->setCurrentText(QString::number(DEFAULT_MJPEG_SCALE_DENOM));
+    // Threading
+    ui->threadingModeComboBox->setCurrentIndex(DEFAULT_THREADING_MODE);
+    ui->poolTargetFpsEdit->setText(QString::number(DEFAULT_POOL_TARGET_FPS));
+    ui->poolPriorityComboBox->setCurrentIndex(DEFAULT_POOL_PRIORITY);
     // Capture thread
     if(DEFAULT_CAP_THREAD_PRIO==QThread::IdlePriority)
         ui->capturePrioComboBox->setCurrentIndex(0);
@@ -195,6 +301,10 @@ void CameraConnectDialog::resetToDefaults()
         ui->processingPrioComboBox->setCurrentIndex(6);
     else if(DEFAULT_PROC_THREAD_PRIO==QThread::InheritPriority)
         ui->processingPrioComboBox->setCurrentIndex(7);
+    // Thread placement
+    ui->captureCoresEdit->clear();
+    ui->processingCoresEdit->clear();
+    ui->schedPolicyComboBox->setCurrentIndex(DEFAULT_SCHED_POLICY);
     // Tab label
     ui->tabLabelEdit->setText("");
     // Enable Frame Processing checkbox
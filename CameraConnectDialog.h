@@ -58,6 +58,17 @@ class CameraConnectDialog : public QDialog
         bool getDropFrameCheckBoxState();
         int getCaptureThreadPrio();
         int getProcessingThreadPrio();
+        QString getCaptureThreadCores();
+        QString getProcessingThreadCores();
+        int getSchedulingPolicy();
+        int getCaptureBackend();
+        QString getReplayFile();
+        int getCaptureFormat();
+        int getMjpegDecodeMode();
+        int getMjpegScaleDenom();
+        int getThreadingMode();
+        int getPoolTargetFps();
+        int getPoolPriority();
         QString getTabLabel();
         bool getEnableFrameProcessingCheckBoxState();
 
@@ -66,6 +77,9 @@ class CameraConnectDialog : public QDialog
 
     public slots:
         void resetToDefaults();
+
+    private slots:
+        void updateReplayFileEdit(int captureBackend);
 };
 
 #endif // CAMERACONNECTDIALOG_H
@@ -46,6 +46,11 @@ CameraView::CameraView(QWidget *parent, int deviceNumber, SharedImageBuffer *sha
     this->deviceNumber=deviceNumber;
     // Initialize internal flag
     isCameraConnected=false;
+    captureInEngine=false;
+    processingInPool=false;
+    frameRecorder=NULL;
+    captureThreadCPU=-1;
+    processingThreadCPU=-1;
     // Set initial GUI state
     ui->frameLabel->setText("No camera connected.");
     ui->imageBufferBar->setValue(0);
@@ -56,6 +61,11 @@ CameraView::CameraView(QWidget *parent, int deviceNumber, SharedImageBuffer *sha
     ui->cameraResolutionLabel->setText("");
     ui->roiLabel->setText("");
     ui->mouseCursorPosLabel->setText("");
+    ui->detectionRatesLabel->setText("");
+    ui->threadPlacementLabel->setText("");
+    ui->cameraHealthLabel->setText("");
+    ui->recordingLabel->setText("");
+    ui->bufferWaitsLabel->setText("");
     ui->clearImageBufferButton->setDisabled(true);
     // Initialize ImageProcessingFlags structure
     imageProcessingFlags.grayscaleOn=false;
@@ -68,6 +78,9 @@ CameraView::CameraView(QWidget *parent, int deviceNumber, SharedImageBuffer *sha
     imageProcessingFlags.ArucoOn=false;
     imageProcessingFlags.faceDetectionOn=false;
     imageProcessingFlags.eyeDetectionOn=false;
+    imageProcessingFlags.parallelOn=false;
+    imageProcessingFlags.pipelineOn=false;
+    imageProcessingFlags.governorOn=false;
 
     // Connect signals/slots
     connect(ui->frameLabel, SIGNAL(onMouseMoveEvent()), this, SLOT(updateMouseCursorPosLabel()));
@@ -82,16 +95,19 @@ CameraView::~CameraView()
     if(isCameraConnected)
     {
         // Stop processing thread
-        if(processingThread->isRunning())
+        if(processingInPool || processingThread->isRunning())
             stopProcessingThread();
         // Stop capture thread
-        if(captureThread->isRunning())
+        if(captureInEngine || captureThread->isRunning())
             stopCaptureThread();
 
         // Automatically start frame processing (for other streams)
         if(sharedImageBuffer->isSyncEnabledForDeviceNumber(deviceNumber))
             sharedImageBuffer->setSyncEnabled(true);
 
+        // Finish recordings (threads no longer hand over frames)
+        delete frameRecorder;
+
         // Remove from shared buffer
         sharedImageBuffer->removeByDeviceNumber(deviceNumber);
         // Disconnect camera
@@ -99,12 +115,16 @@ CameraView::~CameraView()
             qDebug() << "[" << deviceNumber << "] Camera successfully disconnected.";
         else
             qDebug() << "[" << deviceNumber << "] WARNING: Camera already disconnected.";
+        // Unmap cached huge page regions (frames of this camera's size may never be allocated again)
+        HugePageAllocator::instance()->trimCache();
     }
     // Delete UI
     delete ui;
 }
 
-bool CameraView::connectToCamera(bool dropFrameIfBufferFull, int capThreadPrio, int procThreadPrio, bool enableFrameProcessing, int width, int height)
+bool CameraView::connectToCamera(bool dropFrameIfBufferFull, int capThreadPrio, int procThreadPrio, bool enableFrameProcessing, int width, int height,
+                                 struct ThreadPlacement capThreadPlacement, struct ThreadPlacement procThreadPlacement, int captureBackend, int captureFormat,
+                                 struct MjpegDecoding mjpegDecoding, int threadingMode, struct PoolScheduling poolScheduling, QString replayFile)
 {
     // Set frame label text
     if(sharedImageBuffer->isSyncEnabledForDeviceNumber(deviceNumber))
@@ -113,7 +133,11 @@ bool CameraView::connectToCamera(bool dropFrameIfBufferFull, int capThreadPrio,
         ui->frameLabel->setText("Connecting to camera...");
 
     // Create capture thread
-    captureThread = new CaptureThread(sharedImageBuffer, deviceNumber, dropFrameIfBufferFull, width, height);
+    // Note: Shared threading always drops frames if the buffer is full (the capture engine must never block)
+    captureThread = new CaptureThread(sharedImageBuffer, deviceNumber, dropFrameIfBufferFull || threadingMode==THREADING_SHARED,
+                                      width, height, captureBackend, captureFormat, mjpegDecoding);
+    // Replay file (only used by the replay backend)
+    captureThread->setReplayFile(replayFile);
     // Attempt to connect to camera
     if(captureThread->connectToCamera())
     {
@@ -125,6 +149,8 @@ bool CameraView::connectToCamera(bool dropFrameIfBufferFull, int capThreadPrio,
         connect(processingThread, SIGNAL(newFrame(QImage)), this, SLOT(updateFrame(QImage)));
         connect(processingThread, SIGNAL(updateStatisticsInGUI(struct ThreadStatisticsData)), this, SLOT(updateProcessingThreadStats(struct ThreadStatisticsData)));
         connect(captureThread, SIGNAL(updateStatisticsInGUI(struct ThreadStatisticsData)), this, SLOT(updateCaptureThreadStats(struct ThreadStatisticsData)));
+        connect(captureThread, SIGNAL(updateThreadPlacementInGUI(QString)), this, SLOT(updateCaptureThreadPlacement(QString)));
+        connect(processingThread, SIGNAL(updateThreadPlacementInGUI(QString)), this, SLOT(updateProcessingThreadPlacement(QString)));
         connect(imageProcessingSettingsDialog, SIGNAL(newImageProcessingSettings(struct ImageProcessingSettings)), processingThread, SLOT(updateImageProcessingSettings(struct ImageProcessingSettings)));
         connect(this, SIGNAL(newImageProcessingFlags(struct ImageProcessingFlags)), processingThread, SLOT(updateImageProcessingFlags(struct ImageProcessingFlags)));
         connect(this, SIGNAL(setROI(QRect)), processingThread, SLOT(setROI(QRect)));
@@ -136,11 +162,37 @@ bool CameraView::connectToCamera(bool dropFrameIfBufferFull, int capThreadPrio,
         emit newImageProcessingFlags(imageProcessingFlags);
         imageProcessingSettingsDialog->updateStoredSettingsFromDialog();
 
+        // Pin threads to cores / set scheduling policy (applied by each thread when it starts)
+        captureThread->setThreadPlacement(capThreadPlacement);
+        processingThread->setThreadPlacement(procThreadPlacement);
+        // Recorder (raw frames from capture, annotated frames from processing; started from the context menu)
+        frameRecorder = new FrameRecorder(deviceNumber, DEFAULT_RECORDER_DROP_POLICY);
+        captureThread->setFrameRecorder(frameRecorder);
+        processingThread->setFrameRecorder(frameRecorder);
+
         // Start capturing frames from camera
-        captureThread->start((QThread::Priority)capThreadPrio);
+        // Shared threading: event-driven capture (needs a pollable device, otherwise falls back to a capture thread)
+        if(threadingMode==THREADING_SHARED && CaptureEngine::isAvailable() && CaptureEngine::instance()->addSource(captureThread))
+        {
+            captureInEngine=true;
+            updateCaptureThreadPlacement(QString("Capture engine (")+QString::number(CaptureEngine::instance()->ioThreadCount())+QString(" I/O threads)"));
+        }
+        else
+            captureThread->start((QThread::Priority)capThreadPrio);
         // Start processing captured frames (if enabled)
         if(enableFrameProcessing)
-            processingThread->start((QThread::Priority)procThreadPrio);
+        {
+            // Shared threading: frames are processed by the processing pool
+            if(threadingMode==THREADING_SHARED)
+            {
+                captureThread->setProcessedByPool(true);
+                ProcessingPool::instance()->addProcessor(processingThread, sharedImageBuffer->getByDeviceNumber(deviceNumber), poolScheduling);
+                processingInPool=true;
+                updateProcessingThreadPlacement(QString("Processing pool (")+QString::number(ProcessingPool::instance()->threadCount())+QString(" threads)"));
+            }
+            else
+                processingThread->start((QThread::Priority)procThreadPrio);
+        }
 
         // Setup imageBufferBar with minimum and maximum values
         ui->imageBufferBar->setMinimum(0);
@@ -165,6 +217,15 @@ bool CameraView::connectToCamera(bool dropFrameIfBufferFull, int capThreadPrio,
 void CameraView::stopCaptureThread()
 {
     qDebug() << "[" << deviceNumber << "] About to stop capture thread...";
+    // Capture engine: no thread to stop (returns once a frame being captured from this camera is delivered)
+    if(captureInEngine)
+    {
+        CaptureEngine::instance()->removeSource(captureThread);
+        captureThread->finishCapture();
+        captureInEngine=false;
+        qDebug() << "[" << deviceNumber << "] Camera successfully removed from capture engine.";
+        return;
+    }
     captureThread->stop();
     sharedImageBuffer->wakeAll(); // This allows the thread to be stopped if it is in a wait-state
     // Take one frame off a FULL queue to allow the capture thread to finish
@@ -177,12 +238,27 @@ void CameraView::stopCaptureThread()
 void CameraView::stopProcessingThread()
 {
     qDebug() << "[" << deviceNumber << "] About to stop processing thread...";
+    // Processing pool: no thread to stop (returns once a frame being processed for this camera is finished)
+    if(processingInPool)
+    {
+        ProcessingPool::instance()->removeProcessor(processingThread);
+        processingInPool=false;
+        qDebug() << "[" << deviceNumber << "] Camera successfully removed from processing pool.";
+        return;
+    }
     processingThread->stop();
     sharedImageBuffer->wakeAll(); // This allows the thread to be stopped if it is in a wait-state
     processingThread->wait();
     qDebug() << "[" << deviceNumber << "] Processing thread successfully stopped.";
 }
 
+QString CameraView::formatAllocations(struct AllocationCounts counts)
+{
+    return QString(" | alloc/frame: ")+QString::number(counts.nHeap)+QString(" heap (")+
+           QString::number(counts.heapBytes/1024.0, 'f', 1)+QString(" KB), ")+QString::number(counts.nMat)+
+           QString(" Mat (")+QString::number(counts.matBytes/1024.0, 'f', 1)+QString(" KB)");
+}
+
 void CameraView::updateCaptureThreadStats(struct ThreadStatisticsData statData)
 {
     // Show [number of images in buffer / image buffer size] in imageBufferLabel
@@ -190,17 +266,74 @@ void CameraView::updateCaptureThreadStats(struct ThreadStatisticsData statData)
                                   QString("/")+QString::number(sharedImageBuffer->getByDeviceNumber(deviceNumber)->maxSize())+QString("]"));
     // Show percentage of image bufffer full in imageBufferBar
     ui->imageBufferBar->setValue(sharedImageBuffer->getByDeviceNumber(deviceNumber)->size());
-
-    // Show processing rate in captureRateLabel
-    ui->captureRateLabel->setText(QString::number(statData.averageFPS)+" fps");
+    // Show share of time capture was blocked on a full buffer / processing waited on an empty one (tells which side limits the rate)
+    struct BufferStatistics bufferStats=sharedImageBuffer->getByDeviceNumber(deviceNumber)->getStatistics();
+    double producerWaitShare=bufferStats.elapsedNs>0 ? 100.0*bufferStats.producerWaitNs/bufferStats.elapsedNs : 0;
+    double consumerWaitShare=bufferStats.elapsedNs>0 ? 100.0*bufferStats.consumerWaitNs/bufferStats.elapsedNs : 0;
+    QString bound;
+    if(bufferStats.nDropped>0 || producerWaitShare>consumerWaitShare)
+        bound=QString("processing-bound");
+    else if(consumerWaitShare>0)
+        bound=QString("capture-bound");
+    ui->bufferWaitsLabel->setText(QString("Capture blocked ")+QString::number(producerWaitShare, 'f', 1)+QString("%, processing waiting ")+
+                                  QString::number(consumerWaitShare, 'f', 1)+QString("%, ")+QString::number(bufferStats.nDropped)+
+                                  QString(" dropped")+(statData.nDecoderDropped>0 ? QString(" (+")+QString::number(statData.nDecoderDropped)+QString(" by decoder)") : QString(""))+
+                                  QString(", peak ")+QString::number(bufferStats.highWaterMark)+QString("/")+QString::number(bufferStats.maxSize)+
+                                  (bound.isEmpty() ? QString("") : QString(" (")+bound+QString(")")));
+
+    // Show capture rate and frame pacing (jitter, shortest/longest interval) in captureRateLabel
+    ui->captureRateLabel->setText(QString::number(statData.averageFPS, 'f', 1)+QString(" fps (jitter ")+
+                                  QString::number(statData.jitterMs, 'f', 2)+QString(" ms, ")+
+                                  QString::number(statData.minIntervalMs, 'f', 1)+QString("-")+
+                                  QString::number(statData.maxIntervalMs, 'f', 1)+QString(" ms)"));
+    // Allocation tracking build: show allocations made for the last frame
+    if(AllocationTracker::isEnabled())
+        ui->captureRateLabel->setText(ui->captureRateLabel->text()+formatAllocations(statData.frameAllocations));
     // Show number of frames captured in nFramesCapturedLabel
     ui->nFramesCapturedLabel->setText(QString("[") + QString::number(statData.nFramesProcessed) + QString("]"));
+    // Show camera health (and how often the camera had to be reconnected)
+    ui->cameraHealthLabel->setText(CaptureHealthMonitor::stateToString(statData.captureHealth)+
+                                   (statData.nReconnects>0 ? QString(" [")+QString::number(statData.nReconnects)+QString(" reconnects]") : QString("")));
+    // Show frames recorded/dropped by the recorder
+    if(frameRecorder->isRunning())
+    {
+        struct RecorderStatistics recorderStats=frameRecorder->getStatistics();
+        ui->recordingLabel->setText(QString("Raw ")+QString::number(recorderStats.nRecorded[RECORDER_STREAM_RAW])+
+                                    QString(" (")+QString::number(recorderStats.nDropped[RECORDER_STREAM_RAW])+QString(" dropped)")+
+                                    QString(" / Annotated ")+QString::number(recorderStats.nRecorded[RECORDER_STREAM_ANNOTATED])+
+                                    QString(" (")+QString::number(recorderStats.nDropped[RECORDER_STREAM_ANNOTATED])+QString(" dropped)")+
+                                    QString(" / Events ")+QString::number(recorderStats.nClips)+QString(" clips (")+
+                                    QString::number(recorderStats.eventBufferBytes/(1024*1024))+QString(" MB buffered)")+
+                                    QString(" / Replay ")+QString::number(recorderStats.nRecorded[RECORDER_STREAM_REPLAY])+
+                                    QString(" (")+QString::number(recorderStats.nDropped[RECORDER_STREAM_REPLAY])+QString(" dropped)"));
+    }
+    // Show core the capture thread last ran on
+    if(statData.currentCPU!=captureThreadCPU)
+    {
+        captureThreadCPU=statData.currentCPU;
+        updateThreadPlacementLabel();
+    }
 }
 
 void CameraView::updateProcessingThreadStats(struct ThreadStatisticsData statData)
 {
     // Show processing rate in processingRateLabel
-    ui->processingRateLabel->setText(QString::number(statData.averageFPS)+" fps");
+    ui->processingRateLabel->setText(QString::number(statData.averageFPS, 'f', 1)+QString(" fps (jitter ")+
+                                     QString::number(statData.jitterMs, 'f', 2)+QString(" ms, latency ")+
+                                     QString::number(statData.latencyMs, 'f', 1)+QString(" ms)"));
+    // Processing pool: show rate achieved against the camera's budget, its share and the cost of its frames
+    if(processingInPool)
+    {
+        struct PoolSchedulingStatistics poolStats=ProcessingPool::instance()->getStatistics(processingThread);
+        ui->processingRateLabel->setText(QString::number(statData.averageFPS, 'f', 1)+
+                                         (poolStats.targetFps>0 ? QString("/")+QString::number(poolStats.targetFps) : QString(""))+
+                                         QString(" fps (w")+QString::number(poolStats.weight)+QString(", ")+
+                                         QString::number(poolStats.averageCostMs, 'f', 1)+QString(" ms/frame, ")+
+                                         QString::number(poolStats.nSkipped)+QString(" skipped)"));
+    }
+    // Allocation tracking build: show allocations made for the last frame
+    if(AllocationTracker::isEnabled())
+        ui->processingRateLabel->setText(ui->processingRateLabel->text()+formatAllocations(statData.frameAllocations));
     // Show ROI information in roiLabel
     ui->roiLabel->setText(QString("(")+QString::number(processingThread->getCurrentROI().x())+QString(",")+
                           QString::number(processingThread->getCurrentROI().y())+QString(") ")+
@@ -208,7 +341,38 @@ void CameraView::updateProcessingThreadStats(struct ThreadStatisticsData statDat
                           QString("x")+QString::number(processingThread->getCurrentROI().height()));
     // Show number of frames processed in nFramesProcessedLabel
     ui->nFramesProcessedLabel->setText(QString("[") + QString::number(statData.nFramesProcessed) + QString("]"));
+    // Show effective rate of each detection stage in detectionRatesLabel
+    ui->detectionRatesLabel->setText(QString("ArUco ")+QString::number(statData.arucoDetectionRate, 'f', 1)+
+                                     QString(" / Faces ")+QString::number(statData.faceDetectionRate, 'f', 1)+
+                                     QString(" / Eyes ")+QString::number(statData.eyeDetectionRate, 'f', 1)+QString(" Hz"));
+    // Show core the processing thread last ran on
+    if(statData.currentCPU!=processingThreadCPU)
+    {
+        processingThreadCPU=statData.currentCPU;
+        updateThreadPlacementLabel();
+    }
+
+}
+
+void CameraView::updateCaptureThreadPlacement(QString placement)
+{
+    captureThreadPlacement=placement;
+    updateThreadPlacementLabel();
+}
 
+void CameraView::updateProcessingThreadPlacement(QString placement)
+{
+    processingThreadPlacement=placement;
+    updateThreadPlacementLabel();
+}
+
+void CameraView::updateThreadPlacementLabel()
+{
+    // Show placement requested for each thread and the core it is currently on
+    ui->threadPlacementLabel->setText(QString("Capture: ")+captureThreadPlacement+
+                                      QString(" [on ")+QString::number(captureThreadCPU)+QString("]")+
+                                      QString(" | Processing: ")+processingThreadPlacement+
+                                      QString(" [on ")+QString::number(processingThreadCPU)+QString("]"));
 }
 
 void CameraView::updateFrame(const QImage &frame)
@@ -399,8 +563,43 @@ void CameraView::handleContextMenuAction(QAction *action)
         emit newImageProcessingFlags(imageProcessingFlags);
 //        qDebug() << "eye detect option" << imageProcessingFlags.eyeDetectionOn;
     }
+    else if(action->text()=="Parallel Processing")
+    {
+        imageProcessingFlags.parallelOn=action->isChecked();
+        emit newImageProcessingFlags(imageProcessingFlags);
+    }
+    else if(action->text()=="Pipelined Processing")
+    {
+        imageProcessingFlags.pipelineOn=action->isChecked();
+        emit newImageProcessingFlags(imageProcessingFlags);
+    }
+    else if(action->text()=="Adaptive Detection")
+    {
+        imageProcessingFlags.governorOn=action->isChecked();
+        emit newImageProcessingFlags(imageProcessingFlags);
+    }
     else if(action->text()=="Settings...")
         setImageProcessingSettings();
+    else if(action->text()=="Record Raw Stream")
+        frameRecorder->setStreamEnabled(RECORDER_STREAM_RAW, action->isChecked());
+    else if(action->text()=="Record Annotated Stream")
+        frameRecorder->setStreamEnabled(RECORDER_STREAM_ANNOTATED, action->isChecked());
+    else if(action->text()=="Record Events (Pre-Event Buffer)")
+        frameRecorder->setStreamEnabled(RECORDER_STREAM_EVENTS, action->isChecked());
+    else if(action->text()=="Record Replay File (Uncompressed)")
+        frameRecorder->setStreamEnabled(RECORDER_STREAM_REPLAY, action->isChecked());
+    else if(action->text()=="Export Raw Frames" || action->text()=="Export Processed Frames")
+    {
+        int stage=(action->text()=="Export Raw Frames") ? FRAME_EXPORT_RAW : FRAME_EXPORT_PROCESSED;
+        if(sharedImageBuffer->getFrameExporter()->setExportEnabled(deviceNumber, stage, action->isChecked()))
+            qDebug() << "[" << deviceNumber << "]" << (action->isChecked() ? "Exporting frames to" : "Stopped exporting frames to") << FrameExporter::ringName(deviceNumber, stage);
+        // Not supported on this platform
+        else
+        {
+            QMessageBox::warning(this,"ERROR:","Exporting frames to shared memory is not supported on this platform.");
+            action->setChecked(false);
+        }
+    }
 }
 
 
@@ -39,6 +39,10 @@
 #include "ImageProcessingSettingsDialog.h"
 #include "Structures.h"
 #include "SharedImageBuffer.h"
+#include "CaptureEngine.h"
+#include "ProcessingPool.h"
+#include "AllocationTracker.h"
+#include "HugePageAllocator.h"
 
 namespace Ui {
     class CameraView;
@@ -51,7 +55,9 @@ class CameraView : public QWidget
     public:
         explicit CameraView(QWidget *parent, int deviceNumber, SharedImageBuffer *sharedImageBuffer);
         ~CameraView();
-        bool connectToCamera(bool dropFrame, int capThreadPrio, int procThreadPrio, bool createProcThread, int width, int height);
+        bool connectToCamera(bool dropFrame, int capThreadPrio, int procThreadPrio, bool createProcThread, int width, int height,
+                             struct ThreadPlacement capThreadPlacement, struct ThreadPlacement procThreadPlacement, int captureBackend, int captureFormat,
+                             struct MjpegDecoding mjpegDecoding, int threadingMode, struct PoolScheduling poolScheduling, QString replayFile);
 
     private:
         Ui::CameraView *ui;
@@ -62,8 +68,17 @@ class CameraView : public QWidget
         ImageProcessingFlags imageProcessingFlags;
         void stopCaptureThread();
         void stopProcessingThread();
+        void updateThreadPlacementLabel();
+        QString formatAllocations(struct AllocationCounts counts);
+        QString captureThreadPlacement;
+        QString processingThreadPlacement;
+        int captureThreadCPU;
+        int processingThreadCPU;
         int deviceNumber;
         bool isCameraConnected;
+        bool captureInEngine;
+        FrameRecorder *frameRecorder;
+        bool processingInPool;
 
     public slots:
         void setImageProcessingSettings();
@@ -75,6 +90,8 @@ class CameraView : public QWidget
         void updateFrame(const QImage &frame);
         void updateProcessingThreadStats(struct ThreadStatisticsData statData);
         void updateCaptureThreadStats(struct ThreadStatisticsData statData);
+        void updateCaptureThreadPlacement(QString placement);
+        void updateProcessingThreadPlacement(QString placement);
         void handleContextMenuAction(QAction *action);
 
     signals:
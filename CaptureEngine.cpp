@@ -0,0 +1,349 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* CaptureEngine.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureEngine.h"
+#include "CaptureThread.h"
+#include "Config.h"
+#include "TraceRecorder.h"
+
+// Qt
+#include <QtCore/QDebug>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMap>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#ifdef Q_OS_LINUX
+// Linux
+#include <sys/epoll.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+class CaptureEngineLoop;
+
+class CaptureEngineReconnect : public QRunnable
+{
+    public:
+        CaptureEngineReconnect(CaptureEngineLoop *loop, quint64 id, CaptureThread *captureThread) : loop(loop), id(id), captureThread(captureThread) {}
+        void run();
+
+    private:
+        CaptureEngineLoop *loop;
+        quint64 id;
+        CaptureThread *captureThread;
+};
+
+class CaptureEngineLoop : public QThread
+{
+    public:
+        CaptureEngineLoop()
+        {
+            epollFd=epoll_create1(EPOLL_CLOEXEC);
+            nextId=0;
+        }
+
+        ~CaptureEngineLoop()
+        {
+            // Reconnects still in progress use the descriptor set
+            reconnectPool.waitForDone();
+            close(epollFd);
+        }
+
+        void addSource(CaptureThread *captureThread)
+        {
+            QMutexLocker locker(&mutex);
+            Source source;
+            source.captureThread=captureThread;
+            source.fd=-1;
+            source.reconnecting=false;
+            quint64 id=nextId++;
+            sources.insert(id, source);
+            attach(id);
+        }
+
+        bool removeSource(CaptureThread *captureThread)
+        {
+            // Waits for a frame being captured from this source (events are handled under the lock)
+            QMutexLocker locker(&mutex);
+            quint64 id=0;
+            bool found=false;
+            for(QMap<quint64, Source>::iterator it=sources.begin(); it!=sources.end() && !found; ++it)
+            {
+                if(it.value().captureThread==captureThread)
+                {
+                    id=it.key();
+                    found=true;
+                }
+            }
+            if(!found)
+                return false;
+            // ...and for a reconnect in progress
+            while(sources[id].reconnecting)
+                reconnected.wait(&mutex);
+            detach(id);
+            sources.remove(id);
+            return true;
+        }
+
+        // Reopens a stalled camera (called on the reconnect pool: the device open may block)
+        void reconnect(quint64 id, CaptureThread *captureThread)
+        {
+            captureThread->reconnectCamera();
+            QMutexLocker locker(&mutex);
+            // Source cannot be removed while reconnecting; reopened camera has a new descriptor
+            sources[id].reconnecting=false;
+            attach(id);
+            reconnected.wakeAll();
+        }
+
+        void stop()
+        {
+            doStop.store(1);
+        }
+
+        int sourceCount()
+        {
+            QMutexLocker locker(&mutex);
+            return sources.size();
+        }
+
+    protected:
+        void run()
+        {
+            TraceRecorder::setThreadName("Capture engine");
+            struct epoll_event events[CAPTURE_ENGINE_MAX_EVENTS];
+            QElapsedTimer tick;
+            tick.start();
+            // Stop is noticed within one tick
+            while(!doStop.load())
+            {
+                // Wait for frames (timeout: cameras without frames still need their health checked)
+                int nEvents=epoll_wait(epollFd, events, CAPTURE_ENGINE_MAX_EVENTS, CAPTURE_ENGINE_TICK_MS);
+                if(nEvents<0 && errno!=EINTR)
+                {
+                    qDebug() << "ERROR: Capture engine could not wait for frames:" << strerror(errno);
+                    msleep(CAPTURE_ENGINE_TICK_MS);
+                    continue;
+                }
+
+                QMutexLocker locker(&mutex);
+                // Grab one frame from every camera that has one ready
+                for(int i=0; i<nEvents; i++)
+                {
+                    quint64 id=events[i].data.u64;
+                    // Source removed (or being reconnected) after the event was reported
+                    if(!sources.contains(id) || sources[id].reconnecting)
+                        continue;
+                    // Device gone: stop polling it (the health check reconnects it)
+                    if(events[i].events&(EPOLLERR|EPOLLHUP))
+                        detach(id);
+                    else
+                        sources[id].captureThread->captureFrame();
+                }
+
+                // Health check: reconnect stalled cameras (after their backoff) and retry attaching the others
+                if(tick.elapsed()>=CAPTURE_ENGINE_TICK_MS)
+                {
+                    tick.restart();
+                    for(QMap<quint64, Source>::iterator it=sources.begin(); it!=sources.end(); ++it)
+                    {
+                        Source &source=it.value();
+                        if(source.reconnecting)
+                            continue;
+                        // Reconnected on the pool without the lock: the other cameras keep capturing and removeSource() is not held up
+                        if(source.captureThread->checkHealth())
+                        {
+                            detach(it.key());
+                            source.reconnecting=true;
+                            reconnectPool.start(new CaptureEngineReconnect(this, it.key(), source.captureThread));
+                        }
+                        else if(source.fd==-1)
+                            attach(it.key());
+                    }
+                }
+            }
+        }
+
+    private:
+        void attach(quint64 id)
+        {
+            Source &source=sources[id];
+            int fd=source.captureThread->getFd();
+            if(fd==-1)
+                return;
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events=EPOLLIN;
+            event.data.u64=id;
+            if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event)==0)
+                source.fd=fd;
+        }
+
+        void detach(quint64 id)
+        {
+            Source &source=sources[id];
+            if(source.fd==-1)
+                return;
+            // Fails harmlessly if the descriptor was already closed (closing removes it from the set)
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, source.fd, NULL);
+            source.fd=-1;
+        }
+
+        struct Source
+        {
+            CaptureThread *captureThread;
+            int fd;
+            bool reconnecting;
+        };
+        QMap<quint64, Source> sources;
+        QMutex mutex;
+        QWaitCondition reconnected;
+        QThreadPool reconnectPool;
+        QAtomicInt doStop;
+        quint64 nextId;
+        int epollFd;
+};
+
+void CaptureEngineReconnect::run()
+{
+    loop->reconnect(id, captureThread);
+}
+
+CaptureEngine::CaptureEngine()
+{
+}
+
+void CaptureEngine::start()
+{
+    // Start I/O threads (0: one per four cores)
+    int nThreads=CAPTURE_ENGINE_IO_THREADS>0 ? CAPTURE_ENGINE_IO_THREADS : QThread::idealThreadCount()/4;
+    for(int i=0; i<qMax(1, nThreads); i++)
+    {
+        CaptureEngineLoop *loop=new CaptureEngineLoop();
+        loop->start((QThread::Priority)DEFAULT_CAP_THREAD_PRIO);
+        loops.append(loop);
+    }
+}
+
+void CaptureEngine::shutdown()
+{
+    // Sources should have been removed (their cameras are no longer captured from)
+    for(int i=0; i<loops.size(); i++)
+        loops[i]->stop();
+    for(int i=0; i<loops.size(); i++)
+    {
+        loops[i]->wait();
+        delete loops[i];
+    }
+    loops.clear();
+}
+
+bool CaptureEngine::isAvailable()
+{
+    return true;
+}
+
+bool CaptureEngine::addSource(CaptureThread *captureThread)
+{
+    // Only sources with a pollable descriptor
+    if(captureThread->getFd()==-1)
+        return false;
+    // I/O threads are started with the first source
+    if(loops.isEmpty())
+        start();
+    // Least loaded I/O thread
+    CaptureEngineLoop *loop=loops.first();
+    for(int i=1; i<loops.size(); i++)
+        if(loops[i]->sourceCount()<loop->sourceCount())
+            loop=loops[i];
+    loop->addSource(captureThread);
+    return true;
+}
+
+void CaptureEngine::removeSource(CaptureThread *captureThread)
+{
+    for(int i=0; i<loops.size(); i++)
+        if(loops[i]->removeSource(captureThread))
+            return;
+}
+
+#else
+
+class CaptureEngineLoop
+{
+};
+
+CaptureEngine::CaptureEngine()
+{
+}
+
+void CaptureEngine::start()
+{
+}
+
+void CaptureEngine::shutdown()
+{
+}
+
+bool CaptureEngine::isAvailable()
+{
+    return false;
+}
+
+bool CaptureEngine::addSource(CaptureThread *captureThread)
+{
+    Q_UNUSED(captureThread);
+    return false;
+}
+
+void CaptureEngine::removeSource(CaptureThread *captureThread)
+{
+    Q_UNUSED(captureThread);
+}
+
+#endif
+
+CaptureEngine* CaptureEngine::instance()
+{
+    static CaptureEngine captureEngine;
+    return &captureEngine;
+}
+
+int CaptureEngine::ioThreadCount()
+{
+    return loops.size();
+}
@@ -0,0 +1,63 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* CaptureEngine.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef CAPTUREENGINE_H
+#define CAPTUREENGINE_H
+
+// Qt
+#include <QtCore/QList>
+
+class CaptureThread;
+class CaptureEngineLoop;
+
+// Process-wide event-driven capture. A few I/O threads wait on the file
+// descriptors of all attached cameras (epoll) and grab a frame from whichever
+// camera has one ready, instead of every camera blocking in its own capture
+// thread. Needs a pollable descriptor: only V4L2 sources can be attached.
+class CaptureEngine
+{
+    public:
+        static CaptureEngine* instance();
+        static bool isAvailable();
+        int ioThreadCount();
+        bool addSource(CaptureThread *captureThread);
+        void removeSource(CaptureThread *captureThread);
+        // Stops and joins the I/O threads (on exit, once all sources are removed)
+        void shutdown();
+
+    private:
+        CaptureEngine();
+        void start();
+        QList<CaptureEngineLoop*> loops;
+};
+
+#endif // CAPTUREENGINE_H
@@ -0,0 +1,121 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* CaptureHealthMonitor.cpp                                             */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureHealthMonitor.h"
+// Qt
+#include <QtGlobal>
+
+CaptureHealthMonitor::CaptureHealthMonitor()
+{
+    // Initialize members
+    state=CAPTURE_HEALTH_CONNECTED;
+    attempts=0;
+    backoffMs=CAPTURE_RECONNECT_MIN_BACKOFF_MS;
+    nReconnects=0;
+    sinceLastFrame.start();
+    sinceLastAttempt.start();
+}
+
+void CaptureHealthMonitor::frameGrabbed()
+{
+    // Source is healthy again: next stall starts with the minimum backoff
+    state=CAPTURE_HEALTH_CONNECTED;
+    attempts=0;
+    backoffMs=CAPTURE_RECONNECT_MIN_BACKOFF_MS;
+    sinceLastFrame.restart();
+}
+
+bool CaptureHealthMonitor::grabFailed()
+{
+    // No frame for too long: source has stalled
+    if(state==CAPTURE_HEALTH_CONNECTED && sinceLastFrame.elapsed()>CAPTURE_STALL_TIMEOUT_MS)
+        state=CAPTURE_HEALTH_STALLED;
+    // Reconnect unless the source is still within its stall timeout
+    return state!=CAPTURE_HEALTH_CONNECTED;
+}
+
+int CaptureHealthMonitor::reconnectDelay()
+{
+    // First attempt after a stall is immediate
+    return attempts==0 ? 0 : backoffMs;
+}
+
+bool CaptureHealthMonitor::reconnectDue()
+{
+    // Backoff elapsed (for callers that cannot sleep through it)
+    return attempts==0 || sinceLastAttempt.elapsed()>=backoffMs;
+}
+
+void CaptureHealthMonitor::reconnectFinished(bool success)
+{
+    sinceLastAttempt.restart();
+    // Back off further for every attempt until a frame arrives
+    if(attempts>0)
+        backoffMs=qMin(backoffMs*2, CAPTURE_RECONNECT_MAX_BACKOFF_MS);
+    attempts++;
+    // Reopened: wait for frames (a device that opens but stays silent stalls again)
+    if(success)
+    {
+        state=CAPTURE_HEALTH_CONNECTED;
+        nReconnects++;
+        sinceLastFrame.restart();
+    }
+    else
+        state=(attempts>=CAPTURE_MAX_RECONNECT_ATTEMPTS) ? CAPTURE_HEALTH_FAILED : CAPTURE_HEALTH_RECONNECTING;
+}
+
+int CaptureHealthMonitor::getState()
+{
+    return state;
+}
+
+int CaptureHealthMonitor::getReconnectCount()
+{
+    return nReconnects;
+}
+
+QString CaptureHealthMonitor::stateToString(int state)
+{
+    switch(state)
+    {
+        case CAPTURE_HEALTH_CONNECTED:
+            return "Connected";
+        case CAPTURE_HEALTH_STALLED:
+            return "Stalled";
+        case CAPTURE_HEALTH_RECONNECTING:
+            return "Reconnecting";
+        case CAPTURE_HEALTH_FAILED:
+            return "Failed";
+        default:
+            return "Unknown";
+    }
+}
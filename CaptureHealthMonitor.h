@@ -0,0 +1,69 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* CaptureHealthMonitor.h                                               */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef CAPTUREHEALTHMONITOR_H
+#define CAPTUREHEALTHMONITOR_H
+
+// Qt
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QString>
+// Local
+#include "Config.h"
+#include "Structures.h"
+
+// Tracks the health of a capture source. The source is considered stalled once
+// no frame has arrived for CAPTURE_STALL_TIMEOUT_MS; it is then reconnected with
+// exponential backoff. After CAPTURE_MAX_RECONNECT_ATTEMPTS failed attempts it is
+// reported as failed, but reconnecting continues at the maximum backoff.
+class CaptureHealthMonitor
+{
+    public:
+        CaptureHealthMonitor();
+        void frameGrabbed();
+        bool grabFailed();
+        int reconnectDelay();
+        bool reconnectDue();
+        void reconnectFinished(bool success);
+        int getState();
+        int getReconnectCount();
+        static QString stateToString(int state);
+
+    private:
+        QElapsedTimer sinceLastFrame;
+        QElapsedTimer sinceLastAttempt;
+        int state;
+        int attempts;
+        int backoffMs;
+        int nReconnects;
+};
+
+#endif // CAPTUREHEALTHMONITOR_H
@@ -32,24 +32,51 @@
 
 #include "CaptureThread.h"
 
-CaptureThread::CaptureThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber, bool dropFrameIfBufferFull, int width, int height) : QThread(), sharedImageBuffer(sharedImageBuffer)
+CaptureThread::CaptureThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber, bool dropFrameIfBufferFull, int width, int height, int captureBackend, int captureFormat,
+                             struct MjpegDecoding mjpegDecoding) : QThread(), sharedImageBuffer(sharedImageBuffer),
+                                                                   stats(deviceNumber, STATS_COMPONENT_CAPTURE)
 {
     // Save passed parameters
     this->dropFrameIfBufferFull=dropFrameIfBufferFull;
     this->deviceNumber=deviceNumber;
     this->width = width;
     this->height = height;
+    this->captureBackend = captureBackend;
+    this->captureFormat = captureFormat;
+    this->mjpegDecoding = mjpegDecoding;
     // Initialize variables(s)
     doStop=false;
-    sampleNumber=0;
-    fpsSum=0;
-    fps.clear();
+    sequence=0;
+    mjpegDecoder=NULL;
+    processedByPool=false;
+    frameRecorder=NULL;
     statsData.averageFPS=0;
+    statsData.windowFPS=0;
+    statsData.jitterMs=0;
+    statsData.minIntervalMs=0;
+    statsData.maxIntervalMs=0;
+    statsData.latencyMs=0;
+    statsData.maxLatencyMs=0;
     statsData.nFramesProcessed=0;
+    statsData.arucoDetectionRate=0;
+    statsData.faceDetectionRate=0;
+    statsData.eyeDetectionRate=0;
+    statsData.currentCPU=-1;
+    statsData.captureHealth=CAPTURE_HEALTH_CONNECTED;
+    statsData.nReconnects=0;
+    statsData.nDecoderDropped=0;
+    statsData.frameAllocations=AllocationCounts();
+    threadPlacement.schedPolicy=SCHED_POLICY_DEFAULT;
+    threadPlacement.rtPriority=0;
+    stats.set(STATS_BUFFER_CAPACITY, sharedImageBuffer->getByDeviceNumber(deviceNumber)->maxSize());
 }
 
 void CaptureThread::run()
 {
+    // Pin to cores / set scheduling policy (must be done from within the thread)
+    emit updateThreadPlacementInGUI(applyThreadPlacement(threadPlacement));
+    TraceRecorder::setThreadName(QString("Capture %1").arg(deviceNumber));
+
     while(1)
     {
         ////////////////////////////////
@@ -66,34 +93,200 @@ void CaptureThread::run()
         /////////////////////////////////
         /////////////////////////////////
 
-        // Save capture time
-        captureTime=t.elapsed();
-        // Start timer (used to calculate capture rate)
-        t.start();
-
         // Synchronize with other streams (if enabled for this stream)
         sharedImageBuffer->sync(deviceNumber);
 
+        // Capture frame (if available)
+        if(!captureFrame())
+        {
+            // Source stalled or gone: reconnect with backoff, otherwise retry shortly (never spin)
+            if(health.grabFailed())
+                reconnect();
+            else
+                msleep(CAPTURE_RETRY_DELAY_MS);
+            reportHealth();
+        }
+    }
+    finishCapture();
+    qDebug() << "Stopping capture thread...";
+}
+
+void CaptureThread::finishCapture()
+{
+    // Let outstanding packets be decoded
+    if(mjpegDecoder)
+        mjpegDecoder->finish();
+}
+
+bool CaptureThread::captureFrame()
+{
+    struct AllocationCounts allocations=AllocationTracker::threadCounts();
+    // Capture frame (if available)
+    {
+        TraceScope trace("capture", "grab", deviceNumber);
+        if(!grabFrame())
+            return false;
+        trace.setSequence(grabbedFrame.sequence);
+    }
+    health.frameGrabbed();
+
+    // Measure capture rate
+    rate.tick();
+
+    // Compressed frame: decoded frame is added to buffer by the decoder pool (dropped if every decoder is busy)
+    if(mjpegDecoder)
+    {
+        if(!mjpegDecoder->decode(grabbedFrame))
+        {
+            statsData.nDecoderDropped++;
+            stats.add(STATS_DECODER_DROPPED);
+            TraceRecorder::instant("decoder", "drop", deviceNumber, grabbedFrame.sequence);
+        }
+    }
+    // Add frame to buffer
+    else
+        deliverFrame(grabbedFrame, dropFrameIfBufferFull);
+    // Buffer now holds the only reference (next grab must not write into a queued frame)
+    grabbedFrame.data.release();
+
+    // Update statistics
+    updateFPS();
+    statsData.frameAllocations=AllocationTracker::threadCounts()-allocations;
+    statsData.nFramesProcessed++;
+    statsData.currentCPU=getCurrentCPU();
+    statsData.captureHealth=health.getState();
+    statsData.nReconnects=health.getReconnectCount();
+    stats.add(STATS_CAPTURE_FRAMES);
+    stats.set(STATS_CAPTURE_FPS, (qint64)(statsData.averageFPS*1000));
+    stats.set(STATS_CAPTURE_JITTER_NS, (qint64)(statsData.jitterMs*1e6));
+    stats.set(STATS_CAPTURE_HEALTH, statsData.captureHealth);
+    stats.set(STATS_CAPTURE_RECONNECTS, statsData.nReconnects);
+    // Inform GUI of updated statistics
+    emit updateStatisticsInGUI(statsData);
+    return true;
+}
+
+bool CaptureThread::checkHealth()
+{
+    // Frames are arriving (or the camera is still within its stall timeout)
+    if(!health.grabFailed())
+        return false;
+    reportHealth();
+    // Backoff not over yet (caller polls again later)
+    return health.reconnectDue();
+}
+
+void CaptureThread::setProcessedByPool(bool processedByPool)
+{
+    this->processedByPool=processedByPool;
+}
+
+int CaptureThread::getFd()
+{
+    return v4l2Cap.getFd();
+}
+
+bool CaptureThread::grabFrame()
+{
+    // V4L2: frame is a view into a driver buffer (returned to the driver once released by processing)
+    if(captureBackend==CAPTURE_BACKEND_V4L2)
+    {
+        if(!v4l2Cap.grab(grabbedFrame))
+            return false;
+    }
+    // Replay: frame is a view into the mapped file
+    else if(captureBackend==CAPTURE_BACKEND_REPLAY)
+    {
+        if(!replayCap.grab(grabbedFrame))
+            return false;
+    }
+    else
+    {
         // Capture frame (if available)
         if (!cap.grab())
-            continue;
+            return false;
 
         // Retrieve frame
-        cap.retrieve(grabbedFrame);
-        // Add frame to buffer
-        sharedImageBuffer->getByDeviceNumber(deviceNumber)->add(grabbedFrame, dropFrameIfBufferFull);
+        grabbedFrame.timestamp=std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        // Frames allocated by the backend or copied here go into huge pages
+        retrievedFrame.allocator=HugePageAllocator::frameAllocator();
+        cap.retrieve(retrievedFrame);
+        // Raw frame may still point into the backend's buffer: copy it before the next grab reuses it
+        if(retrievedFrame.u)
+            grabbedFrame.data=retrievedFrame;
+        else
+        {
+            grabbedFrame.data=Mat();
+            grabbedFrame.data.allocator=HugePageAllocator::frameAllocator();
+            retrievedFrame.copyTo(grabbedFrame.data);
+        }
+        retrievedFrame.release();
+        grabbedFrame.sequence=sequence++;
+    }
+    // Truncated frame
+    return !grabbedFrame.empty();
+}
 
-        // Update statistics
-        updateFPS(captureTime);
-        statsData.nFramesProcessed++;
-        // Inform GUI of updated statistics
-        emit updateStatisticsInGUI(statsData);
+void CaptureThread::reconnect()
+{
+    // Back off (woken early by stop(), which must not wait for the reconnect itself)
+    {
+        QMutexLocker locker(&doStopMutex);
+        int delay=health.reconnectDelay();
+        if(!doStop && delay>0)
+            stopCondition.wait(&doStopMutex, delay);
+        if(doStop)
+            return;
     }
-    qDebug() << "Stopping capture thread...";
+    reconnectCamera();
+}
+
+void CaptureThread::reconnectCamera()
+{
+    qDebug() << "[" << deviceNumber << "] No frames from camera: reconnecting...";
+    disconnectCamera();
+    health.reconnectFinished(connectToCamera());
+    reportHealth();
+}
+
+void CaptureThread::reportHealth()
+{
+    // Only inform GUI on a change (statistics are not updated while no frames arrive)
+    if(statsData.captureHealth==health.getState() && statsData.nReconnects==health.getReconnectCount())
+        return;
+    statsData.captureHealth=health.getState();
+    statsData.nReconnects=health.getReconnectCount();
+    stats.set(STATS_CAPTURE_HEALTH, statsData.captureHealth);
+    stats.set(STATS_CAPTURE_RECONNECTS, statsData.nReconnects);
+    emit updateStatisticsInGUI(statsData);
 }
 
 bool CaptureThread::connectToCamera()
 {
+    // Open camera through V4L2 (one driver buffer per image buffer slot plus a few for the driver to fill)
+    if(captureBackend==CAPTURE_BACKEND_V4L2)
+    {
+        int nBuffers=sharedImageBuffer->getByDeviceNumber(deviceNumber)->maxSize()+V4L2_EXTRA_BUFFERS;
+        // Packets queued in the decoder pool hold driver buffers too
+        if(captureFormat==PIXEL_FORMAT_MJPEG && mjpegDecoding.mode!=MJPEG_DECODE_DEFERRED)
+            nBuffers+=MjpegDecoder::maxPacketsInFlight();
+        // Frames waiting to be matched with other streams (and the sets waiting for the consumer) hold driver buffers too
+        if(sharedImageBuffer->getFrameSynchronizer()->containsDevice(deviceNumber))
+            nBuffers+=FRAME_SYNC_MAX_PENDING+FRAME_SYNC_SET_BUFFER_SIZE;
+        bool result=v4l2Cap.open(QString("/dev/video%1").arg(deviceNumber), width, height, captureFormat,
+                                 qMin(nBuffers, V4L2_MAX_BUFFERS));
+        createMjpegDecoder(result ? captureFormat : PIXEL_FORMAT_BGR);
+        return result;
+    }
+    // Play back a replay file (format as recorded: the capture format is ignored)
+    if(captureBackend==CAPTURE_BACKEND_REPLAY)
+    {
+        bool result=replayCap.open(replayFile);
+        createMjpegDecoder(result ? replayCap.getPixelFormat() : PIXEL_FORMAT_BGR);
+        return result;
+    }
+
     // Open camera
     bool camOpenResult = cap.open(deviceNumber);
     // Set resolution
@@ -101,12 +294,119 @@ bool CaptureThread::connectToCamera()
         cap.set(CAP_PROP_FRAME_WIDTH, width);
     if(height != -1)
         cap.set(CAP_PROP_FRAME_HEIGHT, height);
+    // Request raw frames (falls back to BGR if the backend cannot deliver them)
+    grabbedFrame.pixelFormat=PIXEL_FORMAT_BGR;
+    if(camOpenResult && captureFormat!=PIXEL_FORMAT_BGR && !requestRawFormat())
+        qDebug() << "[" << deviceNumber << "] Raw capture format not supported: capturing BGR.";
+    grabbedFrame.width=cap.get(CAP_PROP_FRAME_WIDTH);
+    grabbedFrame.height=cap.get(CAP_PROP_FRAME_HEIGHT);
+    createMjpegDecoder(grabbedFrame.pixelFormat);
     // Return result
     return camOpenResult;
 }
 
+bool CaptureThread::requestRawFormat()
+{
+    int fourcc;
+    switch(captureFormat)
+    {
+        case PIXEL_FORMAT_YUYV:
+            fourcc=VideoWriter::fourcc('Y', 'U', 'Y', 'V');
+            break;
+        case PIXEL_FORMAT_NV12:
+            fourcc=VideoWriter::fourcc('N', 'V', '1', '2');
+            break;
+        case PIXEL_FORMAT_GREY:
+            fourcc=VideoWriter::fourcc('G', 'R', 'E', 'Y');
+            break;
+        case PIXEL_FORMAT_MJPEG:
+            fourcc=VideoWriter::fourcc('M', 'J', 'P', 'G');
+            break;
+        default:
+            return false;
+    }
+    // Device must accept the format and the backend must pass frames through unconverted
+    if(!cap.set(CAP_PROP_FOURCC, fourcc) || (int)cap.get(CAP_PROP_FOURCC)!=fourcc ||
+       !cap.set(CAP_PROP_CONVERT_RGB, 0))
+    {
+        cap.set(CAP_PROP_CONVERT_RGB, 1);
+        return false;
+    }
+    grabbedFrame.pixelFormat=captureFormat;
+    return true;
+}
+
+void CaptureThread::createMjpegDecoder(int pixelFormat)
+{
+    // Decode on the decoder pool instead of in the processing thread
+    if(pixelFormat==PIXEL_FORMAT_MJPEG && mjpegDecoding.mode!=MJPEG_DECODE_DEFERRED)
+    {
+        MjpegDecoder *decoder=new MjpegDecoder([this](const Frame &frame, bool dropIfFull) { deliverFrame(frame, dropIfFull); },
+                                               dropFrameIfBufferFull, mjpegDecoding.mode, mjpegDecoding.scaleDenom);
+        // Published under the stop mutex (stop() may be called at any time from the GUI thread)
+        QMutexLocker locker(&doStopMutex);
+        if(doStop)
+            decoder->stop();
+        mjpegDecoder=decoder;
+    }
+}
+
+void CaptureThread::deliverFrame(const Frame &frame, bool dropIfFull)
+{
+    TraceScope trace("capture", "deliver", deviceNumber, frame.sequence);
+    // Add frame to buffer
+    Buffer<Frame> *buffer=sharedImageBuffer->getByDeviceNumber(deviceNumber);
+    buffer->add(frame, dropIfFull);
+    // Statistics export: the buffer counts drops and waits itself
+    struct BufferStatistics bufferStats=buffer->getStatistics();
+    stats.set(STATS_BUFFER_DEPTH, bufferStats.size);
+    stats.set(STATS_BUFFER_DROPPED, bufferStats.nDropped);
+    stats.set(STATS_BUFFER_HIGH_WATER_MARK, bufferStats.highWaterMark);
+    stats.set(STATS_BUFFER_PRODUCER_WAIT_NS, bufferStats.producerWaitNs);
+    stats.set(STATS_BUFFER_CONSUMER_WAIT_NS, bufferStats.consumerWaitNs);
+    // Group with frames of other streams by capture time (if enabled for this stream, never blocks)
+    sharedImageBuffer->getFrameSynchronizer()->push(deviceNumber, frame);
+    // Publish to other processes (if enabled for this stream)
+    sharedImageBuffer->getFrameExporter()->exportFrame(deviceNumber, FRAME_EXPORT_RAW, frame);
+    // Record (if enabled for this stream, never blocks)
+    if(frameRecorder)
+    {
+        frameRecorder->record(RECORDER_STREAM_RAW, frame);
+        frameRecorder->record(RECORDER_STREAM_EVENTS, frame);
+        frameRecorder->record(RECORDER_STREAM_REPLAY, frame);
+    }
+    // Wake a processing pool worker
+    if(processedByPool)
+        ProcessingPool::instance()->frameAvailable();
+}
+
 bool CaptureThread::disconnectCamera()
 {
+    // Take the decoder away from stop() first (the stop mutex is not held while waiting for the pool)
+    doStopMutex.lock();
+    MjpegDecoder *decoder=mjpegDecoder;
+    mjpegDecoder=NULL;
+    doStopMutex.unlock();
+    // Stop decoder pool: frames decoded from now on are dropped if the image buffer is full, then outstanding packets are waited for
+    if(decoder)
+    {
+        decoder->stop();
+        delete decoder;
+    }
+    // V4L2 camera is connected
+    if(v4l2Cap.isOpened())
+    {
+        // Disconnect camera (buffers still queued for processing stay valid until released)
+        v4l2Cap.close();
+        return true;
+    }
+    // Replay file is open
+    if(replayCap.isOpened())
+    {
+        // Close file (frames still queued for processing stay valid until released)
+        replayCap.close();
+        return true;
+    }
     // Camera is connected
     if(cap.isOpened())
     {
@@ -119,50 +419,72 @@ bool CaptureThread::disconnectCamera()
         return false;
 }
 
-void CaptureThread::updateFPS(int timeElapsed)
+void CaptureThread::updateFPS()
 {
-    // Add instantaneous FPS value to queue
-    if(timeElapsed>0)
-    {
-        fps.enqueue((int)1000/timeElapsed);
-        // Increment sample number
-        sampleNumber++;
-    }
-    // Maximum size of queue is DEFAULT_CAPTURE_FPS_STAT_QUEUE_LENGTH
-    if(fps.size()>CAPTURE_FPS_STAT_QUEUE_LENGTH)
-        fps.dequeue();
-    // Update FPS value every DEFAULT_CAPTURE_FPS_STAT_QUEUE_LENGTH samples
-    if((fps.size()==CAPTURE_FPS_STAT_QUEUE_LENGTH)&&(sampleNumber==CAPTURE_FPS_STAT_QUEUE_LENGTH))
-    {
-        // Empty queue and store sum
-        while(!fps.empty())
-            fpsSum+=fps.dequeue();
-        // Calculate average FPS
-        statsData.averageFPS=fpsSum/CAPTURE_FPS_STAT_QUEUE_LENGTH;
-        // Reset sum
-        fpsSum=0;
-        // Reset sample number
-        sampleNumber=0;
-    }
+    statsData.averageFPS=rate.getRate();
+    statsData.windowFPS=rate.getWindowRate();
+    statsData.jitterMs=rate.getJitterMs();
+    statsData.minIntervalMs=rate.getMinIntervalMs();
+    statsData.maxIntervalMs=rate.getMaxIntervalMs();
+}
+
+void CaptureThread::setThreadPlacement(struct ThreadPlacement threadPlacement)
+{
+    this->threadPlacement=threadPlacement;
+}
+
+void CaptureThread::setFrameRecorder(FrameRecorder *frameRecorder)
+{
+    this->frameRecorder=frameRecorder;
+}
+
+void CaptureThread::setReplayFile(const QString &replayFile)
+{
+    this->replayFile=replayFile;
 }
 
 void CaptureThread::stop()
 {
     QMutexLocker locker(&doStopMutex);
     doStop=true;
+    // Interrupt reconnect backoff
+    stopCondition.wakeAll();
+    // Decoders must not block on a full image buffer while the thread is stopping
+    if(mjpegDecoder)
+        mjpegDecoder->stop();
 }
 
 bool CaptureThread::isCameraConnected()
 {
-    return cap.isOpened();
+    return cap.isOpened() || v4l2Cap.isOpened() || replayCap.isOpened();
 }
 
 int CaptureThread::getInputSourceWidth()
 {
-    return cap.get(CAP_PROP_FRAME_WIDTH);
+    int width;
+    if(captureBackend==CAPTURE_BACKEND_V4L2)
+        width=v4l2Cap.getWidth();
+    else if(captureBackend==CAPTURE_BACKEND_REPLAY)
+        width=replayCap.getWidth();
+    else
+        width=(int)cap.get(CAP_PROP_FRAME_WIDTH);
+    // Frames decoded at reduced scale
+    if(mjpegDecoder)
+        return (width+mjpegDecoder->getScaleDenom()-1)/mjpegDecoder->getScaleDenom();
+    return width;
 }
 
 int CaptureThread::getInputSourceHeight()
 {
-    return cap.get(CAP_PROP_FRAME_HEIGHT);
+    int height;
+    if(captureBackend==CAPTURE_BACKEND_V4L2)
+        height=v4l2Cap.getHeight();
+    else if(captureBackend==CAPTURE_BACKEND_REPLAY)
+        height=replayCap.getHeight();
+    else
+        height=(int)cap.get(CAP_PROP_FRAME_HEIGHT);
+    // Frames decoded at reduced scale
+    if(mjpegDecoder)
+        return (height+mjpegDecoder->getScaleDenom()-1)/mjpegDecoder->getScaleDenom();
+    return height;
 }
@@ -36,12 +36,27 @@
 // Qt
 #include <QtCore/QTime>
 #include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
 // OpenCV
 #include <opencv2/highgui/highgui.hpp>
 // Local
 #include "SharedImageBuffer.h"
 #include "Config.h"
 #include "Structures.h"
+#include "ThreadPlacement.h"
+#include "V4L2Capture.h"
+#include "ReplayCapture.h"
+#include "MjpegDecoder.h"
+#include "CaptureHealthMonitor.h"
+#include "ProcessingPool.h"
+#include "FrameRecorder.h"
+#include "StatsRegistry.h"
+#include "RateEstimator.h"
+#include "TraceRecorder.h"
+#include "AllocationTracker.h"
+#include "HugePageAllocator.h"
+// C++
+#include <chrono>
 
 using namespace cv;
 
@@ -52,37 +67,67 @@ class CaptureThread : public QThread
     Q_OBJECT
 
     public:
-        CaptureThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber, bool dropFrameIfBufferFull, int width, int height);
+        CaptureThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber, bool dropFrameIfBufferFull, int width, int height, int captureBackend, int captureFormat,
+                      struct MjpegDecoding mjpegDecoding);
         void stop();
+        void setThreadPlacement(struct ThreadPlacement threadPlacement);
+        void setFrameRecorder(FrameRecorder *frameRecorder);
+        void setReplayFile(const QString &replayFile);
         bool connectToCamera();
         bool disconnectCamera();
         bool isCameraConnected();
         int getInputSourceWidth();
         int getInputSourceHeight();
+        // Event-driven capture (CaptureEngine): called instead of running the thread, never block
+        int getFd();
+        bool captureFrame();
+        // True if the camera stalled and is due to be reconnected with reconnectCamera() (which blocks while the device is reopened)
+        bool checkHealth();
+        void reconnectCamera();
+        void setProcessedByPool(bool processedByPool);
+        void finishCapture();
 
     private:
-        void updateFPS(int);
+        void updateFPS();
+        bool grabFrame();
+        void reconnect();
+        void reportHealth();
+        void deliverFrame(const Frame &frame, bool dropIfFull);
+        bool requestRawFormat();
+        void createMjpegDecoder(int pixelFormat);
         SharedImageBuffer *sharedImageBuffer;
+        StatsBlock stats;
         VideoCapture cap;
-        Mat grabbedFrame;
-        QTime t;
+        V4L2Capture v4l2Cap;
+        ReplayCapture replayCap;
+        MjpegDecoder *mjpegDecoder;
+        Frame grabbedFrame;
+        Mat retrievedFrame;
+        RateEstimator rate;
         QMutex doStopMutex;
-        QQueue<int> fps;
+        QWaitCondition stopCondition;
+        CaptureHealthMonitor health;
         struct ThreadStatisticsData statsData;
+        struct ThreadPlacement threadPlacement;
+        FrameRecorder *frameRecorder;
         volatile bool doStop;
-        int captureTime;
-        int sampleNumber;
-        int fpsSum;
         bool dropFrameIfBufferFull;
+        bool processedByPool;
         int deviceNumber;
         int width;
         int height;
+        int captureBackend;
+        int captureFormat;
+        struct MjpegDecoding mjpegDecoding;
+        QString replayFile;
+        quint64 sequence;
 
     protected:
         void run();
 
     signals:
         void updateStatisticsInGUI(struct ThreadStatisticsData);
+        void updateThreadPlacementInGUI(QString);
 };
 
 #endif // CAPTURETHREAD_H
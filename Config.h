@@ -33,17 +33,188 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-// FPS statistics queue lengths
-#define PROCESSING_FPS_STAT_QUEUE_LENGTH    32
-#define CAPTURE_FPS_STAT_QUEUE_LENGTH       32
+// FPS statistics: frames in the window (windowed rate, jitter, min/max interval) and weight of the newest frame in the average rate
+#define RATE_ESTIMATOR_WINDOW               64
+#define RATE_ESTIMATOR_EWMA_ALPHA           0.05
 
 // Image buffer size
 #define DEFAULT_IMAGE_BUFFER_SIZE           1
 // Drop frame if image/frame buffer is full
 #define DEFAULT_DROP_FRAMES                 false
+// Capture backend
+#define DEFAULT_CAPTURE_BACKEND             0 // Options: [OPENCV=0,V4L2=1,REPLAY FILE=2]
+// Pixel format requested from the device (raw formats are converted only when needed)
+#define DEFAULT_CAPTURE_FORMAT              0 // Options: [BGR=0,YUYV=1,NV12=2,GREY=3,MJPEG=4]
+
+// MJPEG DECODING
+#define DEFAULT_MJPEG_DECODE_MODE           0 // Options: [DEFERRED (processing thread)=0,POOL COLOUR=1,POOL GREY=2]
+#define DEFAULT_MJPEG_SCALE_DENOM           1 // Options: [1,2,4,8]
+// Decoder pool threads (0: half the cores)
+#define MJPEG_DECODER_THREADS               0
+// Packets outstanding per decoder thread before capture waits (or drops)
+#define MJPEG_PACKETS_PER_DECODER_THREAD    2
+
+// V4L2 CAPTURE
+// Driver buffers mapped in addition to the image buffer size (frames held by capture/processing + driver queue)
+#define V4L2_EXTRA_BUFFERS                  4
+#define V4L2_MAX_BUFFERS                    32
+// Time to wait for a frame before giving up on a grab
+#define V4L2_DEQUEUE_TIMEOUT_MS             1000
+
+// REPLAY
+// Frame replay files (Replay File capture backend, written by "Record Replay File" in the camera context menu)
+#define REPLAY_FILE_EXTENSION               ".frames"
+// Frame data in replay files starts at multiples of this (page size: frames are used in place from the mapping)
+#define REPLAY_DATA_ALIGNMENT               4096
+// Start again with the first frame at the end of the file
+#define REPLAY_LOOP                         1
+// Play frames at the rate they were captured (0: as fast as processing takes them)
+#define REPLAY_REALTIME                     0
+// Files up to this size are read into the page cache when opened, larger files window by window while playing
+#define REPLAY_PRELOAD_MAX_BYTES            (1024LL*1024*1024)
+#define REPLAY_READAHEAD_FRAMES             64
+// TIMESTAMP SYNCHRONIZATION
+// Maximum difference between the capture times of frames grouped into one set
+#define FRAME_SYNC_TOLERANCE_US             8000
+// Frames held per device while waiting for the other devices
+#define FRAME_SYNC_MAX_PENDING              3
+// Frame sets waiting for the consumer
+#define FRAME_SYNC_SET_BUFFER_SIZE          2
+// Multi-view marker triangulation (started when two or more calibrated cameras are synchronized by capture time)
+#define MULTIVIEW_CALIBRATION_FILE          "resources/multiview_calibration.yml"
+#define MULTIVIEW_MARKER_SIZE               0.145 // Metres (overridden by the calibration file)
+// Interval of the synchronization statistics shown in the status bar
+#define FRAME_SYNC_STATS_INTERVAL_MS        1000
+
+// SHARED-MEMORY FRAME EXPORT
+// POSIX shared memory object name: prefix + device number + "-raw"/"-processed" (camera context menu)
+#define SHM_EXPORT_NAME_PREFIX              "/qt-opencv-frames-"
+// Frames kept in each ring (readers have this many frame intervals to finish with a frame)
+#define SHM_EXPORT_SLOTS                    4
+
+// RECORDING
+// Directory the segment files are written to (camera context menu)
+#define RECORDER_DIRECTORY                  "recordings"
+#define RECORDER_FOURCC                     'M','J','P','G'
+#define RECORDER_FILE_EXTENSION             ".avi"
+// Nominal frame rate stored in the files
+#define RECORDER_FPS                        30
+// A new file is started after this many seconds (of capture time)
+#define RECORDER_SEGMENT_SECONDS            300
+// Frames waiting for the encoder (per stream): frames beyond this are dropped
+#define RECORDER_QUEUE_LENGTH               32
+// What to drop when the encoder/disk falls behind
+#define DEFAULT_RECORDER_DROP_POLICY        0 // Options: [NEWEST (when queue full)=0,DECIMATE (every other frame when queue half full)=1]
+// Recorder thread checks its queues at this interval when idle
+#define RECORDER_POLL_INTERVAL_MS           5
+// Event clips: seconds kept before a trigger (memory permitting) and recorded after the last one
+#define RECORDER_EVENT_PRE_SECONDS          10
+#define RECORDER_EVENT_POST_SECONDS         5
+// Upper bound on the memory used by the pre-event ring (per camera)
+#define RECORDER_EVENT_BUFFER_MAX_BYTES     (64*1024*1024)
+// Quality raw (non-MJPEG) frames are compressed with for the pre-event ring
+#define RECORDER_EVENT_JPEG_QUALITY         80
+#define RECORDER_EVENT_FILE_EXTENSION       ".mjpeg"
+// Triggers waiting for the recorder thread: triggers beyond this are dropped (the clip is already triggered)
+#define RECORDER_TRIGGER_QUEUE_LENGTH       16
+
+// RESULT PUBLISHING
+// Unix domain socket the detection results are streamed to (Options menu)
+#define RESULT_PUBLISHER_SOCKET_PATH        "/tmp/qt-opencv-results.sock"
+#define RESULT_PUBLISHER_MAX_CLIENTS        8
+// Batches are sent when this size is reached, or at this interval
+#define RESULT_PUBLISHER_BATCH_BYTES        16384
+#define RESULT_PUBLISHER_BATCH_INTERVAL_MS  5
+// Records are dropped when the writer falls this far behind
+#define RESULT_PUBLISHER_MAX_BATCH_BYTES    1048576
+// Batches are dropped for a client with this much unsent data
+#define RESULT_PUBLISHER_MAX_CLIENT_BACKLOG 4194304
+
+// STATISTICS EXPORT
+// HTTP endpoint serving the statistics of all cameras in Prometheus text format at /metrics (Options menu)
+// Note: This machine only; set to "0.0.0.0" (or one interface's address) to be scraped over the network (the endpoint has no authentication)
+#define STATS_SERVER_ADDRESS                "127.0.0.1"
+#define STATS_SERVER_PORT                   9464
+// Time a client gets to send its request (and to take the response)
+#define STATS_SERVER_REQUEST_TIMEOUT_MS     1000
+#define STATS_SERVER_MAX_REQUEST_BYTES      8192
+
+// HUGE PAGES
+// Frame buffers (capture copies, decoded frames, processing scratch) can be allocated from 2 MB pages to cut TLB misses
+// (opt-in: each buffer is rounded up to a multiple of 2 MB, e.g. a 2.76 MB 720p BGR frame takes 4 MB)
+#define DEFAULT_HUGE_PAGE_MODE              0 // Options: [OFF=0,TRANSPARENT=1,EXPLICIT (falls back to transparent)=2]
+// Smaller buffers are left to the default allocator
+#define HUGE_PAGE_MIN_BYTES                 (1024*1024)
+// Freed regions kept for reuse (frames are allocated and freed at the frame rate)
+#define HUGE_PAGE_CACHE_REGIONS             16
+
+// TRACING
+// Directory the trace files are written to when tracing is stopped (Options menu)
+#define TRACE_DIRECTORY                     "traces"
+// Events kept per thread (the oldest are overwritten; 48 bytes each)
+#define TRACE_BUFFER_EVENTS                 16384
+
+// CAPTURE HEALTH
+// Time without a frame after which the camera is considered stalled and is reconnected
+#define CAPTURE_STALL_TIMEOUT_MS            3000
+// Delay between failed grabs (before the stall timeout is reached)
+#define CAPTURE_RETRY_DELAY_MS              10
+// Reconnect backoff (doubled after every attempt until a frame arrives)
+#define CAPTURE_RECONNECT_MIN_BACKOFF_MS    500
+#define CAPTURE_RECONNECT_MAX_BACKOFF_MS    30000
+// Failed attempts after which the camera is reported as failed (reconnecting continues)
+#define CAPTURE_MAX_RECONNECT_ATTEMPTS      5
+
 // Thread priorities
 #define DEFAULT_CAP_THREAD_PRIO             QThread::NormalPriority
 #define DEFAULT_PROC_THREAD_PRIO            QThread::HighPriority
+// Thread scheduling policy (Linux only)
+#define DEFAULT_SCHED_POLICY                0 // Options: [DEFAULT=0,FIFO=1,RR=2]
+// Real-time priorities used with the FIFO/RR policies [1-99]
+#define CAPTURE_RT_PRIORITY                 20
+#define PROCESSING_RT_PRIORITY              10
+
+// SHARED THREADING
+#define DEFAULT_THREADING_MODE              0 // Options: [DEDICATED THREADS=0,SHARED CAPTURE ENGINE + PROCESSING POOL=1]
+// Capture engine I/O threads (0: one per four cores)
+#define CAPTURE_ENGINE_IO_THREADS           0
+// Events handled per wait, and wait timeout (cameras are health-checked at this interval)
+#define CAPTURE_ENGINE_MAX_EVENTS           16
+#define CAPTURE_ENGINE_TICK_MS              100
+// Processing pool threads (0: one per core)
+#define PROCESSING_POOL_THREADS             0
+// Idle workers re-check the camera buffers at this interval
+#define PROCESSING_POOL_IDLE_WAIT_MS        50
+// Per-camera processing rate budget (0: as fast as possible) and share of the pool
+#define DEFAULT_POOL_TARGET_FPS             0
+#define DEFAULT_POOL_PRIORITY               1 // Options: [LOW=0,NORMAL=1,HIGH=2]
+// Smoothing factor of the measured per-frame cost
+#define POOL_COST_EWMA_ALPHA                0.1
+
+// PARALLEL PROCESSING
+// Minimum number of rows in a preprocessing tile
+#define PARALLEL_MIN_TILE_ROWS              64
+// Overlap between neighbouring ArUco tiles (fraction of the larger frame dimension)
+#define ARUCO_TILE_OVERLAP                  0.15
+// Number of scale bands the face cascade search is split into
+#define CASCADE_SCALE_BANDS                 4
+// Frames after a resolution/ROI/settings change after which the scratch buffers of a frame are expected not to change
+// Note: Debug builds warn if one is reallocated after that (other than because a recorder/export/display still holds it)
+#define FRAME_ARENA_WARMUP_FRAMES           30
+
+// DETECTION GOVERNOR
+// Processing rate the governor tries to sustain (default, set per camera in the image processing settings)
+#define DEFAULT_GOVERNOR_TARGET_FPS         30
+// Maximum number of frames between two runs of each detection stage
+#define GOVERNOR_MAX_ARUCO_INTERVAL         2
+#define GOVERNOR_MAX_FACE_INTERVAL          6
+#define GOVERNOR_MAX_EYE_INTERVAL           15
+// Minimum number of frames between two schedule changes
+#define GOVERNOR_ADJUST_FRAMES              8
+// Smoothing factor of the frame/stage time averages
+#define GOVERNOR_EWMA_ALPHA                 0.2
+// Stages are only restored when frame time is below this fraction of the budget
+#define GOVERNOR_HEADROOM                   0.75
 
 // IMAGE PROCESSING
 // Smooth
@@ -0,0 +1,175 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* DetectionGovernor.cpp                                                */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "DetectionGovernor.h"
+
+DetectionGovernor::DetectionGovernor()
+{
+    // Initialize members
+    enabled=false;
+    frameTimeMs=0;
+    framesSinceAdjust=0;
+    setTargetFPS(DEFAULT_GOVERNOR_TARGET_FPS);
+    for(int i=0; i<N_DETECTION_STAGES; i++)
+    {
+        active[i]=false;
+        interval[i]=1;
+        framesSinceRun[i]=0;
+        costMs[i]=0;
+        nRuns[i]=0;
+        detectionRate[i]=0;
+    }
+    maxInterval[STAGE_ARUCO]=GOVERNOR_MAX_ARUCO_INTERVAL;
+    maxInterval[STAGE_FACES]=GOVERNOR_MAX_FACE_INTERVAL;
+    maxInterval[STAGE_EYES]=GOVERNOR_MAX_EYE_INTERVAL;
+    rateTimer.start();
+}
+
+void DetectionGovernor::setEnabled(bool enable)
+{
+    // Run every stage on every frame again when disabled
+    if(enabled && !enable)
+    {
+        for(int i=0; i<N_DETECTION_STAGES; i++)
+            interval[i]=1;
+    }
+    enabled=enable;
+}
+
+void DetectionGovernor::setTargetFPS(double targetFPS)
+{
+    // Settings not received yet: keep the current target
+    if(targetFPS<=0)
+        return;
+    frameBudgetMs=1000.0/targetFPS;
+}
+
+void DetectionGovernor::setStageActive(DetectionStage stage, bool active)
+{
+    this->active[stage]=active;
+}
+
+bool DetectionGovernor::shouldRun(DetectionStage stage)
+{
+    if(!enabled)
+        return true;
+    return framesSinceRun[stage]+1>=interval[stage];
+}
+
+bool DetectionGovernor::shouldRunEyes(bool facesChanged)
+{
+    // Eyes only need to be searched again if the faces moved (or on their own schedule)
+    if(!enabled)
+        return true;
+    return facesChanged || shouldRun(STAGE_EYES);
+}
+
+void DetectionGovernor::stageFinished(DetectionStage stage, double costMs)
+{
+    this->costMs[stage]=(this->costMs[stage]==0) ? costMs :
+                        GOVERNOR_EWMA_ALPHA*costMs+(1.0-GOVERNOR_EWMA_ALPHA)*this->costMs[stage];
+    // Counter is incremented to zero in frameFinished()
+    framesSinceRun[stage]=-1;
+    nRuns[stage]++;
+}
+
+void DetectionGovernor::frameFinished(double busyMs, bool backlog)
+{
+    // Update counters
+    for(int i=0; i<N_DETECTION_STAGES; i++)
+        framesSinceRun[i]++;
+    frameTimeMs=(frameTimeMs==0) ? busyMs :
+                GOVERNOR_EWMA_ALPHA*busyMs+(1.0-GOVERNOR_EWMA_ALPHA)*frameTimeMs;
+
+    // Adjust schedule (give the frame time average a few frames to settle after each change)
+    if(enabled && ++framesSinceAdjust>=GOVERNOR_ADJUST_FRAMES)
+    {
+        if(backlog || frameTimeMs>frameBudgetMs)
+            throttle();
+        else if(frameTimeMs<GOVERNOR_HEADROOM*frameBudgetMs)
+            restore();
+    }
+
+    // Effective detection rates (runs per second)
+    qint64 elapsed=rateTimer.elapsed();
+    if(elapsed>=1000)
+    {
+        for(int i=0; i<N_DETECTION_STAGES; i++)
+        {
+            detectionRate[i]=nRuns[i]*1000.0/elapsed;
+            nRuns[i]=0;
+        }
+        rateTimer.restart();
+    }
+}
+
+void DetectionGovernor::throttle()
+{
+    // Lowest priority stage first
+    for(int i=N_DETECTION_STAGES-1; i>=0; i--)
+    {
+        if(active[i] && interval[i]<maxInterval[i])
+        {
+            interval[i]++;
+            framesSinceAdjust=0;
+            return;
+        }
+    }
+}
+
+void DetectionGovernor::restore()
+{
+    // Highest priority stage first, but only if its cost fits in the spare time
+    for(int i=0; i<N_DETECTION_STAGES; i++)
+    {
+        if(active[i] && interval[i]>1)
+        {
+            double extraMs=costMs[i]/(interval[i]-1)-costMs[i]/interval[i];
+            if(frameTimeMs+extraMs<frameBudgetMs)
+            {
+                interval[i]--;
+                framesSinceAdjust=0;
+            }
+            return;
+        }
+    }
+}
+
+double DetectionGovernor::getDetectionRate(DetectionStage stage)
+{
+    return detectionRate[stage];
+}
+
+int DetectionGovernor::getInterval(DetectionStage stage)
+{
+    return interval[stage];
+}
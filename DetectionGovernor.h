@@ -0,0 +1,83 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* DetectionGovernor.h                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef DETECTIONGOVERNOR_H
+#define DETECTIONGOVERNOR_H
+
+// Qt
+#include <QtCore/QElapsedTimer>
+// Local
+#include "Config.h"
+
+enum DetectionStage{
+    STAGE_ARUCO=0,
+    STAGE_FACES=1,
+    STAGE_EYES=2,
+    N_DETECTION_STAGES=3
+};
+
+// Decides per frame which detection stages run so that processing keeps up with
+// the target frame rate. Skipped stages reuse the results of their last run.
+// Stages are throttled in order of increasing priority (eyes, faces, ArUco) and
+// restored in the opposite order once there is headroom again.
+class DetectionGovernor
+{
+    public:
+        DetectionGovernor();
+        void setEnabled(bool enable);
+        void setTargetFPS(double targetFPS);
+        void setStageActive(DetectionStage stage, bool active);
+        bool shouldRun(DetectionStage stage);
+        bool shouldRunEyes(bool facesChanged);
+        void stageFinished(DetectionStage stage, double costMs);
+        void frameFinished(double busyMs, bool backlog);
+        double getDetectionRate(DetectionStage stage);
+        int getInterval(DetectionStage stage);
+
+    private:
+        void throttle();
+        void restore();
+        bool enabled;
+        double frameBudgetMs;
+        double frameTimeMs;
+        int framesSinceAdjust;
+        bool active[N_DETECTION_STAGES];
+        int interval[N_DETECTION_STAGES];
+        int maxInterval[N_DETECTION_STAGES];
+        int framesSinceRun[N_DETECTION_STAGES];
+        double costMs[N_DETECTION_STAGES];
+        int nRuns[N_DETECTION_STAGES];
+        double detectionRate[N_DETECTION_STAGES];
+        QElapsedTimer rateTimer;
+};
+
+#endif // DETECTIONGOVERNOR_H
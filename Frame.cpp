@@ -0,0 +1,177 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* Frame.cpp                                                            */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "Frame.h"
+// OpenCV
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+bool Frame::empty() const
+{
+    if(data.empty())
+        return true;
+    // Truncated raw frame
+    size_t bytes=data.total()*data.elemSize();
+    switch(pixelFormat)
+    {
+        case PIXEL_FORMAT_YUYV:
+            return bytes<(size_t)width*height*2;
+        case PIXEL_FORMAT_NV12:
+            return bytes<(size_t)width*height*3/2;
+        case PIXEL_FORMAT_GREY:
+            return bytes<(size_t)width*height;
+        default:
+            return false;
+    }
+}
+
+bool Frame::hasLumaPlane() const
+{
+    // Grey image available without decoding or colour conversion
+    return pixelFormat==PIXEL_FORMAT_YUYV || pixelFormat==PIXEL_FORMAT_NV12 || pixelFormat==PIXEL_FORMAT_GREY;
+}
+
+bool Frame::sharesData(const Mat &image) const
+{
+    return image.u==data.u;
+}
+
+bool Frame::isDeviceBuffer() const
+{
+    return data.u && dynamic_cast<const DeviceBufferAllocator*>(data.u->currAllocator)!=NULL;
+}
+
+Frame Frame::detached() const
+{
+    Frame frame=*this;
+    if(isDeviceBuffer())
+        frame.data=data.clone();
+    return frame;
+}
+
+Mat Frame::gray() const
+{
+    Mat grey;
+    switch(pixelFormat)
+    {
+        // Luma plane is the top part of the frame (no copy)
+        case PIXEL_FORMAT_NV12:
+            return shaped(height*3/2, CV_8UC1).rowRange(0, height);
+        case PIXEL_FORMAT_GREY:
+            return shaped(height, CV_8UC1);
+        // Luma is every other byte
+        case PIXEL_FORMAT_YUYV:
+            extractChannel(shaped(height, CV_8UC2), grey, 0);
+            return grey;
+        // Decoder skips the chroma planes
+        case PIXEL_FORMAT_MJPEG:
+            return imdecode(data, IMREAD_GRAYSCALE);
+        default:
+            cvtColor(data, grey, data.channels()==4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+            return grey;
+    }
+}
+
+Mat Frame::bgr() const
+{
+    Mat colour;
+    switch(pixelFormat)
+    {
+        case PIXEL_FORMAT_YUYV:
+            cvtColor(shaped(height, CV_8UC2), colour, COLOR_YUV2BGR_YUYV);
+            return colour;
+        case PIXEL_FORMAT_NV12:
+            cvtColor(shaped(height*3/2, CV_8UC1), colour, COLOR_YUV2BGR_NV12);
+            return colour;
+        case PIXEL_FORMAT_GREY:
+            cvtColor(shaped(height, CV_8UC1), colour, COLOR_GRAY2BGR);
+            return colour;
+        case PIXEL_FORMAT_MJPEG:
+            return imdecode(data, IMREAD_COLOR);
+        default:
+            return data;
+    }
+}
+
+void Frame::copyGrayTo(Mat &dst) const
+{
+    switch(pixelFormat)
+    {
+        case PIXEL_FORMAT_NV12:
+            shaped(height*3/2, CV_8UC1).rowRange(0, height).copyTo(dst);
+            break;
+        case PIXEL_FORMAT_GREY:
+            shaped(height, CV_8UC1).copyTo(dst);
+            break;
+        case PIXEL_FORMAT_YUYV:
+            extractChannel(shaped(height, CV_8UC2), dst, 0);
+            break;
+        case PIXEL_FORMAT_MJPEG:
+            imdecode(data, IMREAD_GRAYSCALE, &dst);
+            break;
+        default:
+            cvtColor(data, dst, data.channels()==4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+            break;
+    }
+}
+
+void Frame::copyBgrTo(Mat &dst) const
+{
+    switch(pixelFormat)
+    {
+        case PIXEL_FORMAT_YUYV:
+            cvtColor(shaped(height, CV_8UC2), dst, COLOR_YUV2BGR_YUYV);
+            break;
+        case PIXEL_FORMAT_NV12:
+            cvtColor(shaped(height*3/2, CV_8UC1), dst, COLOR_YUV2BGR_NV12);
+            break;
+        case PIXEL_FORMAT_GREY:
+            cvtColor(shaped(height, CV_8UC1), dst, COLOR_GRAY2BGR);
+            break;
+        case PIXEL_FORMAT_MJPEG:
+            imdecode(data, IMREAD_COLOR, &dst);
+            break;
+        default:
+            data.copyTo(dst);
+            break;
+    }
+}
+
+Mat Frame::shaped(int rows, int type) const
+{
+    // Already in the layout of the pixel format
+    if(data.rows==rows && data.type()==type)
+        return data;
+    // Some backends deliver raw frames as a single row of bytes (size checked by empty())
+    size_t bytes=(size_t)rows*width*CV_ELEM_SIZE(type);
+    return data.reshape(1, 1).colRange(0, (int)bytes).reshape(CV_MAT_CN(type), rows);
+}
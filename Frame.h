@@ -0,0 +1,89 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* Frame.h                                                              */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+// Qt
+#include <QtCore/QtGlobal>
+// OpenCV
+#include <opencv2/core.hpp>
+
+using namespace cv;
+
+enum PixelFormat{
+    PIXEL_FORMAT_BGR=0,
+    PIXEL_FORMAT_YUYV=1,
+    PIXEL_FORMAT_NV12=2,
+    PIXEL_FORMAT_GREY=3,
+    PIXEL_FORMAT_MJPEG=4
+};
+
+// Allocator of Mats wrapping buffers mapped from a device or file (V4L2 driver
+// buffers, replay files), as opposed to memory of our own (std, huge pages,
+// allocation tracking). Frames held for long are copied out of these buffers.
+class DeviceBufferAllocator : public MatAllocator
+{
+};
+
+// A captured frame in the format delivered by the device. Raw formats are kept
+// as they are: grey and colour images are only produced when asked for.
+struct Frame{
+    Frame() : pixelFormat(PIXEL_FORMAT_BGR), width(0), height(0), timestamp(0), sequence(0) {}
+    Mat data;
+    int pixelFormat;
+    int width;
+    int height;
+    // Capture time (monotonic clock, microseconds)
+    qint64 timestamp;
+    quint64 sequence;
+
+    // True if there is no data or a raw frame is truncated
+    bool empty() const;
+    bool hasLumaPlane() const;
+    bool sharesData(const Mat &image) const;
+    // True if the data is a buffer mapped from the device or a replay file (see DeviceBufferAllocator)
+    bool isDeviceBuffer() const;
+    // Frame with its own copy of the data if it is a device buffer (frames held for long must not starve capture)
+    Frame detached() const;
+    // Converted images may share data with the frame (must not be modified)
+    Mat gray() const;
+    Mat bgr() const;
+    // Same, always copied into dst (its buffer is reused if it has the right size)
+    void copyGrayTo(Mat &dst) const;
+    void copyBgrTo(Mat &dst) const;
+
+    private:
+        Mat shaped(int rows, int type) const;
+};
+
+#endif // FRAME_H
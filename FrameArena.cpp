@@ -0,0 +1,146 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameArena.cpp                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "FrameArena.h"
+// Qt
+#include <QDebug>
+// Local
+#include "Config.h"
+#include "HugePageAllocator.h"
+
+FrameArena::FrameArena()
+{
+    settingsVersion=0;
+    frameAllocations=AllocationCounts();
+    clear();
+}
+
+void FrameArena::clear()
+{
+    for(int i=0; i<FRAME_ARENA_IMAGES; i++)
+    {
+        images[i].release();
+        lastData[i]=NULL;
+    }
+    tileIds.clear();
+    tileCorners.clear();
+    tileParameters.clear();
+    bandFaces.clear();
+    frameSize=Size();
+    roi=Rect();
+    nFrames=0;
+    nReleasedShared=0;
+    warned=false;
+}
+
+bool FrameArena::beginFrame(Size frameSize, Rect roi, quint64 settingsVersion)
+{
+    // New resolution or ROI: buffers (and tile parameters) no longer fit
+    bool geometryChanged=(frameSize!=this->frameSize || roi!=this->roi);
+    if(geometryChanged)
+    {
+        clear();
+        this->frameSize=frameSize;
+        this->roi=roi;
+    }
+    // New settings (e.g. grey output): buffers may legitimately change
+    else if(settingsVersion!=this->settingsVersion)
+    {
+        nFrames=0;
+        warned=false;
+    }
+    this->settingsVersion=settingsVersion;
+    nReleasedShared=0;
+    return geometryChanged;
+}
+
+void FrameArena::endFrame()
+{
+    int nReplaced=0;
+    for(int i=0; i<FRAME_ARENA_IMAGES; i++)
+    {
+        void *data=images[i].u;
+        if(data!=lastData[i] && lastData[i])
+            nReplaced++;
+        lastData[i]=data;
+    }
+    nFrames++;
+#ifndef QT_NO_DEBUG
+    // Steady state: a replaced buffer means something on the frame path allocates again
+    if(nFrames>FRAME_ARENA_WARMUP_FRAMES && nReplaced>nReleasedShared && !warned)
+    {
+        qWarning() << "FrameArena: scratch buffer reallocated in steady state (frame" << nFrames << "since reset)";
+        warned=true;
+    }
+    // Allocation tracking build: no allocation at all by this project's code (vectors, Ptr, QString, QImage...;
+    // OpenCV internals are not counted) unless a buffer held elsewhere had to be replaced
+    if(AllocationTracker::isEnabled() && nFrames>FRAME_ARENA_WARMUP_FRAMES && nReleasedShared==0 && !warned &&
+       (frameAllocations.nHeap>0 || frameAllocations.nMat>0))
+    {
+        qWarning() << "FrameArena:" << frameAllocations.nHeap << "heap and" << frameAllocations.nMat <<
+                      "Mat allocations on the frame path in steady state (frame" << nFrames << "since reset)";
+        warned=true;
+    }
+#else
+    Q_UNUSED(nReplaced);
+#endif
+    frameAllocations=AllocationCounts();
+}
+
+void FrameArena::addAllocations(const struct AllocationCounts &counts)
+{
+    frameAllocations.nHeap+=counts.nHeap;
+    frameAllocations.heapBytes+=counts.heapBytes;
+    frameAllocations.nMat+=counts.nMat;
+    frameAllocations.matBytes+=counts.matBytes;
+}
+
+Mat& FrameArena::image(int slot, Size size, int type)
+{
+    Mat &buffer=images[slot];
+    // Still held elsewhere: leave it to its holder
+    if(buffer.u && CV_XADD(&buffer.u->refcount, 0)>1)
+    {
+        buffer.release();
+        nReleasedShared++;
+    }
+    // No-op if the size and type are unchanged (new buffers come from huge pages)
+    buffer.allocator=HugePageAllocator::frameAllocator();
+    buffer.create(size, type);
+    return buffer;
+}
+
+Mat& FrameArena::frameBuffer(const Mat &current, Size size, int type)
+{
+    int slot=(current.u && current.u==images[FRAME_ARENA_FRAME_A].u) ? FRAME_ARENA_FRAME_B : FRAME_ARENA_FRAME_A;
+    return image(slot, size, type);
+}
@@ -0,0 +1,110 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameArena.h                                                         */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+// C++
+#include <vector>
+// Local
+#include "AllocationTracker.h"
+#include "Structures.h"
+
+using namespace cv;
+using namespace std;
+
+// Scratch images and vectors of one frame context, sized on first use and kept
+// from frame to frame, so a frame of the same geometry as the last one needs no
+// new buffers. Everything is dropped when the resolution or ROI changes. An
+// image still referenced elsewhere (queued for recording, export or display) is
+// left to its holder and a new one is made.
+class FrameArena
+{
+    public:
+        FrameArena();
+        // Start of a frame: drops everything if the geometry changed (settings changes restart the warm-up only)
+        // Returns true if the geometry changed (or on the first frame)
+        bool beginFrame(Size frameSize, Rect roi, quint64 settingsVersion);
+        // End of a frame: checks that no buffer was replaced once warmed up (debug builds), and
+        // that nothing on the frame path allocated at all (allocation tracking builds)
+        void endFrame();
+        // Allocations made for the current frame (see FrameArenaScope)
+        void addAllocations(const struct AllocationCounts &counts);
+        // Image of the slot with the given size and type (to be written into)
+        Mat& image(int slot, Size size, int type);
+        // Frame buffer the current frame is not in (filters swap between the two)
+        Mat& frameBuffer(const Mat &current, Size size, int type);
+        void clear();
+
+        // Detection scratch (cleared, never shrunk)
+        vector<vector<int>> tileIds;
+        vector<vector<vector<Point2f>>> tileCorners;
+        // Detector parameters of each ArUco tile (depend on the tile size only)
+        vector<Ptr<aruco::DetectorParameters>> tileParameters;
+        vector<vector<Rect>> bandFaces;
+
+    private:
+        Mat images[FRAME_ARENA_IMAGES];
+        // Buffers at the end of the last frame (to tell when one was replaced)
+        void *lastData[FRAME_ARENA_IMAGES];
+        Size frameSize;
+        Rect roi;
+        quint64 settingsVersion;
+        int nFrames;
+        // Images replaced this frame because they were still held elsewhere
+        int nReleasedShared;
+        struct AllocationCounts frameAllocations;
+        bool warned;
+};
+
+// Charges the allocations the calling thread makes while in scope (one stage of
+// a frame, including worker pool tasks it starts) to the frame of the arena.
+// Does nothing unless built with allocation tracking.
+class FrameArenaScope
+{
+    public:
+#ifdef ALLOCATION_TRACKING
+        FrameArenaScope(FrameArena &arena) : arena(arena), start(AllocationTracker::threadCounts()) {}
+        ~FrameArenaScope() { arena.addAllocations(AllocationTracker::threadCounts()-start); }
+
+    private:
+        FrameArena &arena;
+        struct AllocationCounts start;
+#else
+        FrameArenaScope(FrameArena &arena) { Q_UNUSED(arena); }
+#endif
+};
+
+#endif // FRAMEARENA_H
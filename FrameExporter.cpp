@@ -0,0 +1,242 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameExporter.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "FrameExporter.h"
+#include "ShmFrameRing.h"
+#include "Config.h"
+
+// Qt
+#include <QDebug>
+// C++
+#include <new>
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+// Linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Writer side of one shared-memory ring (one writer per ring)
+class SharedFrameRing
+{
+    public:
+        SharedFrameRing(const QString &name) : name(name), header(NULL), mappedSize(0) {}
+        ~SharedFrameRing() { close(); }
+        void write(const Frame &frame);
+
+    private:
+        bool create(size_t dataSize);
+        void close();
+        QString name;
+        QMutex mutex;
+        struct ShmRingHeader *header;
+        size_t mappedSize;
+};
+
+#ifdef Q_OS_LINUX
+
+bool SharedFrameRing::create(size_t dataSize)
+{
+    // Slots sized for this frame (page aligned, so larger frames of a similar size still fit)
+    size_t pageSize=sysconf(_SC_PAGESIZE);
+    size_t slotStride=((sizeof(ShmSlotHeader)+dataSize+pageSize-1)/pageSize)*pageSize;
+    size_t size=sizeof(ShmRingHeader)+(size_t)SHM_EXPORT_SLOTS*slotStride;
+    QByteArray path=name.toLocal8Bit();
+    // Readers keep their mapping of an old object, the name now refers to the new one
+    shm_unlink(path.constData());
+    int fd=shm_open(path.constData(), O_CREAT|O_EXCL|O_RDWR, 0644);
+    if(fd==-1)
+    {
+        qDebug() << "ERROR: Could not create shared memory" << name << ":" << strerror(errno);
+        return false;
+    }
+    void *data=MAP_FAILED;
+    if(ftruncate(fd, size)==0)
+        data=mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data==MAP_FAILED)
+    {
+        qDebug() << "ERROR: Could not map shared memory" << name << ":" << strerror(errno);
+        shm_unlink(path.constData());
+        return false;
+    }
+    // Fresh object is zero-filled: slots start with an even (unlocked) sequence
+    header=new(data) ShmRingHeader;
+    header->nSlots=SHM_EXPORT_SLOTS;
+    header->slotStride=slotStride;
+    header->slotHeaderSize=sizeof(ShmSlotHeader);
+    header->headerSize=sizeof(ShmRingHeader);
+    header->version=SHM_RING_VERSION;
+    header->writeIndex.store(0, std::memory_order_relaxed);
+    header->state.store(SHM_RING_LIVE, std::memory_order_relaxed);
+    // Magic last: readers check it before anything else
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic=SHM_RING_MAGIC;
+    mappedSize=size;
+    qDebug() << "Exporting frames to shared memory" << name << "(" << SHM_EXPORT_SLOTS << "x" << slotStride << "bytes)";
+    return true;
+}
+
+void SharedFrameRing::close()
+{
+    if(!header)
+        return;
+    // Tell readers to reopen (or give up) rather than wait on a ring that no longer advances
+    header->state.store(SHM_RING_CLOSED, std::memory_order_release);
+    munmap(header, mappedSize);
+    shm_unlink(name.toLocal8Bit().constData());
+    header=NULL;
+    mappedSize=0;
+}
+
+void SharedFrameRing::write(const Frame &frame)
+{
+    QMutexLocker locker(&mutex);
+    const Mat &image=frame.data;
+    if(image.empty())
+        return;
+    size_t rowSize=image.cols*image.elemSize();
+    size_t dataSize=rowSize*image.rows;
+    // Frame does not fit (resolution, format or ROI changed): replace ring
+    if(header && sizeof(ShmSlotHeader)+dataSize>header->slotStride)
+        close();
+    // Compressed frames vary in size: make room for the worst case straight away
+    if(!header && !create(frame.pixelFormat==PIXEL_FORMAT_MJPEG ? qMax(dataSize, (size_t)frame.width*frame.height*2) : dataSize))
+        return;
+
+    uint64_t index=header->writeIndex.load(std::memory_order_relaxed);
+    struct ShmSlotHeader *slot=(struct ShmSlotHeader*)((char*)header+sizeof(ShmRingHeader)+(index%header->nSlots)*header->slotStride);
+    // Lock slot (odd sequence): readers still using the previous frame in it will see the change
+    uint64_t seq=slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->index=index;
+    slot->sequence=frame.sequence;
+    slot->timestamp=frame.timestamp;
+    slot->pixelFormat=frame.pixelFormat;
+    slot->width=frame.width;
+    slot->height=frame.height;
+    slot->rows=image.rows;
+    slot->cols=image.cols;
+    slot->cvType=image.type();
+    slot->dataSize=dataSize;
+    // Copy data (rows of a ROI are not contiguous)
+    char *data=(char*)slot+sizeof(ShmSlotHeader);
+    if(image.isContinuous())
+        memcpy(data, image.data, dataSize);
+    else
+        for(int i=0; i<image.rows; i++)
+            memcpy(data+i*rowSize, image.ptr(i), rowSize);
+    // Unlock slot, then publish frame
+    slot->seq.store(seq+2, std::memory_order_release);
+    header->writeIndex.store(index+1, std::memory_order_release);
+}
+
+#else
+
+bool SharedFrameRing::create(size_t dataSize)
+{
+    Q_UNUSED(dataSize);
+    return false;
+}
+
+void SharedFrameRing::close()
+{
+}
+
+void SharedFrameRing::write(const Frame &frame)
+{
+    Q_UNUSED(frame);
+}
+
+#endif
+
+FrameExporter::FrameExporter()
+{
+}
+
+int FrameExporter::key(int deviceNumber, int stage)
+{
+    return deviceNumber*2+stage;
+}
+
+QString FrameExporter::ringName(int deviceNumber, int stage)
+{
+    return QString(SHM_EXPORT_NAME_PREFIX)+QString::number(deviceNumber)+(stage==FRAME_EXPORT_RAW ? QString("-raw") : QString("-processed"));
+}
+
+bool FrameExporter::setExportEnabled(int deviceNumber, int stage, bool enable)
+{
+#ifndef Q_OS_LINUX
+    // POSIX shared memory not supported
+    if(enable)
+        return false;
+#endif
+    QMutexLocker locker(&mutex);
+    // Ring is created with the first frame (its size is not known before)
+    if(enable && !rings.contains(key(deviceNumber, stage)))
+        rings.insert(key(deviceNumber, stage), QSharedPointer<SharedFrameRing>(new SharedFrameRing(ringName(deviceNumber, stage))));
+    // Ring is removed once the last frame being written to it is done
+    else if(!enable)
+        rings.remove(key(deviceNumber, stage));
+    nRings.storeRelease(rings.size());
+    return true;
+}
+
+bool FrameExporter::isExportEnabled(int deviceNumber, int stage)
+{
+    QMutexLocker locker(&mutex);
+    return rings.contains(key(deviceNumber, stage));
+}
+
+void FrameExporter::removeDevice(int deviceNumber)
+{
+    setExportEnabled(deviceNumber, FRAME_EXPORT_RAW, false);
+    setExportEnabled(deviceNumber, FRAME_EXPORT_PROCESSED, false);
+}
+
+void FrameExporter::exportFrame(int deviceNumber, int stage, const Frame &frame)
+{
+    // Nothing exported: no lock taken
+    if(nRings.loadAcquire()==0)
+        return;
+    mutex.lock();
+    QSharedPointer<SharedFrameRing> ring=rings.value(key(deviceNumber, stage));
+    mutex.unlock();
+    // Copy outside the lock (other devices export at the same time)
+    if(ring)
+        ring->write(frame);
+}
@@ -0,0 +1,70 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameExporter.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef FRAMEEXPORTER_H
+#define FRAMEEXPORTER_H
+
+// Qt
+#include <QAtomicInt>
+#include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+// Local
+#include "Frame.h"
+#include "Structures.h"
+
+class SharedFrameRing;
+
+// Publishes frames of selected devices into POSIX shared-memory rings (layout in
+// ShmFrameRing.h) so other processes on the host can read them without opening
+// the camera. One ring per device and stage (raw: as captured, processed: as
+// shown). Writing copies the frame once into the ring and never waits for
+// readers; nothing is done for devices that are not exported.
+class FrameExporter
+{
+    public:
+        FrameExporter();
+        bool setExportEnabled(int deviceNumber, int stage, bool enable);
+        bool isExportEnabled(int deviceNumber, int stage);
+        void removeDevice(int deviceNumber);
+        void exportFrame(int deviceNumber, int stage, const Frame &frame);
+        static QString ringName(int deviceNumber, int stage);
+
+    private:
+        static int key(int deviceNumber, int stage);
+        QMutex mutex;
+        QMap<int, QSharedPointer<SharedFrameRing> > rings;
+        QAtomicInt nRings;
+};
+
+#endif // FRAMEEXPORTER_H
@@ -150,6 +150,40 @@ void FrameLabel::createContextMenu()
     action->setCheckable(true);
     menu->addAction(action);
     menu->addSeparator();
+    // Create recording menu object
+    QMenu* menu_record = new QMenu(this);
+    menu_record->setTitle("Recording");
+    menu->addMenu(menu_record);
+    // Add actions
+    action = new QAction(this);
+    action->setText(tr("Record Raw Stream"));
+    action->setCheckable(true);
+    menu_record->addAction(action);
+    action = new QAction(this);
+    action->setText(tr("Record Annotated Stream"));
+    action->setCheckable(true);
+    menu_record->addAction(action);
+    action = new QAction(this);
+    action->setText(tr("Record Events (Pre-Event Buffer)"));
+    action->setCheckable(true);
+    menu_record->addAction(action);
+    action = new QAction(this);
+    action->setText(tr("Record Replay File (Uncompressed)"));
+    action->setCheckable(true);
+    menu_record->addAction(action);
+    // Create frame export menu object
+    QMenu* menu_export = new QMenu(this);
+    menu_export->setTitle("Export Frames (Shared Memory)");
+    menu->addMenu(menu_export);
+    // Add actions
+    action = new QAction(this);
+    action->setText(tr("Export Raw Frames"));
+    action->setCheckable(true);
+    menu_export->addAction(action);
+    action = new QAction(this);
+    action->setText(tr("Export Processed Frames"));
+    action->setCheckable(true);
+    menu_export->addAction(action);
     // Create image processing menu object
     QMenu* menu_imgProc = new QMenu(this);
     menu_imgProc->setTitle("Image Processing");
@@ -198,6 +232,20 @@ void FrameLabel::createContextMenu()
     action->setCheckable(true);
     menu_imgProc->addAction(action);
 
+    menu_imgProc->addSeparator();
+    action = new QAction(this);
+    action->setText(tr("Parallel Processing"));
+    action->setCheckable(true);
+    menu_imgProc->addAction(action);
+    action = new QAction(this);
+    action->setText(tr("Pipelined Processing"));
+    action->setCheckable(true);
+    menu_imgProc->addAction(action);
+    action = new QAction(this);
+    action->setText(tr("Adaptive Detection"));
+    action->setCheckable(true);
+    menu_imgProc->addAction(action);
+
     menu_imgProc->addSeparator();
     action = new QAction(this);
     action->setText(tr("Settings..."));
@@ -0,0 +1,346 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameRecorder.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "FrameRecorder.h"
+
+// Qt
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+// OpenCV
+#include <opencv2/imgcodecs.hpp>
+
+FrameRecorder::FrameRecorder(int deviceNumber, int dropPolicy) : QThread(), triggers(RECORDER_TRIGGER_QUEUE_LENGTH), eventBufferBytes(0), clipEnd(0), nClips(0)
+{
+    this->deviceNumber=deviceNumber;
+    this->dropPolicy=dropPolicy;
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    stop();
+}
+
+void FrameRecorder::setStreamEnabled(int stream, bool enable)
+{
+    streams[stream].enabled.storeRelease(enable ? 1 : 0);
+    // Recorder thread is started with the first stream (closes segments of disabled streams itself)
+    if(enable && !isRunning())
+    {
+        doStop.storeRelease(0);
+        start(QThread::LowPriority);
+    }
+    // Wake the recorder thread if it is sleeping with every stream disabled
+    else if(enable)
+        wakeup.release();
+}
+
+bool FrameRecorder::isStreamEnabled(int stream)
+{
+    return streams[stream].enabled.loadAcquire()!=0;
+}
+
+bool FrameRecorder::isAnyStreamEnabled()
+{
+    for(int i=0; i<RECORDER_STREAMS; i++)
+        if(isStreamEnabled(i))
+            return true;
+    return false;
+}
+
+void FrameRecorder::record(int stream, const Frame &frame)
+{
+    Stream &s=streams[stream];
+    if(!s.enabled.loadAcquire())
+        return;
+    s.nOffered++;
+    // Disk not keeping up: drop frame rather than wait
+    bool drop=(s.queue.size()>=s.queue.maxSize());
+    // Decimate: keep every other frame while the queue is more than half full
+    if(!drop && dropPolicy==RECORDER_DROP_DECIMATE && s.queue.size()>s.queue.maxSize()/2)
+        drop=(s.nOffered%2==1);
+    // Frames in a driver buffer are copied (queued frames would otherwise starve capture)
+    if(drop || !s.queue.tryPush(frame.detached()))
+        s.nDropped.fetchAndAddRelaxed(1);
+}
+
+void FrameRecorder::trigger(int reason, int detail, qint64 timestamp)
+{
+    if(!streams[RECORDER_STREAM_EVENTS].enabled.loadAcquire())
+        return;
+    struct RecorderTrigger recorderTrigger;
+    recorderTrigger.reason=reason;
+    recorderTrigger.detail=detail;
+    recorderTrigger.timestamp=timestamp;
+    // Queue full: clip is triggered already (only the index line is lost)
+    triggers.tryPush(recorderTrigger);
+}
+
+struct RecorderStatistics FrameRecorder::getStatistics()
+{
+    struct RecorderStatistics statistics;
+    for(int i=0; i<RECORDER_STREAMS; i++)
+    {
+        statistics.nRecorded[i]=streams[i].nRecorded.loadAcquire();
+        statistics.nDropped[i]=streams[i].nDropped.loadAcquire();
+        statistics.nQueued[i]=streams[i].queue.size();
+    }
+    statistics.nClips=nClips.loadAcquire();
+    statistics.eventBufferBytes=eventBufferBytes.loadAcquire();
+    return statistics;
+}
+
+void FrameRecorder::stop()
+{
+    if(!isRunning())
+        return;
+    doStop.storeRelease(1);
+    wakeup.release();
+    wait();
+}
+
+void FrameRecorder::run()
+{
+    while(1)
+    {
+        bool stopping=doStop.loadAcquire();
+        bool idle=true;
+        for(int i=0; i<RECORDER_STREAMS; i++)
+        {
+            // Encode what is queued (at most one queue length, so one stream cannot hold up the other)
+            Frame frame;
+            for(int n=0; n<streams[i].queue.maxSize() && streams[i].queue.tryPop(frame); n++)
+            {
+                idle=false;
+                bool written;
+                if(i==RECORDER_STREAM_EVENTS)
+                    written=bufferEventFrame(frame);
+                else if(i==RECORDER_STREAM_REPLAY)
+                    written=writeReplayFrame(frame);
+                else
+                    written=writeFrame(i, frame);
+                if(written)
+                    streams[i].nRecorded.fetchAndAddRelaxed(1);
+                else
+                    streams[i].nDropped.fetchAndAddRelaxed(1);
+            }
+            // Stream switched off: finish its file
+            if(stopping || !streams[i].enabled.loadAcquire())
+            {
+                if(i==RECORDER_STREAM_EVENTS)
+                {
+                    closeClip();
+                    clearEventBuffer();
+                }
+                else
+                    closeSegment(i);
+            }
+        }
+        // Start/extend event clips (after the frames queued so far are in the ring)
+        struct RecorderTrigger recorderTrigger;
+        while(triggers.tryPop(recorderTrigger))
+        {
+            idle=false;
+            if(!stopping)
+                handleTrigger(recorderTrigger);
+        }
+        if(stopping)
+            break;
+        // Every stream disabled: sleep until one is enabled (or the recorder is stopped)
+        if(idle && !isAnyStreamEnabled())
+            wakeup.acquire(qMax(1, wakeup.available()));
+        // Nothing queued: check again shortly (producers never wait for the recorder, so they cannot wake it)
+        else if(idle)
+            msleep(RECORDER_POLL_INTERVAL_MS);
+    }
+    qDebug() << "[" << deviceNumber << "] Stopping recorder thread...";
+}
+
+bool FrameRecorder::writeFrame(int stream, const Frame &frame)
+{
+    Stream &s=streams[stream];
+    // Colour conversion/decoding of raw frames happens here rather than in capture
+    Mat image=(frame.pixelFormat==PIXEL_FORMAT_GREY) ? frame.gray() : frame.bgr();
+    if(image.empty())
+        return false;
+    // Start a new segment: first frame, frame size/type changed (e.g. new ROI) or segment long enough
+    if(!s.writer.isOpened() || s.size!=image.size() || s.channels!=image.channels() ||
+       frame.timestamp-s.segmentStart>=(qint64)RECORDER_SEGMENT_SECONDS*1000000)
+    {
+        closeSegment(stream);
+        QString path=segmentPath(stream);
+        if(!s.writer.open(path.toStdString(), VideoWriter::fourcc(RECORDER_FOURCC), RECORDER_FPS, image.size(), image.channels()==3))
+        {
+            qDebug() << "[" << deviceNumber << "] ERROR: Could not open recording" << path;
+            return false;
+        }
+        qDebug() << "[" << deviceNumber << "] Recording to" << path;
+        s.size=image.size();
+        s.channels=image.channels();
+        s.segmentStart=frame.timestamp;
+    }
+    s.writer.write(image);
+    return true;
+}
+
+bool FrameRecorder::writeReplayFrame(const Frame &frame)
+{
+    Stream &s=streams[RECORDER_STREAM_REPLAY];
+    // Start a new segment: first frame or segment long enough (frames of any size/format can share a file)
+    if(!s.replayWriter.isOpen() || frame.timestamp-s.segmentStart>=(qint64)RECORDER_SEGMENT_SECONDS*1000000)
+    {
+        closeSegment(RECORDER_STREAM_REPLAY);
+        QString path=segmentPath(RECORDER_STREAM_REPLAY);
+        if(!s.replayWriter.open(path))
+        {
+            qDebug() << "[" << deviceNumber << "] ERROR: Could not open replay file" << path;
+            return false;
+        }
+        qDebug() << "[" << deviceNumber << "] Recording to" << path;
+        s.segmentStart=frame.timestamp;
+    }
+    return s.replayWriter.write(frame);
+}
+
+void FrameRecorder::closeSegment(int stream)
+{
+    if(streams[stream].writer.isOpened())
+        streams[stream].writer.release();
+    if(streams[stream].replayWriter.isOpen())
+        streams[stream].replayWriter.close();
+}
+
+QString FrameRecorder::segmentPath(int stream)
+{
+    static const char *streamNames[RECORDER_STREAMS]={"-raw-", "-annotated-", "-event-", "-replay-"};
+    static const char *extensions[RECORDER_STREAMS]={RECORDER_FILE_EXTENSION, RECORDER_FILE_EXTENSION, RECORDER_EVENT_FILE_EXTENSION, REPLAY_FILE_EXTENSION};
+    QDir().mkpath(RECORDER_DIRECTORY);
+    return QString(RECORDER_DIRECTORY)+QString("/camera")+QString::number(deviceNumber)+QString(streamNames[stream])+
+           QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz")+QString(extensions[stream]);
+}
+
+bool FrameRecorder::bufferEventFrame(const Frame &frame)
+{
+    EncodedFrame encoded;
+    encoded.sequence=frame.sequence;
+    encoded.timestamp=frame.timestamp;
+    if(frame.pixelFormat==PIXEL_FORMAT_MJPEG)
+    {
+        // Already compressed: kept as delivered
+        if(frame.empty() || !frame.data.isContinuous())
+            return false;
+        encoded.data.assign(frame.data.data, frame.data.data+frame.data.total()*frame.data.elemSize());
+    }
+    else
+    {
+        Mat image=(frame.pixelFormat==PIXEL_FORMAT_GREY) ? frame.gray() : frame.bgr();
+        if(image.empty())
+            return false;
+        std::vector<int> params;
+        params.push_back(IMWRITE_JPEG_QUALITY);
+        params.push_back(RECORDER_EVENT_JPEG_QUALITY);
+        if(!imencode(".jpg", image, encoded.data, params))
+            return false;
+    }
+    // Clip in progress: frame goes straight to disk (clip ends with the first frame past the post-event time)
+    if(clipFile.isOpen())
+    {
+        writeClipFrame(encoded);
+        if(encoded.timestamp>=clipEnd)
+            closeClip();
+    }
+    // Keep the ring within its time span and memory budget (the newest frame is always kept)
+    qint64 bytes=eventBufferBytes.loadAcquire()+(qint64)encoded.data.size();
+    eventBuffer.push_back(std::move(encoded));
+    while(eventBuffer.size()>1 && (bytes>RECORDER_EVENT_BUFFER_MAX_BYTES ||
+          eventBuffer.back().timestamp-eventBuffer.front().timestamp>(qint64)RECORDER_EVENT_PRE_SECONDS*1000000))
+    {
+        bytes-=eventBuffer.front().data.size();
+        eventBuffer.pop_front();
+    }
+    eventBufferBytes.storeRelease(bytes);
+    return true;
+}
+
+void FrameRecorder::handleTrigger(const struct RecorderTrigger &trigger)
+{
+    static const char *reasonNames[]={"marker-appeared", "marker-disappeared", "face-count-changed"};
+    if(!streams[RECORDER_STREAM_EVENTS].enabled.loadAcquire())
+        return;
+    qint64 end=trigger.timestamp+(qint64)RECORDER_EVENT_POST_SECONDS*1000000;
+    if(!clipFile.isOpen())
+    {
+        // New clip: starts with the pre-event frames
+        QString path=segmentPath(RECORDER_STREAM_EVENTS);
+        clipFile.setFileName(path);
+        clipIndex.setFileName(path+QString(".csv"));
+        if(!clipFile.open(QIODevice::WriteOnly) || !clipIndex.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            qDebug() << "[" << deviceNumber << "] ERROR: Could not open event clip" << path;
+            closeClip();
+            return;
+        }
+        qDebug() << "[" << deviceNumber << "] Recording event clip to" << path;
+        clipIndex.write("# frame,sequence,timestamp_us,offset,bytes\n# trigger,reason,detail,timestamp_us\n");
+        for(std::deque<EncodedFrame>::const_iterator it=eventBuffer.begin(); it!=eventBuffer.end(); ++it)
+            writeClipFrame(*it);
+        clipEnd=end;
+        nClips.fetchAndAddRelaxed(1);
+    }
+    // Clip in progress: extended to the post-event time of the latest trigger
+    else
+        clipEnd=qMax(clipEnd, end);
+    clipIndex.write(QString("trigger,%1,%2,%3\n").arg(reasonNames[trigger.reason]).arg(trigger.detail).arg(trigger.timestamp).toLatin1());
+}
+
+bool FrameRecorder::writeClipFrame(const EncodedFrame &encoded)
+{
+    qint64 offset=clipFile.pos();
+    if(clipFile.write((const char*)encoded.data.data(), encoded.data.size())!=(qint64)encoded.data.size())
+        return false;
+    clipIndex.write(QString("frame,%1,%2,%3,%4\n").arg(encoded.sequence).arg(encoded.timestamp).arg(offset).arg(encoded.data.size()).toLatin1());
+    return true;
+}
+
+void FrameRecorder::closeClip()
+{
+    if(clipFile.isOpen())
+        clipFile.close();
+    if(clipIndex.isOpen())
+        clipIndex.close();
+}
+
+void FrameRecorder::clearEventBuffer()
+{
+    eventBuffer.clear();
+    eventBufferBytes.storeRelease(0);
+}
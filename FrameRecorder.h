@@ -0,0 +1,134 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameRecorder.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+// Qt
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QFile>
+#include <QtCore/QSemaphore>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+// OpenCV
+#include <opencv2/videoio.hpp>
+// Local
+#include "Config.h"
+#include "Frame.h"
+#include "ReplayWriter.h"
+#include "SpscQueue.h"
+#include "Structures.h"
+// C++
+#include <deque>
+#include <vector>
+
+// Records the raw and/or annotated stream of one camera to segment files. The
+// capture and processing threads only hand frames over through a lock-free
+// queue per stream (a raw frame still held in a driver buffer is copied first);
+// encoding and disk I/O happen on the recorder's own thread. When the queue is
+// full the frame is dropped (and counted) instead of waiting for the disk.
+//
+// The event stream keeps the last RECORDER_EVENT_PRE_SECONDS of raw frames as
+// JPEG (MJPEG packets as delivered) in a memory-bounded ring. A trigger from the
+// processing thread writes the ring out to a clip, followed by the frames up to
+// RECORDER_EVENT_POST_SECONDS after the last trigger. Clips are concatenated
+// JPEGs (play with e.g. "ffplay -f mjpeg") with a CSV index of frame capture
+// times, offsets and triggers next to them.
+//
+// The replay stream writes raw frames as captured, without encoding, to replay
+// files (ReplayFormat.h) that the Replay File capture backend plays back.
+class FrameRecorder : public QThread
+{
+    public:
+        FrameRecorder(int deviceNumber, int dropPolicy);
+        ~FrameRecorder();
+        void setStreamEnabled(int stream, bool enable);
+        bool isStreamEnabled(int stream);
+        // Called by the capture (raw, events) or processing (annotated) thread: never blocks
+        void record(int stream, const Frame &frame);
+        // Called by the processing thread: never blocks (ignored unless the event stream is enabled)
+        void trigger(int reason, int detail, qint64 timestamp);
+        struct RecorderStatistics getStatistics();
+        void stop();
+
+    protected:
+        void run();
+
+    private:
+        struct Stream
+        {
+            Stream() : queue(RECORDER_QUEUE_LENGTH), enabled(0), nOffered(0), nRecorded(0), nDropped(0), channels(0), segmentStart(0) {}
+            SpscQueue<Frame> queue;
+            QAtomicInt enabled;
+            quint64 nOffered;
+            QAtomicInteger<quint64> nRecorded;
+            QAtomicInteger<quint64> nDropped;
+            // Encoder side (recorder thread only)
+            cv::VideoWriter writer;
+            ReplayWriter replayWriter;
+            Size size;
+            int channels;
+            qint64 segmentStart;
+        };
+        bool isAnyStreamEnabled();
+        bool writeFrame(int stream, const Frame &frame);
+        bool writeReplayFrame(const Frame &frame);
+        void closeSegment(int stream);
+        QString segmentPath(int stream);
+        // Event stream (recorder thread only)
+        struct EncodedFrame
+        {
+            std::vector<uchar> data;
+            quint64 sequence;
+            qint64 timestamp;
+        };
+        bool bufferEventFrame(const Frame &frame);
+        void handleTrigger(const struct RecorderTrigger &trigger);
+        bool writeClipFrame(const EncodedFrame &encoded);
+        void closeClip();
+        void clearEventBuffer();
+        Stream streams[RECORDER_STREAMS];
+        SpscQueue<struct RecorderTrigger> triggers;
+        std::deque<EncodedFrame> eventBuffer;
+        QAtomicInteger<qint64> eventBufferBytes;
+        QFile clipFile;
+        QFile clipIndex;
+        qint64 clipEnd;
+        QAtomicInteger<quint64> nClips;
+        int deviceNumber;
+        int dropPolicy;
+        QAtomicInt doStop;
+        // Released when a stream is enabled or the recorder is stopped
+        QSemaphore wakeup;
+};
+
+#endif // FRAMERECORDER_H
@@ -0,0 +1,183 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameSynchronizer.cpp                                                */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "FrameSynchronizer.h"
+// C++
+#include <stdlib.h>
+
+FrameSynchronizer::FrameSynchronizer() : frameSets(FRAME_SYNC_SET_BUFFER_SIZE)
+{
+    // Initialize members
+    toleranceUs=FRAME_SYNC_TOLERANCE_US;
+    statistics.nSets=0;
+    statistics.nUnmatchedFrames=0;
+    statistics.nDroppedSets=0;
+}
+
+void FrameSynchronizer::addDevice(int deviceNumber)
+{
+    QMutexLocker locker(&mutex);
+    pending[deviceNumber].clear();
+}
+
+void FrameSynchronizer::removeDevice(int deviceNumber)
+{
+    QMutexLocker locker(&mutex);
+    pending.remove(deviceNumber);
+    // Remaining devices may now form complete sets
+    match();
+}
+
+bool FrameSynchronizer::containsDevice(int deviceNumber)
+{
+    QMutexLocker locker(&mutex);
+    return pending.contains(deviceNumber);
+}
+
+void FrameSynchronizer::setTolerance(qint64 toleranceUs)
+{
+    QMutexLocker locker(&mutex);
+    this->toleranceUs=toleranceUs;
+}
+
+void FrameSynchronizer::push(int deviceNumber, const Frame &frame)
+{
+    QMutexLocker locker(&mutex);
+    // Device is not synchronized
+    if(!pending.contains(deviceNumber))
+        return;
+    QQueue<Frame> &queue=pending[deviceNumber];
+    // Another device is late or gone: do not hold on to frames (V4L2 frames are driver buffers)
+    if(queue.size()>=FRAME_SYNC_MAX_PENDING)
+    {
+        queue.dequeue();
+        statistics.nUnmatchedFrames++;
+    }
+    queue.enqueue(frame);
+    match();
+}
+
+Buffer<FrameSet>* FrameSynchronizer::getFrameSets()
+{
+    return &frameSets;
+}
+
+void FrameSynchronizer::wakeConsumer()
+{
+    // Empty set (only added if there is room: a full buffer does not block the consumer anyway)
+    QMutexLocker locker(&mutex);
+    if(!frameSets.isFull())
+        frameSets.add(FrameSet(), true);
+}
+
+struct FrameSyncStatistics FrameSynchronizer::getStatistics()
+{
+    QMutexLocker locker(&mutex);
+    return statistics;
+}
+
+void FrameSynchronizer::match()
+{
+    // A single stream has nothing to be synchronized with
+    if(pending.size()<2)
+        return;
+
+    while(1)
+    {
+        // Every device needs a frame; the newest of the oldest frames is the reference
+        qint64 reference=0;
+        int referenceDevice=-1;
+        for(QMap<int, QQueue<Frame> >::const_iterator it=pending.constBegin(); it!=pending.constEnd(); ++it)
+        {
+            if(it.value().isEmpty())
+                return;
+            if(referenceDevice==-1 || it.value().head().timestamp>reference)
+            {
+                reference=it.value().head().timestamp;
+                referenceDevice=it.key();
+            }
+        }
+
+        // Per device: frame closest to the reference (frames before it can no longer be matched)
+        bool complete=true;
+        bool dropReference=false;
+        for(QMap<int, QQueue<Frame> >::iterator it=pending.begin(); it!=pending.end(); ++it)
+        {
+            QQueue<Frame> &queue=it.value();
+            while(queue.size()>1 && llabs(queue.at(1).timestamp-reference)<=llabs(queue.head().timestamp-reference))
+            {
+                queue.dequeue();
+                statistics.nUnmatchedFrames++;
+            }
+            // Too old: no partner frame exists for it
+            if(reference-queue.head().timestamp>toleranceUs)
+            {
+                queue.dequeue();
+                statistics.nUnmatchedFrames++;
+                complete=false;
+            }
+            // Device skipped the reference time: no partner frame exists for the reference
+            else if(queue.head().timestamp-reference>toleranceUs)
+                dropReference=true;
+        }
+        if(dropReference)
+        {
+            pending[referenceDevice].dequeue();
+            statistics.nUnmatchedFrames++;
+            complete=false;
+        }
+        if(!complete)
+            continue;
+
+        // Build set
+        FrameSet set;
+        qint64 first=reference;
+        qint64 last=reference;
+        qint64 sum=0;
+        for(QMap<int, QQueue<Frame> >::iterator it=pending.begin(); it!=pending.end(); ++it)
+        {
+            Frame frame=it.value().dequeue();
+            first=qMin(first, frame.timestamp);
+            last=qMax(last, frame.timestamp);
+            sum+=frame.timestamp;
+            set.frames.insert(it.key(), frame);
+        }
+        set.timestamp=sum/set.frames.size();
+        set.spread=last-first;
+        set.index=statistics.nSets++;
+        // Consumer is not keeping up: drop set rather than block capture (only this class adds sets)
+        if(frameSets.isFull())
+            statistics.nDroppedSets++;
+        else
+            frameSets.add(set, true);
+    }
+}
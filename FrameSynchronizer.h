@@ -0,0 +1,84 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* FrameSynchronizer.h                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef FRAMESYNCHRONIZER_H
+#define FRAMESYNCHRONIZER_H
+
+// Qt
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+// Local
+#include "Buffer.h"
+#include "Config.h"
+#include "Frame.h"
+#include "Structures.h"
+
+// Frames from several cameras captured at (nearly) the same time
+struct FrameSet{
+    FrameSet() : timestamp(0), spread(0), index(0) {}
+    // By device number
+    QMap<int, Frame> frames;
+    // Mean capture time of the frames and difference between the first and last one (microseconds)
+    qint64 timestamp;
+    qint64 spread;
+    quint64 index;
+};
+
+// Groups frames from the synchronized devices by capture timestamp. Capture
+// threads push every frame; once each device has a frame within the tolerance
+// of the others, the group is put in the frame set buffer for a consumer.
+// Frames that cannot be matched are dropped (and counted). Pushing never blocks:
+// sets are dropped if the consumer does not keep up.
+class FrameSynchronizer
+{
+    public:
+        FrameSynchronizer();
+        void addDevice(int deviceNumber);
+        void removeDevice(int deviceNumber);
+        bool containsDevice(int deviceNumber);
+        void setTolerance(qint64 toleranceUs);
+        void push(int deviceNumber, const Frame &frame);
+        Buffer<FrameSet>* getFrameSets();
+        struct FrameSyncStatistics getStatistics();
+        void wakeConsumer();
+
+    private:
+        void match();
+        QMutex mutex;
+        QMap<int, QQueue<Frame> > pending;
+        Buffer<FrameSet> frameSets;
+        qint64 toleranceUs;
+        struct FrameSyncStatistics statistics;
+};
+
+#endif // FRAMESYNCHRONIZER_H
@@ -0,0 +1,274 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* HugePageAllocator.cpp                                                */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "HugePageAllocator.h"
+// Qt
+#include <QDebug>
+// Local
+#include "Config.h"
+// C
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+
+namespace {
+
+const size_t hugePageSize=2*1024*1024;
+// mbind() policy (numaif.h, not needed for this one call)
+const int mpolPreferred=1;
+
+// NUMA node of the core the calling thread runs on (-1: unknown)
+int currentNode()
+{
+    unsigned int cpu, node;
+    if(syscall(SYS_getcpu, &cpu, &node, NULL)==-1)
+        return -1;
+    return (int)node;
+}
+
+}
+
+HugePageAllocator::HugePageAllocator() : mode(DEFAULT_HUGE_PAGE_MODE), explicitFailed(false)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+MatAllocator* HugePageAllocator::frameAllocator()
+{
+    return instance()->getMode()!=HUGE_PAGES_OFF ? instance() : NULL;
+}
+
+UMatData* HugePageAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                                      AccessFlag flags, UMatUsageFlags usageFlags) const
+{
+    // Size of a continuous buffer (steps as the standard allocator sets them)
+    size_t total=CV_ELEM_SIZE(type);
+    for(int i=dims-1; i>=0; i--)
+        total*=sizes[i];
+    // User data, small buffer or huge pages switched off: standard allocator
+    if(data || total<HUGE_PAGE_MIN_BYTES || mode.load()==HUGE_PAGES_OFF)
+        return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+
+    size_t length=(total+hugePageSize-1)&~(hugePageSize-1);
+    int node=currentNode();
+    void *start=NULL;
+    {
+        // Region of this size freed on this node
+        QMutexLocker locker(&mutex);
+        for(int i=0; i<cache.size(); i++)
+        {
+            if(cache[i].length==length && cache[i].node==node)
+            {
+                start=cache.takeAt(i).start;
+                statistics.nReused++;
+                break;
+            }
+        }
+    }
+    if(!start)
+        start=map(length, node);
+    // Could not map: let Mat fall back to the default allocator
+    if(!start)
+    {
+        QMutexLocker locker(&mutex);
+        statistics.nFallbacks++;
+        return NULL;
+    }
+
+    if(step)
+    {
+        size_t stepSize=CV_ELEM_SIZE(type);
+        for(int i=dims-1; i>=0; i--)
+        {
+            step[i]=stepSize;
+            stepSize*=sizes[i];
+        }
+    }
+    UMatData *u=new UMatData(this);
+    u->data=u->origdata=(uchar*)start;
+    u->size=total;
+    u->userdata=(void*)(intptr_t)node;
+    return u;
+}
+
+bool HugePageAllocator::allocate(UMatData* u, AccessFlag accessflags, UMatUsageFlags usageFlags) const
+{
+    Q_UNUSED(accessflags);
+    Q_UNUSED(usageFlags);
+    return u!=NULL;
+}
+
+void HugePageAllocator::deallocate(UMatData* u) const
+{
+    if(!u)
+        return;
+    Region region;
+    region.start=u->origdata;
+    region.length=(u->size+hugePageSize-1)&~(hugePageSize-1);
+    region.node=(int)(intptr_t)u->userdata;
+    delete u;
+    // Keep for the next frame (pages stay mapped and on their node), unmap if the cache is full
+    QMutexLocker locker(&mutex);
+    if(cache.size()<HUGE_PAGE_CACHE_REGIONS)
+    {
+        cache.append(region);
+        return;
+    }
+    statistics.bytesMapped-=region.length;
+    munmap(region.start, region.length);
+}
+
+void HugePageAllocator::trimCache()
+{
+    QMutexLocker locker(&mutex);
+    while(!cache.isEmpty())
+    {
+        Region region=cache.takeLast();
+        statistics.bytesMapped-=region.length;
+        munmap(region.start, region.length);
+    }
+}
+
+void* HugePageAllocator::map(size_t length, int node) const
+{
+    void *start=MAP_FAILED;
+    bool isExplicit=false;
+    // Explicit huge pages (only while the reserved pool has pages left)
+    if(mode.load()==HUGE_PAGES_EXPLICIT)
+    {
+        start=mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        isExplicit=(start!=MAP_FAILED);
+        if(!isExplicit && !explicitFailed)
+        {
+            qDebug() << "Explicit huge pages not available (see /proc/sys/vm/nr_hugepages): using transparent huge pages.";
+            explicitFailed=true;
+        }
+    }
+    // Transparent huge pages: 2 MB aligned region (ordinary pages if THP is disabled)
+    if(start==MAP_FAILED)
+    {
+        void *region=mmap(NULL, length+hugePageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(region==MAP_FAILED)
+            return NULL;
+        uintptr_t aligned=((uintptr_t)region+hugePageSize-1)&~(uintptr_t)(hugePageSize-1);
+        // Trim to the aligned part
+        if(aligned>(uintptr_t)region)
+            munmap(region, aligned-(uintptr_t)region);
+        size_t tail=(uintptr_t)region+length+hugePageSize-(aligned+length);
+        if(tail>0)
+            munmap((void*)(aligned+length), tail);
+        start=(void*)aligned;
+        madvise(start, length, MADV_HUGEPAGE);
+    }
+    // Place on the node of the allocating thread (otherwise the node of whichever thread touches it first)
+    if(node>=0 && node<(int)(8*sizeof(unsigned long)))
+    {
+        unsigned long nodeMask=1UL<<node;
+        syscall(SYS_mbind, start, length, mpolPreferred, &nodeMask, 8*sizeof(nodeMask)+1, 0);
+    }
+
+    QMutexLocker locker(&mutex);
+    if(isExplicit)
+        statistics.nExplicit++;
+    else
+        statistics.nTransparent++;
+    statistics.bytesMapped+=length;
+    return start;
+}
+
+#else
+
+HugePageAllocator::HugePageAllocator() : mode(HUGE_PAGES_OFF), explicitFailed(false)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+MatAllocator* HugePageAllocator::frameAllocator()
+{
+    // Huge pages are only implemented for Linux
+    return NULL;
+}
+
+UMatData* HugePageAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                                      AccessFlag flags, UMatUsageFlags usageFlags) const
+{
+    return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+}
+
+bool HugePageAllocator::allocate(UMatData* u, AccessFlag accessflags, UMatUsageFlags usageFlags) const
+{
+    return Mat::getStdAllocator()->allocate(u, accessflags, usageFlags);
+}
+
+void HugePageAllocator::deallocate(UMatData* u) const
+{
+    Mat::getStdAllocator()->deallocate(u);
+}
+
+void HugePageAllocator::trimCache()
+{
+}
+
+void* HugePageAllocator::map(size_t length, int node) const
+{
+    Q_UNUSED(length);
+    Q_UNUSED(node);
+    return NULL;
+}
+
+#endif
+
+HugePageAllocator* HugePageAllocator::instance()
+{
+    static HugePageAllocator allocator;
+    return &allocator;
+}
+
+void HugePageAllocator::setMode(int mode)
+{
+    this->mode.store(mode);
+}
+
+int HugePageAllocator::getMode()
+{
+    return mode.load();
+}
+
+struct HugePageStatistics HugePageAllocator::getStatistics()
+{
+    QMutexLocker locker(&mutex);
+    return statistics;
+}
@@ -0,0 +1,84 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* HugePageAllocator.h                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef HUGEPAGEALLOCATOR_H
+#define HUGEPAGEALLOCATOR_H
+
+// Qt
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+// OpenCV
+#include <opencv2/core.hpp>
+// Local
+#include "Structures.h"
+
+using namespace cv;
+
+// Allocator for large frame buffers backed by 2 MB pages (explicit or
+// transparent huge pages, see HugePageMode), placed on the NUMA node of the
+// thread allocating them (pinned capture/processing threads get local memory).
+// Freed regions are cached for the next frame of the same size. Falls back to
+// ordinary pages, or to the default allocator, when huge pages are unavailable.
+// Set as the allocator of a Mat before it is created (Linux only).
+class HugePageAllocator : public MatAllocator
+{
+    public:
+        static HugePageAllocator* instance();
+        // Allocator to give frame buffers (NULL: huge pages off or not supported, use the default)
+        static MatAllocator* frameAllocator();
+        void setMode(int mode);
+        int getMode();
+        struct HugePageStatistics getStatistics();
+        // Unmaps the cached regions
+        void trimCache();
+        UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           AccessFlag flags, UMatUsageFlags usageFlags) const;
+        bool allocate(UMatData* data, AccessFlag accessflags, UMatUsageFlags usageFlags) const;
+        void deallocate(UMatData* u) const;
+
+    private:
+        HugePageAllocator();
+        struct Region{
+            void *start;
+            size_t length;
+            int node;
+        };
+        void* map(size_t length, int node) const;
+        QAtomicInt mode;
+        mutable QMutex mutex;
+        mutable QList<Region> cache;
+        mutable struct HugePageStatistics statistics;
+        mutable bool explicitFailed;
+};
+
+#endif // HUGEPAGEALLOCATOR_H
@@ -48,6 +48,7 @@ ImageProcessingSettingsDialog::ImageProcessingSettingsDialog(QWidget *parent) :
     connect(ui->resetErodeToDefaultsButton,SIGNAL(released()),SLOT(resetErodeDialogToDefaults()));
     connect(ui->resetFlipToDefaultsButton,SIGNAL(released()),SLOT(resetFlipDialogToDefaults()));
     connect(ui->resetCannyToDefaultsButton,SIGNAL(released()),SLOT(resetCannyDialogToDefaults()));
+    connect(ui->resetGovernorToDefaultsButton,SIGNAL(released()),SLOT(resetGovernorDialogToDefaults()));
     connect(ui->applyButton,SIGNAL(released()),SLOT(updateStoredSettingsFromDialog()));
     connect(ui->smoothTypeGroup,SIGNAL(buttonReleased(QAbstractButton*)),SLOT(smoothTypeChange(QAbstractButton*)));
     // dilateIterationsEdit input string validation
@@ -70,6 +71,10 @@ ImageProcessingSettingsDialog::ImageProcessingSettingsDialog(QWidget *parent) :
     QRegExp rx9("[3,5,7]"); // Integers 3,5,7
     QRegExpValidator *validator9 = new QRegExpValidator(rx9, 0);
     ui->cannyApertureSizeEdit->setValidator(validator9);
+    // governorTargetFPSEdit input string validation
+    QRegExp rx10("[1-9]\\d{0,2}"); // Integers 1 to 999
+    QRegExpValidator *validator10 = new QRegExpValidator(rx10, 0);
+    ui->governorTargetFPSEdit->setValidator(validator10);
     // Set dialog values to defaults
     resetAllDialogToDefaults();
     // Update image processing settings in imageProcessingSettings structure and processingThread
@@ -112,6 +117,8 @@ void ImageProcessingSettingsDialog::updateStoredSettingsFromDialog()
     imageProcessingSettings.cannyThreshold2=ui->cannyThresh2Edit->text().toDouble();
     imageProcessingSettings.cannyApertureSize=ui->cannyApertureSizeEdit->text().toInt();
     imageProcessingSettings.cannyL2gradient=ui->cannyL2NormCheckBox->isChecked();
+    // Governor
+    imageProcessingSettings.governorTargetFPS=ui->governorTargetFPSEdit->text().toInt();
     // Update image processing flags in processingThread
     emit newImageProcessingSettings(imageProcessingSettings);
 }
@@ -145,6 +152,8 @@ void ImageProcessingSettingsDialog::updateDialogSettingsFromStored()
     ui->cannyThresh2Edit->setText(QString::number(imageProcessingSettings.cannyThreshold2));
     ui->cannyApertureSizeEdit->setText(QString::number(imageProcessingSettings.cannyApertureSize));
     ui->cannyL2NormCheckBox->setChecked(imageProcessingSettings.cannyL2gradient);
+    // Governor
+    ui->governorTargetFPSEdit->setText(QString::number(imageProcessingSettings.governorTargetFPS));
     // Enable/disable appropriate Smooth parameter inputs
     smoothTypeChange(ui->smoothTypeGroup->checkedButton());
 }
@@ -161,6 +170,8 @@ void ImageProcessingSettingsDialog::resetAllDialogToDefaults()
     resetFlipDialogToDefaults();
     // Canny
     resetCannyDialogToDefaults();
+    // Governor
+    resetGovernorDialogToDefaults();
 }
 
 void ImageProcessingSettingsDialog::smoothTypeChange(QAbstractButton *input)
@@ -309,6 +320,11 @@ void ImageProcessingSettingsDialog::validateDialog()
         ui->cannyApertureSizeEdit->setText(QString::number(DEFAULT_CANNY_APERTURE_SIZE));
         inputEmpty=true;
     }
+    if(ui->governorTargetFPSEdit->text().isEmpty())
+    {
+        ui->governorTargetFPSEdit->setText(QString::number(DEFAULT_GOVERNOR_TARGET_FPS));
+        inputEmpty=true;
+    }
     // Check if any of the inputs were empty
     if(inputEmpty)
         QMessageBox::warning(this->parentWidget(),"WARNING:","One or more inputs empty.\n\nAutomatically set to default values.");
@@ -381,3 +397,8 @@ void ImageProcessingSettingsDialog::resetCannyDialogToDefaults()
     ui->cannyApertureSizeEdit->setText(QString::number(DEFAULT_CANNY_APERTURE_SIZE));
     ui->cannyL2NormCheckBox->setChecked(DEFAULT_CANNY_L2GRADIENT);
 }
+
+void ImageProcessingSettingsDialog::resetGovernorDialogToDefaults()
+{
+    ui->governorTargetFPSEdit->setText(QString::number(DEFAULT_GOVERNOR_TARGET_FPS));
+}
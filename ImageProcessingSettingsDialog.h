@@ -68,6 +68,7 @@ class ImageProcessingSettingsDialog : public QDialog
         void resetErodeDialogToDefaults();
         void resetFlipDialogToDefaults();
         void resetCannyDialogToDefaults();
+        void resetGovernorDialogToDefaults();
         void validateDialog();
         void smoothTypeChange(QAbstractButton *);
 
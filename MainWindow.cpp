@@ -33,8 +33,11 @@
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
 // Qt
+#include <QDateTime>
+#include <QDir>
 #include <QLabel>
 #include <QMessageBox>
+#include <QTimer>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -60,14 +63,33 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(showAboutDialog()));
     connect(ui->actionQuit, SIGNAL(triggered()), this, SLOT(close()));
     connect(ui->actionFullScreen, SIGNAL(toggled(bool)), this, SLOT(setFullScreen(bool)));
+    connect(ui->actionPublishResults, SIGNAL(toggled(bool)), this, SLOT(setResultPublishing(bool)));
+    connect(ui->actionServeStatistics, SIGNAL(toggled(bool)), this, SLOT(setStatsServing(bool)));
+    connect(ui->actionRecordTrace, SIGNAL(toggled(bool)), this, SLOT(setTracing(bool)));
     // Create SharedImageBuffer object
     sharedImageBuffer = new SharedImageBuffer();
+    // Multi-view triangulation is started once enough calibrated cameras are synchronized
+    multiViewThread=NULL;
+    multiViewResults.setIndex=0;
+    multiViewResults.spreadMs=0;
+    qRegisterMetaType<struct MultiViewResults>("MultiViewResults");
+    // Show timestamp synchronization statistics in status bar
+    QTimer *syncStatsTimer = new QTimer(this);
+    connect(syncStatsTimer, SIGNAL(timeout()), this, SLOT(updateFrameSyncStatistics()));
+    syncStatsTimer->start(FRAME_SYNC_STATS_INTERVAL_MS);
 
 }
 
 MainWindow::~MainWindow()
 {
+    stopMultiViewThread();
+    ResultPublisher::instance()->close();
+    StatsServer::instance()->close();
+    // Closes the camera views (cameras are removed from the capture engine and processing pool)
     delete ui;
+    // Stop shared capture/processing threads
+    CaptureEngine::instance()->shutdown();
+    ProcessingPool::instance()->shutdown();
 }
 
 void MainWindow::connectToCamera()
@@ -96,9 +118,12 @@ void MainWindow::connectToCamera()
             if(!deviceNumberMap.contains(deviceNumber))
             {
                 // Create ImageBuffer with user-defined size
-                Buffer<Mat> *imageBuffer = new Buffer<Mat>(cameraConnectDialog->getImageBufferSize());
+                Buffer<Frame> *imageBuffer = new Buffer<Frame>(cameraConnectDialog->getImageBufferSize());
                 // Add created ImageBuffer to SharedImageBuffer object
-                sharedImageBuffer->add(deviceNumber, imageBuffer, ui->actionSynchronizeStreams->isChecked());
+                // Note: Shared threading has no capture thread to hold at the stream synchronization barrier
+                sharedImageBuffer->add(deviceNumber, imageBuffer,
+                                       ui->actionSynchronizeStreams->isChecked() && cameraConnectDialog->getThreadingMode()!=THREADING_SHARED,
+                                       ui->actionSynchronizeByTimestamp->isChecked());
                 // Create CameraView
                 cameraViewMap[deviceNumber] = new CameraView(ui->tabWidget, deviceNumber, sharedImageBuffer);
 
@@ -120,13 +145,39 @@ void MainWindow::connectToCamera()
                         sharedImageBuffer->setSyncEnabled(false);
                 }
 
+                // Thread placement (cores and scheduling policy)
+                struct ThreadPlacement capThreadPlacement;
+                capThreadPlacement.cpuList=cameraConnectDialog->getCaptureThreadCores();
+                capThreadPlacement.schedPolicy=cameraConnectDialog->getSchedulingPolicy();
+                capThreadPlacement.rtPriority=CAPTURE_RT_PRIORITY;
+                struct ThreadPlacement procThreadPlacement;
+                procThreadPlacement.cpuList=cameraConnectDialog->getProcessingThreadCores();
+                procThreadPlacement.schedPolicy=cameraConnectDialog->getSchedulingPolicy();
+                procThreadPlacement.rtPriority=PROCESSING_RT_PRIORITY;
+                // MJPEG decoding (only used if the camera delivers MJPEG)
+                struct MjpegDecoding mjpegDecoding;
+                mjpegDecoding.mode=cameraConnectDialog->getMjpegDecodeMode();
+                mjpegDecoding.scaleDenom=cameraConnectDialog->getMjpegScaleDenom();
+                // Processing pool budget/share (only used with shared threading)
+                struct PoolScheduling poolScheduling;
+                poolScheduling.targetFps=cameraConnectDialog->getPoolTargetFps();
+                poolScheduling.priority=cameraConnectDialog->getPoolPriority();
+
                 // Attempt to connect to camera
                 if(cameraViewMap[deviceNumber]->connectToCamera(cameraConnectDialog->getDropFrameCheckBoxState(),
                                                cameraConnectDialog->getCaptureThreadPrio(),
                                                cameraConnectDialog->getProcessingThreadPrio(),
                                                cameraConnectDialog->getEnableFrameProcessingCheckBoxState(),
                                                cameraConnectDialog->getResolutionWidth(),
-                                               cameraConnectDialog->getResolutionHeight()))
+                                               cameraConnectDialog->getResolutionHeight(),
+                                               capThreadPlacement,
+                                               procThreadPlacement,
+                                               cameraConnectDialog->getCaptureBackend(),
+                                               cameraConnectDialog->getCaptureFormat(),
+                                               mjpegDecoding,
+                                               cameraConnectDialog->getThreadingMode(),
+                                               poolScheduling,
+                                               cameraConnectDialog->getReplayFile()))
                 {
                     // Add to map
                     deviceNumberMap[deviceNumber] = nextTabIndex;
@@ -144,6 +195,10 @@ void MainWindow::connectToCamera()
                     setTabCloseToolTips(ui->tabWidget, "Disconnect Camera");
                     // Prevent user from enabling/disabling stream synchronization after a camera has been connected
                     ui->actionSynchronizeStreams->setEnabled(false);
+                    ui->actionSynchronizeByTimestamp->setEnabled(false);
+                    // Triangulate markers across synchronized cameras
+                    if(ui->actionSynchronizeByTimestamp->isChecked() && cameraViewMap.size()>=2)
+                        startMultiViewThread();
                 }
                 // Could not connect to camera
                 else
@@ -199,6 +254,10 @@ void MainWindow::disconnectCamera(int index)
         // Close tab
         ui->tabWidget->removeTab(index);
 
+        // Not enough cameras left to triangulate
+        if(cameraViewMap.size()<=2)
+            stopMultiViewThread();
+
         // Delete widget (CameraView) contained in tab
         delete cameraViewMap[deviceNumberMap.key(index)];
         cameraViewMap.remove(deviceNumberMap.key(index));
@@ -218,10 +277,67 @@ void MainWindow::disconnectCamera(int index)
             ui->tabWidget->addTab(newTab, "");
             ui->tabWidget->setTabsClosable(false);
             ui->actionSynchronizeStreams->setEnabled(true);
+            ui->actionSynchronizeByTimestamp->setEnabled(true);
         }
     }
 }
 
+void MainWindow::updateFrameSyncStatistics()
+{
+    if(!ui->actionSynchronizeByTimestamp->isChecked() || cameraViewMap.size()<2)
+        return;
+    struct FrameSyncStatistics stats=sharedImageBuffer->getFrameSynchronizer()->getStatistics();
+    // Triangulated markers (position in the world frame)
+    QString multiViewSummary;
+    for(int i=0; i<multiViewResults.poses.size(); i++)
+    {
+        const struct MultiViewPose &pose=multiViewResults.poses[i];
+        multiViewSummary+=QString(" | Marker %1: (%2, %3, %4) m, %5 views, %6 px")
+                .arg(pose.id).arg(pose.tvec[0], 0, 'f', 3).arg(pose.tvec[1], 0, 'f', 3).arg(pose.tvec[2], 0, 'f', 3)
+                .arg(pose.nViews).arg(pose.reprojectionError, 0, 'f', 2);
+    }
+    ui->statusBar->showMessage(QString("Synchronized frame sets: ")+QString::number(stats.nSets)+
+                               QString(" | Unmatched frames dropped: ")+QString::number(stats.nUnmatchedFrames)+
+                               QString(" | Sets dropped: ")+QString::number(stats.nDroppedSets)+
+                               multiViewSummary);
+}
+
+void MainWindow::updateMultiViewResults(struct MultiViewResults results)
+{
+    multiViewResults=results;
+}
+
+void MainWindow::startMultiViewThread()
+{
+    // Already running
+    if(multiViewThread)
+        return;
+    multiViewThread=new MultiViewThread(sharedImageBuffer);
+    // Needs intrinsics and extrinsics of at least two cameras
+    if(!multiViewThread->loadCalibration(MULTIVIEW_CALIBRATION_FILE))
+    {
+        qDebug() << "Multi-view triangulation disabled: fewer than two cameras calibrated in" << MULTIVIEW_CALIBRATION_FILE;
+        delete multiViewThread;
+        multiViewThread=NULL;
+        return;
+    }
+    connect(multiViewThread, SIGNAL(newMultiViewResults(struct MultiViewResults)), this, SLOT(updateMultiViewResults(struct MultiViewResults)));
+    multiViewThread->start();
+}
+
+void MainWindow::stopMultiViewThread()
+{
+    if(!multiViewThread)
+        return;
+    qDebug() << "About to stop multi-view thread...";
+    multiViewThread->stop();
+    multiViewThread->wait();
+    delete multiViewThread;
+    multiViewThread=NULL;
+    multiViewResults.poses.clear();
+    qDebug() << "Multi-view thread successfully stopped.";
+}
+
 void MainWindow::showAboutDialog()
 {
     QMessageBox::information(this, "About", QString("Created by Nick D'Ademo\n\nContact: nickdademo@gmail.com\nWebsite: www.nickdademo.com\n\nVersion: %1").arg(APP_VERSION));
@@ -271,3 +387,44 @@ void MainWindow::setFullScreen(bool input)
     else
         this->showNormal();
 }
+
+void MainWindow::setResultPublishing(bool input)
+{
+    if(!input)
+        ResultPublisher::instance()->close();
+    // Could not open socket
+    else if(!ResultPublisher::instance()->open(RESULT_PUBLISHER_SOCKET_PATH))
+    {
+        QMessageBox::warning(this,"ERROR:",QString("Could not publish detection results on ")+RESULT_PUBLISHER_SOCKET_PATH+".");
+        ui->actionPublishResults->setChecked(false);
+    }
+}
+
+void MainWindow::setStatsServing(bool input)
+{
+    if(!input)
+        StatsServer::instance()->close();
+    // Could not open socket
+    else if(!StatsServer::instance()->open(STATS_SERVER_ADDRESS, STATS_SERVER_PORT))
+    {
+        QMessageBox::warning(this,"ERROR:",QString("Could not serve statistics on ")+STATS_SERVER_ADDRESS+":"+QString::number(STATS_SERVER_PORT)+".");
+        ui->actionServeStatistics->setChecked(false);
+    }
+}
+
+void MainWindow::setTracing(bool input)
+{
+    if(input)
+    {
+        TraceRecorder::instance()->setEnabled(true);
+        return;
+    }
+    // Write trace (open in chrome://tracing or ui.perfetto.dev)
+    TraceRecorder::instance()->setEnabled(false);
+    QDir().mkpath(TRACE_DIRECTORY);
+    QString fileName=QString(TRACE_DIRECTORY)+QString("/trace-")+QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")+QString(".json");
+    if(TraceRecorder::instance()->dump(fileName))
+        ui->statusBar->showMessage(QString("Trace written to ")+fileName+".");
+    else
+        QMessageBox::warning(this,"ERROR:",QString("Could not write trace to ")+fileName+".");
+}
@@ -41,6 +41,10 @@
 #include "CameraView.h"
 #include "Buffer.h"
 #include "SharedImageBuffer.h"
+#include "MultiViewThread.h"
+#include "ResultPublisher.h"
+#include "StatsServer.h"
+#include "TraceRecorder.h"
 
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
@@ -69,6 +73,10 @@ class MainWindow : public QMainWindow
         QMap<int, int> deviceNumberMap;
         QMap<int, CameraView*> cameraViewMap;
         SharedImageBuffer *sharedImageBuffer;
+        MultiViewThread *multiViewThread;
+        struct MultiViewResults multiViewResults;
+        void startMultiViewThread();
+        void stopMultiViewThread();
         bool removeFromMapByTabIndex(QMap<int, int>& map, int tabIndex);
         void updateMapValues(QMap<int, int>& map, int tabIndex);
         void setTabCloseToolTips(QTabWidget *tabs, QString tooltip);
@@ -79,7 +87,12 @@ class MainWindow : public QMainWindow
         void connectToCamera();
         void disconnectCamera(int index);
         void showAboutDialog();
+        void updateFrameSyncStatistics();
+        void updateMultiViewResults(struct MultiViewResults results);
         void setFullScreen(bool);
+        void setResultPublishing(bool);
+        void setStatsServing(bool);
+        void setTracing(bool);
 };
 
 #endif // MAINWINDOW_H
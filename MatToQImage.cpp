@@ -65,3 +65,40 @@ QImage MatToQImage(const Mat& mat)
         return QImage();
     }
 }
+
+void MatToQImage(const Mat& mat, QImage &image)
+{
+    // Grey levels (built once)
+    static const QVector<QRgb> colorTable=[]() {
+        QVector<QRgb> table;
+        for (int i=0; i<256; i++)
+            table.push_back(qRgb(i,i,i));
+        return table;
+    }();
+    QImage::Format format;
+    // 8-bits unsigned, NO. OF CHANNELS=1
+    if(mat.type()==CV_8UC1)
+        format=QImage::Format_Indexed8;
+    // 8-bits unsigned, NO. OF CHANNELS=3
+    else if(mat.type()==CV_8UC3)
+        format=QImage::Format_RGB888;
+    else
+    {
+        qDebug() << "ERROR: Mat could not be converted to QImage.";
+        image=QImage();
+        return;
+    }
+    // Previous image still shown (or queued for display) or of another size: start a new one
+    if(!image.isDetached() || image.width()!=mat.cols || image.height()!=mat.rows || image.format()!=format)
+    {
+        image=QImage(mat.cols, mat.rows, format);
+        if(format==QImage::Format_Indexed8)
+            image.setColorTable(colorTable);
+    }
+    // Write into the image buffer
+    Mat dst(mat.rows, mat.cols, mat.type(), image.bits(), image.bytesPerLine());
+    if(format==QImage::Format_RGB888)
+        cvtColor(mat, dst, COLOR_BGR2RGB);
+    else
+        mat.copyTo(dst);
+}
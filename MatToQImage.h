@@ -42,5 +42,7 @@
 using namespace cv;
 
 QImage MatToQImage(const Mat&);
+// Same, written into image (its buffer is reused if nobody else holds it and it has the right size/format)
+void MatToQImage(const Mat&, QImage &image);
 
 #endif // MATTOQIMAGE_H
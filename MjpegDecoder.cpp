@@ -0,0 +1,161 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* MjpegDecoder.cpp                                                     */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "MjpegDecoder.h"
+// Qt
+#include <QRunnable>
+#include <QThread>
+// OpenCV
+#include <opencv2/imgcodecs.hpp>
+// Local
+#include "Config.h"
+#include "Structures.h"
+#include "HugePageAllocator.h"
+
+class MjpegDecodeTask : public QRunnable
+{
+    public:
+        MjpegDecodeTask(MjpegDecoder *decoder, quint64 slot, const Frame &packet) : decoder(decoder), slot(slot), packet(packet) {}
+        void run() { decoder->decodePacket(slot, packet); }
+
+    private:
+        MjpegDecoder *decoder;
+        quint64 slot;
+        Frame packet;
+};
+
+MjpegDecoder::MjpegDecoder(const std::function<void(const Frame&, bool)> &deliver, bool dropFrameIfBufferFull, int mode, int scaleDenom) : deliver(deliver)
+{
+    // Initialize members
+    nextSlot=0;
+    submitted=0;
+    this->dropFrameIfBufferFull=dropFrameIfBufferFull;
+    this->scaleDenom=scaleDenom;
+    pool.setMaxThreadCount(threadCount());
+    pool.setExpiryTimeout(-1);
+    // Limits packets being decoded or waiting to be put back in order
+    freeSlots.release(maxPacketsInFlight());
+    // Decode straight to grey and/or at reduced scale (libjpeg scales in the DCT domain, so this is cheaper than a full decode)
+    bool grey=(mode==MJPEG_DECODE_POOL_GREY);
+    outputFormat=grey ? PIXEL_FORMAT_GREY : PIXEL_FORMAT_BGR;
+    switch(scaleDenom)
+    {
+        case 2:
+            imreadFlags=grey ? IMREAD_REDUCED_GRAYSCALE_2 : IMREAD_REDUCED_COLOR_2;
+            break;
+        case 4:
+            imreadFlags=grey ? IMREAD_REDUCED_GRAYSCALE_4 : IMREAD_REDUCED_COLOR_4;
+            break;
+        case 8:
+            imreadFlags=grey ? IMREAD_REDUCED_GRAYSCALE_8 : IMREAD_REDUCED_COLOR_8;
+            break;
+        default:
+            imreadFlags=grey ? IMREAD_GRAYSCALE : IMREAD_COLOR;
+            this->scaleDenom=1;
+            break;
+    }
+}
+
+MjpegDecoder::~MjpegDecoder()
+{
+    stop();
+    finish();
+}
+
+bool MjpegDecoder::decode(const Frame &packet)
+{
+    // Too many packets outstanding: drop the packet or wait for a decoder
+    if(dropFrameIfBufferFull)
+    {
+        if(!freeSlots.tryAcquire())
+            return false;
+    }
+    else
+        freeSlots.acquire();
+    pool.start(new MjpegDecodeTask(this, submitted++, packet));
+    return true;
+}
+
+void MjpegDecoder::stop()
+{
+    // Do not block on a full image buffer from now on (its consumer may be gone)
+    dropAll.store(1);
+}
+
+void MjpegDecoder::finish()
+{
+    pool.waitForDone();
+}
+
+int MjpegDecoder::getScaleDenom()
+{
+    return scaleDenom;
+}
+
+int MjpegDecoder::threadCount()
+{
+    // Default: half the cores (the rest are left for processing)
+    return MJPEG_DECODER_THREADS>0 ? MJPEG_DECODER_THREADS : qMax(1, QThread::idealThreadCount()/2);
+}
+
+int MjpegDecoder::maxPacketsInFlight()
+{
+    return threadCount()*MJPEG_PACKETS_PER_DECODER_THREAD;
+}
+
+void MjpegDecoder::decodePacket(quint64 slot, Frame &packet)
+{
+    Frame decoded;
+    // Decoded frames are large and allocated at the frame rate: huge pages (cached for the next frame)
+    decoded.data.allocator=HugePageAllocator::frameAllocator();
+    imdecode(packet.data, imreadFlags, &decoded.data);
+    // Packet no longer needed: release the task's reference now (returns a V4L2 buffer
+    // to the driver) rather than when the task is deleted, after delivery
+    packet.data.release();
+    decoded.pixelFormat=outputFormat;
+    decoded.width=decoded.data.cols;
+    decoded.height=decoded.data.rows;
+    decoded.timestamp=packet.timestamp;
+    decoded.sequence=packet.sequence;
+
+    QMutexLocker locker(&reorderMutex);
+    pending.insert(slot, decoded);
+    // Pass on every frame whose predecessors have all been passed on (corrupt packets are skipped)
+    while(!pending.isEmpty() && pending.firstKey()==nextSlot)
+    {
+        Frame frame=pending.take(nextSlot);
+        nextSlot++;
+        if(!frame.empty())
+            deliver(frame, dropFrameIfBufferFull || dropAll.load());
+        freeSlots.release();
+    }
+}
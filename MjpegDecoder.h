@@ -0,0 +1,80 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* MjpegDecoder.h                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef MJPEGDECODER_H
+#define MJPEGDECODER_H
+
+// Qt
+#include <QAtomicInt>
+#include <QMap>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThreadPool>
+// Local
+#include "Frame.h"
+// C++
+#include <functional>
+
+// Decodes MJPEG packets on a small pool of threads, so capture is not limited
+// to the speed of one core. Decoded frames are delivered (to the image buffer)
+// in the order the packets were submitted.
+class MjpegDecoder
+{
+    friend class MjpegDecodeTask;
+
+    public:
+        MjpegDecoder(const std::function<void(const Frame&, bool)> &deliver, bool dropFrameIfBufferFull, int mode, int scaleDenom);
+        ~MjpegDecoder();
+        bool decode(const Frame &packet);
+        void stop();
+        void finish();
+        int getScaleDenom();
+        static int threadCount();
+        static int maxPacketsInFlight();
+
+    private:
+        void decodePacket(quint64 slot, Frame &packet);
+        std::function<void(const Frame&, bool)> deliver;
+        QThreadPool pool;
+        QSemaphore freeSlots;
+        QMutex reorderMutex;
+        QMap<quint64, Frame> pending;
+        quint64 nextSlot;
+        quint64 submitted;
+        QAtomicInt dropAll;
+        bool dropFrameIfBufferFull;
+        int imreadFlags;
+        int outputFormat;
+        int scaleDenom;
+};
+
+#endif // MJPEGDECODER_H
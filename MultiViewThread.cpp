@@ -0,0 +1,279 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* MultiViewThread.cpp                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "MultiViewThread.h"
+// Qt
+#include <QDebug>
+// OpenCV
+#include <opencv2/calib3d.hpp>
+// Local
+#include "WorkerPool.h"
+
+MultiViewThread::MultiViewThread(SharedImageBuffer *sharedImageBuffer) : QThread(), sharedImageBuffer(sharedImageBuffer)
+{
+    // Initialize members
+    doStop=false;
+    markerSize=MULTIVIEW_MARKER_SIZE;
+    dictionary=aruco::getPredefinedDictionary(aruco::DICT_6X6_50);
+}
+
+bool MultiViewThread::loadCalibration(const QString &fileName)
+{
+    FileStorage fs(fileName.toStdString(), FileStorage::READ);
+    if(!fs.isOpened())
+    {
+        qDebug() << "ERROR: Could not open multi-view calibration file" << fileName;
+        return false;
+    }
+    if(!fs["marker_size"].empty())
+        fs["marker_size"] >> markerSize;
+    // One entry per camera: device number, intrinsics and pose relative to the common (world) frame
+    cameras.clear();
+    FileNode cameraNodes=fs["cameras"];
+    for(FileNodeIterator it=cameraNodes.begin(); it!=cameraNodes.end(); ++it)
+    {
+        int deviceNumber;
+        vector<double> cameraMatrix, distCoeffs, rvec, tvec;
+        (*it)["device"] >> deviceNumber;
+        (*it)["camera_matrix"] >> cameraMatrix;
+        (*it)["dist_coeffs"] >> distCoeffs;
+        (*it)["rvec"] >> rvec;
+        (*it)["tvec"] >> tvec;
+        if(cameraMatrix.size()!=9 || rvec.size()!=3 || tvec.size()!=3)
+        {
+            qDebug() << "ERROR: Invalid calibration for device" << deviceNumber << "in" << fileName;
+            continue;
+        }
+        MultiViewCamera camera;
+        camera.cameraMatrix=Mat(cameraMatrix, true).reshape(1, 3);
+        if(!distCoeffs.empty())
+            camera.distCoeffs=Mat(distCoeffs, true).reshape(1, 1);
+        Rodrigues(Vec3d(rvec[0], rvec[1], rvec[2]), camera.R);
+        camera.t=Vec3d(tvec[0], tvec[1], tvec[2]);
+        cameras[deviceNumber]=camera;
+    }
+    return cameras.size()>=2;
+}
+
+int MultiViewThread::getCalibratedCameraCount()
+{
+    return cameras.size();
+}
+
+void MultiViewThread::run()
+{
+    Buffer<FrameSet> *frameSets=sharedImageBuffer->getFrameSynchronizer()->getFrameSets();
+    while(1)
+    {
+        ////////////////////////////////
+        // Stop thread if doStop=TRUE //
+        ////////////////////////////////
+        doStopMutex.lock();
+        if(doStop)
+        {
+            doStop=false;
+            doStopMutex.unlock();
+            break;
+        }
+        doStopMutex.unlock();
+        /////////////////////////////////
+        /////////////////////////////////
+
+        // Get time-aligned frames (empty set: woken up to stop)
+        FrameSet frameSet=frameSets->get();
+        if(!frameSet.frames.isEmpty())
+            processFrameSet(frameSet);
+    }
+    qDebug() << "Stopping multi-view thread...";
+}
+
+void MultiViewThread::processFrameSet(const FrameSet &frameSet)
+{
+    // Calibrated views in this set
+    vector<int> devices;
+    for(QMap<int, Frame>::const_iterator it=frameSet.frames.constBegin(); it!=frameSet.frames.constEnd(); ++it)
+    {
+        if(cameras.contains(it.key()))
+            devices.push_back(it.key());
+    }
+
+    // Detect markers in every view in parallel
+    vector<vector<int> > ids(devices.size());
+    vector<vector<vector<Point2f> > > corners(devices.size());
+    WorkerPool::instance()->parallelFor((int)devices.size(), [&](int i) {
+        aruco::detectMarkers(frameSet.frames[devices[i]].gray(), dictionary, corners[i], ids[i]);
+    });
+
+    // Views each marker was seen in (corners in normalized image coordinates)
+    QMap<int, vector<int> > markerViews;
+    QMap<int, vector<vector<Point2f> > > markerCorners;
+    QMap<int, vector<vector<Point2f> > > markerPixels;
+    for(size_t i=0; i<devices.size(); i++)
+    {
+        const MultiViewCamera &camera=cameras[devices[i]];
+        for(size_t j=0; j<ids[i].size(); j++)
+        {
+            vector<Point2f> normalized;
+            undistortPoints(corners[i][j], normalized, camera.cameraMatrix, camera.distCoeffs);
+            markerViews[ids[i][j]].push_back(devices[i]);
+            markerCorners[ids[i][j]].push_back(normalized);
+            markerPixels[ids[i][j]].push_back(corners[i][j]);
+        }
+    }
+
+    struct MultiViewResults results;
+    results.setIndex=frameSet.index;
+    results.spreadMs=frameSet.spread/1000.0;
+    for(QMap<int, vector<int> >::const_iterator it=markerViews.constBegin(); it!=markerViews.constEnd(); ++it)
+    {
+        // Depth is only constrained with two or more views
+        const vector<int> &views=it.value();
+        if(views.size()<2)
+            continue;
+        vector<Point3d> worldCorners(4);
+        bool ok=true;
+        for(int k=0; k<4 && ok; k++)
+            ok=triangulate(views, markerCorners[it.key()], k, worldCorners[k]);
+        if(!ok)
+            continue;
+
+        struct MultiViewPose pose;
+        Vec3d rvec, tvec;
+        pose.fitError=fitMarkerPose(worldCorners, rvec, tvec);
+        pose.id=it.key();
+        pose.nViews=(int)views.size();
+        for(int k=0; k<3; k++)
+        {
+            pose.rvec[k]=rvec[k];
+            pose.tvec[k]=tvec[k];
+        }
+
+        // Reprojection error of the triangulated corners over all views (pixels, RMS)
+        double sumSq=0;
+        for(size_t v=0; v<views.size(); v++)
+        {
+            const MultiViewCamera &camera=cameras[views[v]];
+            Vec3d rvecCamera;
+            Rodrigues(camera.R, rvecCamera);
+            vector<Point2d> projected;
+            projectPoints(worldCorners, rvecCamera, camera.t, camera.cameraMatrix, camera.distCoeffs, projected);
+            for(int k=0; k<4; k++)
+            {
+                Point2d d=projected[k]-Point2d(markerPixels[it.key()][v][k]);
+                sumSq+=d.dot(d);
+            }
+        }
+        pose.reprojectionError=sqrt(sumSq/(4*views.size()));
+        results.poses.append(pose);
+    }
+    emit newMultiViewResults(results);
+}
+
+bool MultiViewThread::triangulate(const vector<int> &views, const vector<vector<Point2f> > &normalizedCorners, int corner, Point3d &point)
+{
+    // Linear (DLT) triangulation over all views: each view adds two rows x*P3-P1, y*P3-P2
+    Mat A((int)views.size()*2, 4, CV_64F);
+    for(size_t v=0; v<views.size(); v++)
+    {
+        const MultiViewCamera &camera=cameras[views[v]];
+        Matx34d P(camera.R(0,0), camera.R(0,1), camera.R(0,2), camera.t[0],
+                  camera.R(1,0), camera.R(1,1), camera.R(1,2), camera.t[1],
+                  camera.R(2,0), camera.R(2,1), camera.R(2,2), camera.t[2]);
+        double x=normalizedCorners[v][corner].x;
+        double y=normalizedCorners[v][corner].y;
+        for(int c=0; c<4; c++)
+        {
+            A.at<double>(2*v, c)=x*P(2,c)-P(0,c);
+            A.at<double>(2*v+1, c)=y*P(2,c)-P(1,c);
+        }
+    }
+    Mat X;
+    SVD::solveZ(A, X);
+    double w=X.at<double>(3);
+    // Point at infinity (views nearly parallel)
+    if(fabs(w)<1e-12)
+        return false;
+    point=Point3d(X.at<double>(0)/w, X.at<double>(1)/w, X.at<double>(2)/w);
+    return true;
+}
+
+double MultiViewThread::fitMarkerPose(const vector<Point3d> &corners, Vec3d &rvec, Vec3d &tvec)
+{
+    // Marker corners in marker coordinates (same order and axes as estimatePoseSingleMarkers)
+    double h=markerSize/2;
+    Point3d model[4]={Point3d(-h, h, 0), Point3d(h, h, 0), Point3d(h, -h, 0), Point3d(-h, -h, 0)};
+    // Rigid fit (Kabsch): rotation from the SVD of the cross-covariance of the centred point sets
+    Point3d modelCentroid(0, 0, 0), worldCentroid(0, 0, 0);
+    for(int k=0; k<4; k++)
+    {
+        modelCentroid+=model[k]*0.25;
+        worldCentroid+=corners[k]*0.25;
+    }
+    Matx33d H=Matx33d::zeros();
+    for(int k=0; k<4; k++)
+    {
+        Vec3d m(model[k]-modelCentroid);
+        Vec3d w(corners[k]-worldCentroid);
+        H+=Matx33d(m[0]*w[0], m[0]*w[1], m[0]*w[2],
+                   m[1]*w[0], m[1]*w[1], m[1]*w[2],
+                   m[2]*w[0], m[2]*w[1], m[2]*w[2]);
+    }
+    SVD svd(Mat(H));
+    Mat R=svd.vt.t()*svd.u.t();
+    // Reflection: flip the axis of the smallest singular value
+    if(determinant(R)<0)
+    {
+        Mat V=svd.vt.t();
+        V.col(2)*=-1;
+        R=V*svd.u.t();
+    }
+    Rodrigues(R, rvec);
+    Matx33d Rm(R);
+    Vec3d t=Vec3d(worldCentroid)-Rm*Vec3d(modelCentroid);
+    tvec=t;
+    // Residual of the fit (metres, RMS)
+    double sumSq=0;
+    for(int k=0; k<4; k++)
+    {
+        Vec3d d=Rm*Vec3d(model[k])+t-Vec3d(corners[k]);
+        sumSq+=d.dot(d);
+    }
+    return sqrt(sumSq/4);
+}
+
+void MultiViewThread::stop()
+{
+    QMutexLocker locker(&doStopMutex);
+    doStop=true;
+    // Wake thread if it is waiting for a frame set
+    sharedImageBuffer->getFrameSynchronizer()->wakeConsumer();
+}
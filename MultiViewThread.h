@@ -0,0 +1,92 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* MultiViewThread.h                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef MULTIVIEWTHREAD_H
+#define MULTIVIEWTHREAD_H
+
+// Qt
+#include <QtCore/QThread>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+// OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+// Local
+#include "SharedImageBuffer.h"
+#include "Structures.h"
+#include "Config.h"
+
+using namespace cv;
+using namespace std;
+
+// Intrinsics and pose (world -> camera: Xc = R*Xw + t) of one calibrated camera
+struct MultiViewCamera{
+    Mat cameraMatrix;
+    Mat distCoeffs;
+    Matx33d R;
+    Vec3d t;
+};
+
+// Consumes time-aligned frame sets, detects markers in every view in parallel
+// and triangulates the corners of markers seen by two or more calibrated
+// cameras. The marker pose is then fitted to the triangulated corners, which
+// constrains depth far better than a single-camera PnP solution.
+class MultiViewThread : public QThread
+{
+    Q_OBJECT
+
+    public:
+        MultiViewThread(SharedImageBuffer *sharedImageBuffer);
+        bool loadCalibration(const QString &fileName);
+        int getCalibratedCameraCount();
+        void stop();
+
+    private:
+        void processFrameSet(const FrameSet &frameSet);
+        bool triangulate(const vector<int> &views, const vector<vector<Point2f> > &normalizedCorners, int corner, Point3d &point);
+        double fitMarkerPose(const vector<Point3d> &corners, Vec3d &rvec, Vec3d &tvec);
+        SharedImageBuffer *sharedImageBuffer;
+        QMap<int, MultiViewCamera> cameras;
+        Ptr<aruco::Dictionary> dictionary;
+        double markerSize;
+        QMutex doStopMutex;
+        volatile bool doStop;
+
+    protected:
+        void run();
+
+    signals:
+        void newMultiViewResults(struct MultiViewResults);
+};
+
+#endif // MULTIVIEWTHREAD_H
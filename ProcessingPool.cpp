@@ -0,0 +1,249 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ProcessingPool.cpp                                                   */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ProcessingPool.h"
+#include "ProcessingThread.h"
+#include "Config.h"
+#include "TraceRecorder.h"
+
+class ProcessingPoolWorker : public QThread
+{
+    public:
+        ProcessingPoolWorker(ProcessingPool *pool) : pool(pool) {}
+
+    protected:
+        void run()
+        {
+            TraceRecorder::setThreadName("Processing pool");
+            pool->work();
+        }
+
+    private:
+        ProcessingPool *pool;
+};
+
+ProcessingPool::ProcessingPool()
+{
+    virtualTime=0;
+    stopping=false;
+    clock.start();
+}
+
+void ProcessingPool::start()
+{
+    // Start workers (0: one per core)
+    int nThreads=PROCESSING_POOL_THREADS>0 ? PROCESSING_POOL_THREADS : QThread::idealThreadCount();
+    for(int i=0; i<qMax(1, nThreads); i++)
+    {
+        ProcessingPoolWorker *worker=new ProcessingPoolWorker(this);
+        worker->start((QThread::Priority)DEFAULT_PROC_THREAD_PRIO);
+        workers.append(worker);
+    }
+}
+
+ProcessingPool* ProcessingPool::instance()
+{
+    static ProcessingPool processingPool;
+    return &processingPool;
+}
+
+int ProcessingPool::threadCount()
+{
+    return workers.size();
+}
+
+void ProcessingPool::shutdown()
+{
+    // Workers finish the frame they are processing
+    mutex.lock();
+    stopping=true;
+    frameReady.wakeAll();
+    mutex.unlock();
+    for(int i=0; i<workers.size(); i++)
+    {
+        workers[i]->wait();
+        delete workers[i];
+    }
+    workers.clear();
+    stopping=false;
+}
+
+void ProcessingPool::addProcessor(ProcessingThread *processor, Buffer<Frame> *buffer, struct PoolScheduling scheduling)
+{
+    QMutexLocker locker(&mutex);
+    // Workers are started with the first camera
+    if(workers.isEmpty())
+        start();
+    Entry entry;
+    entry.processor=processor;
+    entry.buffer=buffer;
+    entry.busy=false;
+    entry.targetFps=scheduling.targetFps;
+    // Each priority level doubles the share of the CPU
+    entry.weight=1<<qBound(0, scheduling.priority, (int)POOL_PRIORITY_HIGH);
+    entry.costMs=0;
+    // New camera starts level with the others (no credit for the time it was not connected)
+    entry.virtualFinish=virtualTime;
+    entry.nextReleaseNs=0;
+    entry.nSkipped=0;
+    entries.append(entry);
+    // Frames may already be waiting
+    frameReady.wakeAll();
+}
+
+void ProcessingPool::removeProcessor(ProcessingThread *processor)
+{
+    QMutexLocker locker(&mutex);
+    int i;
+    while((i=findEntry(processor))!=-1)
+    {
+        // Wait for the frame currently being processed
+        if(entries[i].busy)
+            idle.wait(&mutex);
+        else
+        {
+            entries.removeAt(i);
+            return;
+        }
+    }
+}
+
+struct PoolSchedulingStatistics ProcessingPool::getStatistics(ProcessingThread *processor)
+{
+    QMutexLocker locker(&mutex);
+    struct PoolSchedulingStatistics statistics;
+    statistics.targetFps=0;
+    statistics.weight=0;
+    statistics.averageCostMs=0;
+    statistics.nSkipped=0;
+    int i=findEntry(processor);
+    if(i!=-1)
+    {
+        statistics.targetFps=entries[i].targetFps;
+        statistics.weight=entries[i].weight;
+        statistics.averageCostMs=entries[i].costMs;
+        statistics.nSkipped=entries[i].nSkipped;
+    }
+    return statistics;
+}
+
+void ProcessingPool::frameAvailable()
+{
+    QMutexLocker locker(&mutex);
+    frameReady.wakeOne();
+}
+
+int ProcessingPool::findEntry(ProcessingThread *processor)
+{
+    for(int i=0; i<entries.size(); i++)
+        if(entries[i].processor==processor)
+            return i;
+    return -1;
+}
+
+void ProcessingPool::work()
+{
+    mutex.lock();
+    while(!stopping)
+    {
+        qint64 now=clock.nsecsElapsed();
+        // Time until the next camera is allowed another frame (bounds the wait below)
+        qint64 waitNs=(qint64)PROCESSING_POOL_IDLE_WAIT_MS*1000000;
+        // Pick the camera with the smallest virtual finish time among those with a frame waiting
+        int next=-1;
+        double nextFinish=0;
+        for(int i=0; i<entries.size(); i++)
+        {
+            Entry &entry=entries[i];
+            // Frame of this camera is being processed by another worker
+            if(entry.busy)
+                continue;
+            // Over its fps budget: skip frames arriving early (a later, fresher frame is processed instead)
+            if(entry.targetFps>0 && now<entry.nextReleaseNs)
+            {
+                Frame skipped;
+                while(entry.buffer->tryGet(skipped))
+                    entry.nSkipped++;
+                waitNs=qMin(waitNs, entry.nextReleaseNs-now);
+                continue;
+            }
+            if(entry.buffer->isEmpty())
+                continue;
+            double finish=qMax(virtualTime, entry.virtualFinish)+entry.costMs/entry.weight;
+            if(next==-1 || finish<nextFinish)
+            {
+                next=i;
+                nextFinish=finish;
+            }
+        }
+        // Nothing to do: sleep until capture adds a frame or a camera is within its budget again
+        Frame frame;
+        if(next==-1 || !entries[next].buffer->tryGet(frame))
+        {
+            frameReady.wait(&mutex, (unsigned long)qMax((qint64)1, waitNs/1000000));
+            continue;
+        }
+        // Charge the camera for the frame (system virtual time follows the start of the dispatched frame)
+        Entry &entry=entries[next];
+        virtualTime=qMax(virtualTime, entry.virtualFinish);
+        entry.virtualFinish=nextFinish;
+        // Next frame is due one period later (at most one period of backlog is caught up)
+        if(entry.targetFps>0)
+        {
+            qint64 periodNs=1000000000LL/entry.targetFps;
+            entry.nextReleaseNs=qMax(entry.nextReleaseNs, now-periodNs)+periodNs;
+        }
+        entry.busy=true;
+        ProcessingThread *processor=entry.processor;
+        mutex.unlock();
+
+        // Process frame (entry cannot be removed while busy)
+        QElapsedTimer cost;
+        cost.start();
+        processor->processFrame(frame);
+        double costMs=cost.nsecsElapsed()/1000000.0;
+        // Release frame before the next wait (a raw frame holds a driver buffer)
+        frame=Frame();
+
+        mutex.lock();
+        // Entries may have moved: look the processor up again
+        int i=findEntry(processor);
+        if(i!=-1)
+        {
+            entries[i].busy=false;
+            // Measured cost (first frame sets it directly)
+            entries[i].costMs=entries[i].costMs==0 ? costMs : entries[i].costMs+POOL_COST_EWMA_ALPHA*(costMs-entries[i].costMs);
+        }
+        idle.wakeAll();
+    }
+    mutex.unlock();
+}
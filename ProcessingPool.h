@@ -0,0 +1,102 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ProcessingPool.h                                                     */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef PROCESSINGPOOL_H
+#define PROCESSINGPOOL_H
+
+// Qt
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+// Local
+#include "Buffer.h"
+#include "Frame.h"
+#include "Structures.h"
+
+class ProcessingThread;
+class ProcessingPoolWorker;
+
+// Process-wide pool of processing threads shared by all cameras. Instead of one
+// processing thread per camera, a fixed number of workers (one per core) take
+// frames from the camera buffers. Frames of one camera are processed by one
+// worker at a time, so per-camera state and frame order are kept.
+//
+// Frames are dispatched by weighted fair queueing: every camera is charged the
+// measured cost of its frames divided by its priority weight, and the camera
+// with the least charge goes next. An expensive stream therefore gets its share
+// of the CPU but cannot starve the others. Cameras with a target fps are not
+// dispatched faster than that (frames arriving early are skipped).
+class ProcessingPool
+{
+    public:
+        static ProcessingPool* instance();
+        int threadCount();
+        void addProcessor(ProcessingThread *processor, Buffer<Frame> *buffer, struct PoolScheduling scheduling);
+        void removeProcessor(ProcessingThread *processor);
+        struct PoolSchedulingStatistics getStatistics(ProcessingThread *processor);
+        // Called by capture when a frame was added to a buffer served by the pool
+        void frameAvailable();
+        // Stops and joins the workers (on exit, once all cameras are removed)
+        void shutdown();
+
+    private:
+        ProcessingPool();
+        void start();
+        void work();
+        int findEntry(ProcessingThread *processor);
+        struct Entry
+        {
+            ProcessingThread *processor;
+            Buffer<Frame> *buffer;
+            bool busy;
+            int targetFps;
+            int weight;
+            double costMs;       // Average time spent on a frame
+            double virtualFinish; // Charge after the last dispatched frame
+            qint64 nextReleaseNs; // Frames before this time exceed the target fps
+            quint64 nSkipped;
+        };
+        QList<Entry> entries;
+        QList<ProcessingPoolWorker*> workers;
+        QMutex mutex;
+        QWaitCondition frameReady;
+        QWaitCondition idle;
+        QElapsedTimer clock;
+        double virtualTime;
+        bool stopping;
+
+    friend class ProcessingPoolWorker;
+};
+
+#endif // PROCESSINGPOOL_H
@@ -34,6 +34,8 @@
 #include "MainWindow.h"
 #include <math.h>
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 //#include <iomanip>
 #include <opencv2/aruco.hpp>
 #include <opencv2/calib3d.hpp>
@@ -43,17 +45,58 @@ using namespace cv;
 using namespace std;
 using namespace aruco;
 
-ProcessingThread::ProcessingThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber) : QThread(), sharedImageBuffer(sharedImageBuffer)
+namespace {
+
+// True if the number of faces changed or any face moved by more than a tenth of its size
+bool haveFacesMoved(const std::vector<cv::Rect> &previous, const std::vector<cv::Rect> &current)
+{
+    if(previous.size()!=current.size())
+        return true;
+    for(size_t i=0; i<current.size(); i++)
+    {
+        cv::Point shift=current[i].tl()-previous[i].tl();
+        if(abs(shift.x)*10>current[i].width || abs(shift.y)*10>current[i].height ||
+           abs(current[i].width-previous[i].width)*10>current[i].width)
+            return true;
+    }
+    return false;
+}
+
+}
+
+ProcessingThread::ProcessingThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber) : QThread(), sharedImageBuffer(sharedImageBuffer),
+                                                                                               stats(deviceNumber, STATS_COMPONENT_PROCESSING)
 {
     // Save Device Number
     this->deviceNumber=deviceNumber;
     // Initialize members
     doStop=false;
-    sampleNumber=0;
-    fpsSum=0;
-    fps.clear();
+    frameRecorder=NULL;
+    triggerFaces=0;
     statsData.averageFPS=0;
+    statsData.windowFPS=0;
+    statsData.jitterMs=0;
+    statsData.minIntervalMs=0;
+    statsData.maxIntervalMs=0;
+    statsData.latencyMs=0;
+    statsData.maxLatencyMs=0;
     statsData.nFramesProcessed=0;
+    statsData.arucoDetectionRate=0;
+    statsData.faceDetectionRate=0;
+    statsData.eyeDetectionRate=0;
+    statsData.currentCPU=-1;
+    statsData.captureHealth=CAPTURE_HEALTH_CONNECTED;
+    statsData.nReconnects=0;
+    statsData.nDecoderDropped=0;
+    statsData.frameAllocations=AllocationCounts();
+    threadPlacement.schedPolicy=SCHED_POLICY_DEFAULT;
+    threadPlacement.rtPriority=0;
+    // Initial (empty) settings snapshot
+    publishSnapshot(new ProcessingSnapshot());
+    // Frames in flight (pipelined mode keeps one frame in each stage)
+    preprocessCtx=&pipeline[0];
+    detectCtx=&pipeline[1];
+    finishCtx=&pipeline[2];
 
     // Webcam ArUco calib
     cameraMatrix = (Mat_<double>(3,3) << 6.4509151670288645e+02, 0., 3.3595607517914726e+02, 0., 6.4326487034230729e+02, 2.3680853197408831e+02, 0., 0., 1.);
@@ -76,6 +119,10 @@ ProcessingThread::ProcessingThread(SharedImageBuffer *sharedImageBuffer, int dev
 
 void ProcessingThread::run()
 {
+    // Pin to cores / set scheduling policy (must be done from within the thread)
+    emit updateThreadPlacementInGUI(applyThreadPlacement(threadPlacement));
+    TraceRecorder::setThreadName(QString("Processing %1").arg(deviceNumber));
+
     while(1)
     {
         ////////////////////////////////
@@ -92,235 +139,527 @@ void ProcessingThread::run()
         /////////////////////////////////
         /////////////////////////////////
 
-        // Save processing time
-        processingTime=t.elapsed();
-        // Start timer (used to calculate processing rate)
-        t.start();
+        // Get frame from queue and process it
+        processFrame(sharedImageBuffer->getByDeviceNumber(deviceNumber)->get());
+    }
+    qDebug() << "Stopping processing thread...";
+}
 
-        processingMutex.lock();
-        // Get frame from queue, store in currentFrame, set ROI
-        currentFrame=Mat(sharedImageBuffer->getByDeviceNumber(deviceNumber)->get().clone(), currentROI);
+void ProcessingThread::processFrame(const Frame &grabbedFrame)
+{
+    TraceScope trace("processing", "frame", deviceNumber, grabbedFrame.sequence);
+    struct AllocationCounts allocations=AllocationTracker::threadCounts();
+    // Measure processing rate
+    rate.tick();
+
+    // Start timer (used to measure time spent on this frame, excluding the wait for it)
+    busyTimer.start();
+    // Store frame in preprocessCtx, set ROI
+    startFrame(*preprocessCtx, grabbedFrame);
+    governor.setEnabled(preprocessCtx->flags.governorOn);
+    governor.setTargetFPS(preprocessCtx->settings.governorTargetFPS);
+
+    // Example of how to grab a frame from another stream (where Device Number=1)
+    // Note: This requires stream synchronization to be ENABLED (in the Options menu of MainWindow) and frame processing for the stream you are grabbing FROM to be DISABLED.
+    /*
+    if(sharedImageBuffer->containsImageBufferForDeviceNumber(1))
+    {
+        // Grab frame from another stream (connected to camera with Device Number=1)
+        Mat frameFromAnotherStream = Mat(sharedImageBuffer->getByDeviceNumber(1)->getFrame(), currentROI);
+        // Linear blend images together using OpenCV and save the result to currentFrame. Note: beta=1-alpha
+        addWeighted(frameFromAnotherStream, 0.5, currentFrame, 0.5, 0.0, currentFrame);
+    }
+    */
 
-        // Example of how to grab a frame from another stream (where Device Number=1)
-        // Note: This requires stream synchronization to be ENABLED (in the Options menu of MainWindow) and frame processing for the stream you are grabbing FROM to be DISABLED.
-        /*
-        if(sharedImageBuffer->containsImageBufferForDeviceNumber(1))
+    if(preprocessCtx->flags.pipelineOn)
+    {
+        // Frame N is finished while frame N+1 is in detection and frame N+2 in preprocessing
+        WorkerPool::instance()->parallelFor(3, [&](int stage) {
+            if(stage==0)
+                preprocessFrame(*preprocessCtx);
+            else if(stage==1 && detectCtx->inFlight)
+                detectFrame(*detectCtx);
+            else if(stage==2 && finishCtx->inFlight)
+                finishFrame(*finishCtx);
+        });
+
+        // Frames leave the pipeline in capture order
+        if(finishCtx->inFlight)
+            emitFrame(*finishCtx);
+        // Advance pipeline
+        FrameContext *freeCtx=finishCtx;
+        finishCtx=detectCtx;
+        detectCtx=preprocessCtx;
+        preprocessCtx=freeCtx;
+    }
+    else
+    {
+        // Drain frames left over from pipelined mode (oldest first)
+        if(finishCtx->inFlight)
         {
-            // Grab frame from another stream (connected to camera with Device Number=1)
-            Mat frameFromAnotherStream = Mat(sharedImageBuffer->getByDeviceNumber(1)->getFrame(), currentROI);
-            // Linear blend images together using OpenCV and save the result to currentFrame. Note: beta=1-alpha
-            addWeighted(frameFromAnotherStream, 0.5, currentFrame, 0.5, 0.0, currentFrame);
+            finishFrame(*finishCtx);
+            emitFrame(*finishCtx);
         }
-        */
-
-        ////////////////////////////////////
-        // PERFORM IMAGE PROCESSING BELOW //
-        ////////////////////////////////////
-        // Grayscale conversion (in-place operation)
-        if(imgProcFlags.grayscaleOn && (currentFrame.channels() == 3 || currentFrame.channels() == 4))
-            cvtColor(currentFrame, currentFrame, COLOR_BGR2GRAY);
-
-        // Smooth (in-place operations)
-        if(imgProcFlags.smoothOn)
+        if(detectCtx->inFlight)
         {
-            switch(imgProcSettings.smoothType)
-            {
-                // BLUR
-                case 0:
-                    blur(currentFrame, currentFrame,
-                         Size(imgProcSettings.smoothParam1, imgProcSettings.smoothParam2));
-                    break;
-                // GAUSSIAN
-                case 1:
-                    GaussianBlur(currentFrame, currentFrame,
-                                 Size(imgProcSettings.smoothParam1, imgProcSettings.smoothParam2),
-                                 imgProcSettings.smoothParam3, imgProcSettings.smoothParam4);
-                    break;
-                // MEDIAN
-                case 2:
-                    medianBlur(currentFrame, currentFrame,
-                               imgProcSettings.smoothParam1);
-                    break;
-            }
+            detectFrame(*detectCtx);
+            finishFrame(*detectCtx);
+            emitFrame(*detectCtx);
         }
+        // Process new frame end-to-end
+        preprocessFrame(*preprocessCtx);
+        detectFrame(*preprocessCtx);
+        finishFrame(*preprocessCtx);
+        emitFrame(*preprocessCtx);
+    }
 
-        //Sharpening
-        if(imgProcFlags.sharpeningOn)
-        {
-                    filter2D(currentFrame, currentFrame, -1 , sharpeningKernel , Point(-1, -1), 0, BORDER_DEFAULT);
-        }
+    // Adapt detection schedule to the time spent and to frames queueing up behind this one
+    governor.frameFinished(busyTimer.nsecsElapsed()/1000000.0,
+                           sharedImageBuffer->getByDeviceNumber(deviceNumber)->isFull());
+
+    // Update statistics (allocations include worker pool tasks, not the statistics signal itself)
+    updateFPS();
+    statsData.frameAllocations=AllocationTracker::threadCounts()-allocations;
+    stats.set(STATS_PROCESSING_FPS, (qint64)(statsData.averageFPS*1000));
+    stats.set(STATS_PROCESSING_JITTER_NS, (qint64)(statsData.jitterMs*1e6));
+    statsData.arucoDetectionRate=governor.getDetectionRate(STAGE_ARUCO);
+    statsData.faceDetectionRate=governor.getDetectionRate(STAGE_FACES);
+    statsData.eyeDetectionRate=governor.getDetectionRate(STAGE_EYES);
+    statsData.currentCPU=getCurrentCPU();
+    // Inform GUI of updated statistics
+    emit updateStatisticsInGUI(statsData);
+}
 
-        // Dilate
-        if(imgProcFlags.dilateOn)
-        {
-            dilate(currentFrame, currentFrame,
-                   Mat(), Point(-1, -1), imgProcSettings.dilateNumberOfIterations);
-        }
-        // Erode
-        if(imgProcFlags.erodeOn)
-        {
-            erode(currentFrame, currentFrame,
-                  Mat(), Point(-1, -1), imgProcSettings.erodeNumberOfIterations);
-        }
-        // Flip
-        if(imgProcFlags.flipOn)
-        {
-            flip(currentFrame, currentFrame,
-                 imgProcSettings.flipCode);
-        }
-        // Canny edge detection
-        if(imgProcFlags.cannyOn)
-        {
-            Canny(currentFrame, currentFrame,
-                  imgProcSettings.cannyThreshold1, imgProcSettings.cannyThreshold2,
-                  imgProcSettings.cannyApertureSize, imgProcSettings.cannyL2gradient);
-        }
+void ProcessingThread::startFrame(FrameContext &ctx, const Frame &grabbedFrame)
+{
+    FrameArenaScope allocations(ctx.arena);
+    // Pick up the latest published settings: they are fixed for the lifetime of the frame
+    std::shared_ptr<const ProcessingSnapshot> current=std::atomic_load(&snapshot);
+    ctx.flags=current->flags;
+    ctx.settings=current->settings;
+    ctx.settingsVersion=current->version;
+    ctx.source=grabbedFrame;
+    ctx.sequence=grabbedFrame.sequence;
+    ctx.timestamp=grabbedFrame.timestamp;
+    ctx.roi=current->roi;
+    ctx.frameModified=false;
+    ctx.luma.release();
+    // Last frame's buffers are reused (unless still held by the recorder/export/display)
+    ctx.frame.release();
+    Size frameSize=grabbedFrame.width>0 ? Size(grabbedFrame.width, grabbedFrame.height) : grabbedFrame.data.size();
+    ctx.geometryChanged=ctx.arena.beginFrame(frameSize, ctx.roi, ctx.settingsVersion);
+    // Processing works on its own copy (grey output: frame never needs converting to colour)
+    Mat &image=ctx.arena.image(FRAME_ARENA_SOURCE, frameSize, ctx.flags.grayscaleOn ? CV_8UC1 : CV_8UC3);
+    {
+        // OpenCV internals (colour conversion, JPEG decoding) are not counted
+        AllocationTrackerPause pause;
+        if(ctx.flags.grayscaleOn)
+            grabbedFrame.copyGrayTo(image);
+        else
+            grabbedFrame.copyBgrTo(image);
+    }
+    ctx.frame=Mat(image, ctx.roi);
+    ctx.inFlight=true;
+}
 
-        if(imgProcFlags.ArucoOn)
+void ProcessingThread::preprocessFrame(FrameContext &ctx)
+{
+    StatsTimer timer(stats, STATS_PREPROCESS_NS);
+    TraceScope trace("processing", "preprocess", deviceNumber, ctx.sequence);
+    FrameArenaScope allocations(ctx.arena);
+    // Detection has to run on the processed image if any filter changes it
+    ctx.frameModified=ctx.flags.smoothOn || ctx.flags.sharpeningOn || ctx.flags.dilateOn ||
+                      ctx.flags.erodeOn || ctx.flags.flipOn || ctx.flags.cannyOn;
+
+    ////////////////////////////////////
+    // PERFORM IMAGE PROCESSING BELOW //
+    ////////////////////////////////////
+    // Grayscale: startFrame() already converted the frame (CV_8UC1)
+
+    // Smooth (in-place operations)
+    if(ctx.flags.smoothOn)
+    {
+        switch(ctx.settings.smoothType)
         {
-            //Aru tag detection
-            t_aruco = (double) getTickCount();
-            detectMarkers(currentFrame,dictionary,corners,ids);
+            // BLUR
+            case 0:
+                applyFilter(ctx, ctx.frame.type(), [&](const Mat &src, Mat &dst) {
+                    blur(src, dst,
+                         Size(ctx.settings.smoothParam1, ctx.settings.smoothParam2));
+                });
+                break;
+            // GAUSSIAN
+            case 1:
+                applyFilter(ctx, ctx.frame.type(), [&](const Mat &src, Mat &dst) {
+                    GaussianBlur(src, dst,
+                                 Size(ctx.settings.smoothParam1, ctx.settings.smoothParam2),
+                                 ctx.settings.smoothParam3, ctx.settings.smoothParam4);
+                });
+                break;
+            // MEDIAN (not tiled: medianBlur does not read past the edges of a tile)
+            case 2:
+                applyFilter(ctx, ctx.frame.type(), [&](const Mat &src, Mat &dst) {
+                    medianBlur(src, dst,
+                               ctx.settings.smoothParam1);
+                }, false);
+                break;
         }
-qDebug() << "eyeDetectionOn " << imgProcFlags.eyeDetectionOn;
-        if(imgProcFlags.faceDetectionOn || imgProcFlags.eyeDetectionOn) //Face detection
-        {
-            cv::Mat grey_image;
-            cv::cvtColor(currentFrame, grey_image, cv::COLOR_BGRA2GRAY);
-            cv::equalizeHist(grey_image, grey_image);
+    }
 
-            // Calculate the camera size and set the size to 1/8 of screen height
-            faceCascade.detectMultiScale(grey_image, faces, 1.1, 2,  0|cv::CASCADE_SCALE_IMAGE,
-                                         cv::Size(currentFrame.cols/8, currentFrame.rows/8)); // Minimum size of obj
+    //Sharpening
+    if(ctx.flags.sharpeningOn)
+    {
+        applyFilter(ctx, ctx.frame.type(), [&](const Mat &src, Mat &dst) {
+            filter2D(src, dst, -1 , sharpeningKernel , Point(-1, -1), 0, BORDER_DEFAULT);
+        });
+    }
 
- //           qDebug() << "face" << faces.size();
-        }
+    // Dilate
+    if(ctx.flags.dilateOn)
+    {
+        applyFilter(ctx, ctx.frame.type(), [&](const Mat &src, Mat &dst) {
+            dilate(src, dst,
+                   Mat(), Point(-1, -1), ctx.settings.dilateNumberOfIterations);
+        });
+    }
+    // Erode
+    if(ctx.flags.erodeOn)
+    {
+        applyFilter(ctx, ctx.frame.type(), [&](const Mat &src, Mat &dst) {
+            erode(src, dst,
+                  Mat(), Point(-1, -1), ctx.settings.erodeNumberOfIterations);
+        });
+    }
+    // Flip
+    if(ctx.flags.flipOn)
+    {
+        AllocationTrackerPause pause;
+        flip(ctx.frame, ctx.frame,
+             ctx.settings.flipCode);
+    }
+    // Canny edge detection
+    if(ctx.flags.cannyOn)
+    {
+        applyFilter(ctx, CV_8UC1, [&](const Mat &src, Mat &dst) {
+            Canny(src, dst,
+                  ctx.settings.cannyThreshold1, ctx.settings.cannyThreshold2,
+                  ctx.settings.cannyApertureSize, ctx.settings.cannyL2gradient);
+        }, false);
+    }
+}
 
-        if(imgProcFlags.eyeDetectionOn)
+void ProcessingThread::detectFrame(FrameContext &ctx)
+{
+    StatsTimer timer(stats, STATS_DETECT_NS);
+    TraceScope trace("processing", "detect", deviceNumber, ctx.sequence);
+    FrameArenaScope allocations(ctx.arena);
+    // Stages the governor may throttle
+    governor.setStageActive(STAGE_ARUCO, ctx.flags.ArucoOn);
+    governor.setStageActive(STAGE_FACES, ctx.flags.faceDetectionOn || ctx.flags.eyeDetectionOn);
+    governor.setStageActive(STAGE_EYES, ctx.flags.eyeDetectionOn);
+    // New resolution or ROI: last results are in other coordinates (and may lie outside the frame), run every stage
+    if(ctx.geometryChanged)
+    {
+        lastIds.clear();
+        lastCorners.clear();
+        lastFaces.clear();
+        lastFaceEyes.clear();
+    }
+
+    if(ctx.flags.ArucoOn)
+    {
+        if(ctx.geometryChanged || governor.shouldRun(STAGE_ARUCO))
         {
-            for( size_t i = 0; i < faces.size(); i++)
+            //Aru tag detection
+            double t_aruco = (double) getTickCount();
+            prepareLuma(ctx);
+            if(ctx.flags.parallelOn)
+                detectMarkersInTiles(ctx);
+            else
             {
-                faceROI = currentFrame( faces[i] );
-
-                //-- In each face, detect eyes
-                eyeCascade.detectMultiScale( faceROI, eyes, 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE, cv::Size(30, 30) );
-qDebug() << "haar eyes detect" << eyes.size();
+                AllocationTrackerPause pause;
+                detectMarkers(ctx.luma,dictionary,ctx.corners,ctx.ids);
             }
+            ctx.arucoTime = ((double) getTickCount() - t_aruco)*1000./cv::getTickFrequency();
+            governor.stageFinished(STAGE_ARUCO, ctx.arucoTime);
+            lastIds=ctx.ids;
+            lastCorners=ctx.corners;
         }
-
-        //Aruco 3D Pose
-        if(imgProcFlags.ArucoOn)
+        // Skipped: reuse last markers
+        else
         {
-            //Aruco 3D Pose
-            if(ids.size() > 0)  // if any markers detected
-            {
-                    drawDetectedMarkers(currentFrame,corners,ids);
-
-                    // 3D pose
-                    vector<Vec3d> rvecs, tvecs;
-                    estimatePoseSingleMarkers(corners,MarkerSizeinMetres,cameraMatrix,distCoeffs,rvecs,tvecs);
-
-                    t_aruco = (double) getTickCount() - t_aruco;
-                    cout << "detection time = " << (t_aruco*1000./cv::getTickFrequency()) << " ms" << endl;
-                    for(unsigned int i = 0; i < ids.size(); i++)
-                    {
-                        drawAxis(currentFrame, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 2*MarkerSizeinMetres);
-
-                        /** rvecs, tvecs legend
-    rvecs[i][0] about x-axis     (face up/down)           (up-positive, down-negative)                  (up=~pi/2     straight=+-pi     down=~-pi/2)
-    rvecs[i][1] about z-axis     (upright/upside down)    (cntrclockwise-positive, clockwise-negative)  (upright=0    upside down=+-pi)
-    rvecs[i][2] about y-axis     (face left/right)        (left-positive, right-negative)               (left=~pi/2   straight=0        right=~-pi/2)
-    tvecs[i][0] axis merah  (x)  (left/right of center)   (left-positive, right-negative)
-    tvecs[i][1] axis ijo    (y)  (above/below center)     (below-positive, above-negative)
-    tvecs[i][2] axis biru   (z)  (distance from camera)   (far-large, near-small)
-*/
-                    }
-            }
+            ctx.ids=lastIds;
+            ctx.corners=lastCorners;
         }
+    }
+    else
+    {
+        ctx.ids.clear();
+        ctx.corners.clear();
+    }
 
-        //Haar cascade face detection draw
-        if(imgProcFlags.faceDetectionOn)
+    bool facesChanged=false;
+    if(ctx.flags.faceDetectionOn || ctx.flags.eyeDetectionOn) //Face detection
+    {
+        if(ctx.geometryChanged || governor.shouldRun(STAGE_FACES))
         {
-            for( size_t i = 0; i < faces.size(); i++)
+            double t_faces = (double) getTickCount();
+            prepareLuma(ctx);
+            Mat &equalized=ctx.arena.image(FRAME_ARENA_EQUALIZED, ctx.luma.size(), CV_8UC1);
             {
-                    cv::rectangle(currentFrame, faces[i], cv::Scalar( 255, 0, 255 ));
-
-                    cv::Point center( faces[i].x + faces[i].width*0.5,
-                                     faces[i].y + faces[i].height*0.5);
+                AllocationTrackerPause pause;
+                cv::equalizeHist(ctx.luma, equalized);
+            }
+            ctx.greyImage=equalized;
 
+            // Calculate the camera size and set the size to 1/8 of screen height
+            if(ctx.flags.parallelOn)
+                detectFacesInBands(ctx, cv::Size(ctx.frame.cols/8, ctx.frame.rows/8));
+            else
+            {
+                AllocationTrackerPause pause;
+                faceCascade.detectMultiScale(ctx.greyImage, ctx.faces, 1.1, 2,  0|cv::CASCADE_SCALE_IMAGE,
+                                             cv::Size(ctx.frame.cols/8, ctx.frame.rows/8)); // Minimum size of obj
             }
+            governor.stageFinished(STAGE_FACES, ((double) getTickCount() - t_faces)*1000./cv::getTickFrequency());
+            facesChanged=haveFacesMoved(lastFaces, ctx.faces);
+            lastFaces=ctx.faces;
         }
+        // Skipped: reuse last faces
+        else
+            ctx.faces=lastFaces;
+    }
+    else
+        ctx.faces.clear();
 
-        //Haar cascade face detection draw
-        if(imgProcFlags.eyeDetectionOn)
+    if(ctx.flags.eyeDetectionOn)
+    {
+        if(ctx.geometryChanged || governor.shouldRunEyes(facesChanged) || lastFaceEyes.size()!=ctx.faces.size())
         {
-            for( size_t i = 0; i < faces.size(); i++)
+            double t_eyes = (double) getTickCount();
+            prepareLuma(ctx);
+            if(ctx.flags.parallelOn)
+                detectEyesInFaces(ctx);
+            else
             {
-                    faceROI = currentFrame( faces[i] );
-
+                ctx.faceEyes.resize(ctx.faces.size());
+                for( size_t i = 0; i < ctx.faces.size(); i++)
+                {
                     //-- In each face, detect eyes
-                    eyeCascade.detectMultiScale( faceROI, eyes, 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE, cv::Size(30, 30) );
-
-                    for( size_t j = 0; j < eyes.size(); j++)
-                    {
-                        cv::Point center( faces[i].x + eyes[j].x + eyes[j].width*0.5,
-                                         faces[i].y + eyes[j].y + eyes[j].height*0.5 );
-                        int radius = cvRound( (eyes[j].width + eyes[j].height) *0.25);
-                        circle( currentFrame, center, radius, cv::Scalar( 255, 0, 0 ), 4, 8, 0);
-                    }
-                     qDebug() << "draw eyes";
+                    AllocationTrackerPause pause;
+                    eyeCascade.detectMultiScale( ctx.luma( ctx.faces[i] ), ctx.faceEyes[i], 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE, cv::Size(30, 30) );
+                }
             }
+            governor.stageFinished(STAGE_EYES, ((double) getTickCount() - t_eyes)*1000./cv::getTickFrequency());
+            lastFaceEyes=ctx.faceEyes;
         }
+        // Skipped: reuse last eyes
+        else
+            ctx.faceEyes=lastFaceEyes;
+    }
 
+    // Captured frame no longer needed (lets the capture buffer be reused)
+    ctx.source=Frame();
+    ctx.luma.release();
+    ctx.greyImage.release();
+}
 
-        ////////////////////////////////////
-        // PERFORM IMAGE PROCESSING ABOVE //
-        ////////////////////////////////////
+void ProcessingThread::prepareLuma(FrameContext &ctx)
+{
+    // Shared by all detection stages of the frame
+    if(!ctx.luma.empty())
+        return;
+    // Already grey
+    if(ctx.frame.channels()==1)
+        ctx.luma=ctx.frame;
+    // Unprocessed frame: use the captured luma plane instead of converting the colour image back
+    else if(!ctx.frameModified && ctx.source.hasLumaPlane())
+        ctx.luma=Mat(ctx.source.gray(), ctx.roi);
+    else
+    {
+        Mat &luma=ctx.arena.image(FRAME_ARENA_LUMA, ctx.frame.size(), CV_8UC1);
+        AllocationTrackerPause pause;
+        cvtColor(ctx.frame, luma, ctx.frame.channels()==4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+        ctx.luma=luma;
+    }
+}
 
-        // Convert Mat to QImage
-        frame=MatToQImage(currentFrame);
-        processingMutex.unlock();
+void ProcessingThread::finishFrame(FrameContext &ctx)
+{
+    StatsTimer timer(stats, STATS_FINISH_NS);
+    TraceScope trace("processing", "finish", deviceNumber, ctx.sequence);
+    FrameArenaScope allocations(ctx.arena);
+    //Aruco 3D Pose
+    if(ctx.flags.ArucoOn)
+    {
+        //Aruco 3D Pose
+        if(ctx.ids.size() > 0)  // if any markers detected
+        {
+                // OpenCV internals (drawing, pose estimation) are not counted
+                AllocationTrackerPause pause;
+                drawDetectedMarkers(ctx.frame,ctx.corners,ctx.ids);
+
+                // 3D pose
+                estimatePoseSingleMarkers(ctx.corners,MarkerSizeinMetres,cameraMatrix,distCoeffs,ctx.rvecs,ctx.tvecs);
+
+                cout << "detection time = " << ctx.arucoTime << " ms" << endl;
+                for(unsigned int i = 0; i < ctx.ids.size(); i++)
+                {
+                    drawAxis(ctx.frame, cameraMatrix, distCoeffs, ctx.rvecs[i], ctx.tvecs[i], 2*MarkerSizeinMetres);
+
+                    /** rvecs, tvecs legend
+rvecs[i][0] about x-axis     (face up/down)           (up-positive, down-negative)                  (up=~pi/2     straight=+-pi     down=~-pi/2)
+rvecs[i][1] about z-axis     (upright/upside down)    (cntrclockwise-positive, clockwise-negative)  (upright=0    upside down=+-pi)
+rvecs[i][2] about y-axis     (face left/right)        (left-positive, right-negative)               (left=~pi/2   straight=0        right=~-pi/2)
+tvecs[i][0] axis merah  (x)  (left/right of center)   (left-positive, right-negative)
+tvecs[i][1] axis ijo    (y)  (above/below center)     (below-positive, above-negative)
+tvecs[i][2] axis biru   (z)  (distance from camera)   (far-large, near-small)
+*/
+                }
+        }
+    }
 
-        // Inform GUI thread of new frame (QImage)
-        emit newFrame(frame);
+    //Haar cascade face detection draw
+    if(ctx.flags.faceDetectionOn)
+    {
+        AllocationTrackerPause pause;
+        for( size_t i = 0; i < ctx.faces.size(); i++)
+        {
+                cv::rectangle(ctx.frame, ctx.faces[i], cv::Scalar( 255, 0, 255 ));
+        }
+    }
 
-        // Update statistics
-        updateFPS(processingTime);
-        statsData.nFramesProcessed++;
-        // Inform GUI of updated statistics
-        emit updateStatisticsInGUI(statsData);
-        emit updateFaceDetected(faces.size());
+    //Haar cascade face detection draw
+    if(ctx.flags.eyeDetectionOn)
+    {
+        AllocationTrackerPause pause;
+        for( size_t i = 0; i < ctx.faces.size(); i++)
+        {
+                // Eyes found for this face during detection
+                const std::vector<cv::Rect> &eyes = ctx.faceEyes[i];
+
+                for( size_t j = 0; j < eyes.size(); j++)
+                {
+                    cv::Point center( ctx.faces[i].x + eyes[j].x + eyes[j].width*0.5,
+                                     ctx.faces[i].y + eyes[j].y + eyes[j].height*0.5 );
+                    int radius = cvRound( (eyes[j].width + eyes[j].height) *0.25);
+                    circle( ctx.frame, center, radius, cv::Scalar( 255, 0, 0 ), 4, 8, 0);
+                }
+        }
     }
-    qDebug() << "Stopping processing thread...";
+
+    ////////////////////////////////////
+    // PERFORM IMAGE PROCESSING ABOVE //
+    ////////////////////////////////////
+
+    // Convert Mat to QImage (into the image of the last frame through this context, once the GUI is done with it)
+    MatToQImage(ctx.frame, ctx.image);
 }
 
-void ProcessingThread::updateFPS(int timeElapsed)
+void ProcessingThread::emitFrame(FrameContext &ctx)
 {
-    // Add instantaneous FPS value to queue
-    if(timeElapsed>0)
+    TraceScope trace("processing", "emit", deviceNumber, ctx.sequence);
+    // Inform GUI thread of new frame (QImage)
+    emit newFrame(ctx.image);
+    emit updateFaceDetected(ctx.faces.size());
+    // Allocations from here on are charged to the frame (queued signals allocate in Qt)
+    struct AllocationCounts allocations=AllocationTracker::threadCounts();
+    // Statistics export: capture-to-results latency and detections (of the stages enabled)
+    qint64 latency=RateEstimator::now()-ctx.timestamp*1000;
+    rate.addLatency(latency);
+    stats.add(STATS_PROCESSING_FRAMES);
+    stats.add(STATS_LATENCY_NS, latency);
+    if(ctx.flags.ArucoOn)
+        stats.add(STATS_MARKERS, ctx.ids.size());
+    if(ctx.flags.faceDetectionOn || ctx.flags.eyeDetectionOn)
+        stats.add(STATS_FACES, ctx.faces.size());
+    if(ctx.flags.eyeDetectionOn)
+        for(size_t i=0; i<ctx.faceEyes.size(); i++)
+            stats.add(STATS_EYES, ctx.faceEyes[i].size());
+    // Publish processed frame to other processes (if enabled for this stream)
+    Frame processedFrame;
+    processedFrame.data=ctx.frame;
+    processedFrame.pixelFormat=ctx.frame.channels()==1 ? PIXEL_FORMAT_GREY : PIXEL_FORMAT_BGR;
+    processedFrame.width=ctx.frame.cols;
+    processedFrame.height=ctx.frame.rows;
+    processedFrame.timestamp=ctx.timestamp;
+    processedFrame.sequence=ctx.sequence;
+    sharedImageBuffer->getFrameExporter()->exportFrame(deviceNumber, FRAME_EXPORT_PROCESSED, processedFrame);
+    // Record (if enabled for this stream, never blocks)
+    if(frameRecorder)
+        frameRecorder->record(RECORDER_STREAM_ANNOTATED, processedFrame);
+    // Start/extend an event clip when a marker appears/disappears or the number of faces changes
+    checkRecorderTriggers(ctx);
+    // Stream detections to local consumers (if enabled in the Options menu)
+    if(ResultPublisher::instance()->isOpen())
     {
-        fps.enqueue((int)1000/timeElapsed);
-        // Increment sample number
-        sampleNumber++;
+        // Results of disabled stages are left over from earlier frames
+        static const vector<int> noIds;
+        static const vector<vector<Point2f>> noCorners;
+        static const vector<Vec3d> noPoses;
+        static const std::vector<cv::Rect> noFaces;
+        static const std::vector<std::vector<cv::Rect>> noEyes;
+        bool markersOn=ctx.flags.ArucoOn && !ctx.ids.empty();
+        bool facesOn=ctx.flags.faceDetectionOn || ctx.flags.eyeDetectionOn;
+        ResultPublisher::instance()->publish(deviceNumber, ctx.sequence, ctx.timestamp,
+                                             markersOn ? ctx.ids : noIds, markersOn ? ctx.corners : noCorners,
+                                             markersOn ? ctx.rvecs : noPoses, markersOn ? ctx.tvecs : noPoses,
+                                             facesOn ? ctx.faces : noFaces,
+                                             ctx.flags.eyeDetectionOn ? ctx.faceEyes : noEyes);
     }
+    statsData.nFramesProcessed++;
+    ctx.arena.addAllocations(AllocationTracker::threadCounts()-allocations);
+    // Frame has left the pipeline (scratch buffers are checked for steady state)
+    ctx.arena.endFrame();
+    ctx.inFlight=false;
+}
 
-    // Maximum size of queue is DEFAULT_PROCESSING_FPS_STAT_QUEUE_LENGTH
-    if(fps.size()>PROCESSING_FPS_STAT_QUEUE_LENGTH)
-        fps.dequeue();
+void ProcessingThread::updateFPS()
+{
+    statsData.averageFPS=rate.getRate();
+    statsData.windowFPS=rate.getWindowRate();
+    statsData.jitterMs=rate.getJitterMs();
+    statsData.minIntervalMs=rate.getMinIntervalMs();
+    statsData.maxIntervalMs=rate.getMaxIntervalMs();
+    statsData.latencyMs=rate.getLatencyMs();
+    statsData.maxLatencyMs=rate.getMaxLatencyMs();
+}
 
-    // Update FPS value every DEFAULT_PROCESSING_FPS_STAT_QUEUE_LENGTH samples
-    if((fps.size()==PROCESSING_FPS_STAT_QUEUE_LENGTH)&&(sampleNumber==PROCESSING_FPS_STAT_QUEUE_LENGTH))
+void ProcessingThread::setThreadPlacement(struct ThreadPlacement threadPlacement)
+{
+    this->threadPlacement=threadPlacement;
+}
+
+void ProcessingThread::checkRecorderTriggers(const FrameContext &ctx)
+{
+    if(!frameRecorder || !frameRecorder->isStreamEnabled(RECORDER_STREAM_EVENTS))
+        return;
+    // Results of a disabled stage are left over from earlier frames: count as nothing detected (switching a stage off is no event)
+    vector<int> ids;
+    if(ctx.flags.ArucoOn)
     {
-        // Empty queue and store sum
-        while(!fps.empty())
-            fpsSum+=fps.dequeue();
-        // Calculate average FPS
-        statsData.averageFPS=fpsSum/PROCESSING_FPS_STAT_QUEUE_LENGTH;
-        // Reset sum
-        fpsSum=0;
-        // Reset sample number
-        sampleNumber=0;
+        ids=ctx.ids;
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        vector<int> appeared, disappeared;
+        std::set_difference(ids.begin(), ids.end(), triggerIds.begin(), triggerIds.end(), std::back_inserter(appeared));
+        std::set_difference(triggerIds.begin(), triggerIds.end(), ids.begin(), ids.end(), std::back_inserter(disappeared));
+        for(size_t i=0; i<appeared.size(); i++)
+            frameRecorder->trigger(RECORDER_TRIGGER_MARKER_APPEARED, appeared[i], ctx.timestamp);
+        for(size_t i=0; i<disappeared.size(); i++)
+            frameRecorder->trigger(RECORDER_TRIGGER_MARKER_DISAPPEARED, disappeared[i], ctx.timestamp);
     }
+    triggerIds.swap(ids);
+    bool facesOn=ctx.flags.faceDetectionOn || ctx.flags.eyeDetectionOn;
+    int faces=facesOn ? (int)ctx.faces.size() : 0;
+    if(facesOn && faces!=triggerFaces)
+        frameRecorder->trigger(RECORDER_TRIGGER_FACE_COUNT_CHANGED, faces, ctx.timestamp);
+    triggerFaces=faces;
+}
+
+void ProcessingThread::setFrameRecorder(FrameRecorder *frameRecorder)
+{
+    this->frameRecorder=frameRecorder;
 }
 
 void ProcessingThread::stop()
@@ -331,49 +670,67 @@ void ProcessingThread::stop()
 
 void ProcessingThread::updateImageProcessingFlags(struct ImageProcessingFlags imgProcFlags)
 {
-    QMutexLocker locker(&processingMutex);
-    this->imgProcFlags.grayscaleOn=imgProcFlags.grayscaleOn;
-    this->imgProcFlags.smoothOn=imgProcFlags.smoothOn;
-    this->imgProcFlags.dilateOn=imgProcFlags.dilateOn;
-    this->imgProcFlags.erodeOn=imgProcFlags.erodeOn;
-    this->imgProcFlags.flipOn=imgProcFlags.flipOn;
-    this->imgProcFlags.cannyOn=imgProcFlags.cannyOn;
-    this->imgProcFlags.ArucoOn=imgProcFlags.ArucoOn;
-    this->imgProcFlags.sharpeningOn=imgProcFlags.sharpeningOn;
-    this->imgProcFlags.faceDetectionOn=imgProcFlags.faceDetectionOn;
-    this->imgProcFlags.eyeDetectionOn=imgProcFlags.eyeDetectionOn;
-
+    QMutexLocker locker(&snapshotWriteMutex);
+    ProcessingSnapshot *next=new ProcessingSnapshot(*std::atomic_load(&snapshot));
+    next->flags.grayscaleOn=imgProcFlags.grayscaleOn;
+    next->flags.smoothOn=imgProcFlags.smoothOn;
+    next->flags.dilateOn=imgProcFlags.dilateOn;
+    next->flags.erodeOn=imgProcFlags.erodeOn;
+    next->flags.flipOn=imgProcFlags.flipOn;
+    next->flags.cannyOn=imgProcFlags.cannyOn;
+    next->flags.ArucoOn=imgProcFlags.ArucoOn;
+    next->flags.sharpeningOn=imgProcFlags.sharpeningOn;
+    next->flags.faceDetectionOn=imgProcFlags.faceDetectionOn;
+    next->flags.eyeDetectionOn=imgProcFlags.eyeDetectionOn;
+    next->flags.parallelOn=imgProcFlags.parallelOn;
+    next->flags.pipelineOn=imgProcFlags.pipelineOn;
+    next->flags.governorOn=imgProcFlags.governorOn;
+    publishSnapshot(next);
 }
 
 void ProcessingThread::updateImageProcessingSettings(struct ImageProcessingSettings imgProcSettings)
 {
-    QMutexLocker locker(&processingMutex);
-    this->imgProcSettings.smoothType=imgProcSettings.smoothType;
-    this->imgProcSettings.smoothParam1=imgProcSettings.smoothParam1;
-    this->imgProcSettings.smoothParam2=imgProcSettings.smoothParam2;
-    this->imgProcSettings.smoothParam3=imgProcSettings.smoothParam3;
-    this->imgProcSettings.smoothParam4=imgProcSettings.smoothParam4;
-    this->imgProcSettings.dilateNumberOfIterations=imgProcSettings.dilateNumberOfIterations;
-    this->imgProcSettings.erodeNumberOfIterations=imgProcSettings.erodeNumberOfIterations;
-    this->imgProcSettings.flipCode=imgProcSettings.flipCode;
-    this->imgProcSettings.cannyThreshold1=imgProcSettings.cannyThreshold1;
-    this->imgProcSettings.cannyThreshold2=imgProcSettings.cannyThreshold2;
-    this->imgProcSettings.cannyApertureSize=imgProcSettings.cannyApertureSize;
-    this->imgProcSettings.cannyL2gradient=imgProcSettings.cannyL2gradient;
+    QMutexLocker locker(&snapshotWriteMutex);
+    ProcessingSnapshot *next=new ProcessingSnapshot(*std::atomic_load(&snapshot));
+    next->settings.smoothType=imgProcSettings.smoothType;
+    next->settings.smoothParam1=imgProcSettings.smoothParam1;
+    next->settings.smoothParam2=imgProcSettings.smoothParam2;
+    next->settings.smoothParam3=imgProcSettings.smoothParam3;
+    next->settings.smoothParam4=imgProcSettings.smoothParam4;
+    next->settings.dilateNumberOfIterations=imgProcSettings.dilateNumberOfIterations;
+    next->settings.erodeNumberOfIterations=imgProcSettings.erodeNumberOfIterations;
+    next->settings.flipCode=imgProcSettings.flipCode;
+    next->settings.cannyThreshold1=imgProcSettings.cannyThreshold1;
+    next->settings.cannyThreshold2=imgProcSettings.cannyThreshold2;
+    next->settings.cannyApertureSize=imgProcSettings.cannyApertureSize;
+    next->settings.cannyL2gradient=imgProcSettings.cannyL2gradient;
+    next->settings.governorTargetFPS=imgProcSettings.governorTargetFPS;
+    publishSnapshot(next);
 }
 
 void ProcessingThread::setROI(QRect roi)
 {
-    QMutexLocker locker(&processingMutex);
-    currentROI.x = roi.x();
-    currentROI.y = roi.y();
-    currentROI.width = roi.width();
-    currentROI.height = roi.height();
+    QMutexLocker locker(&snapshotWriteMutex);
+    ProcessingSnapshot *next=new ProcessingSnapshot(*std::atomic_load(&snapshot));
+    next->roi.x = roi.x();
+    next->roi.y = roi.y();
+    next->roi.width = roi.width();
+    next->roi.height = roi.height();
+    publishSnapshot(next);
+}
+
+void ProcessingThread::publishSnapshot(ProcessingSnapshot *next)
+{
+    // Readers holding the previous snapshot keep it alive until they are done with it
+    std::shared_ptr<const ProcessingSnapshot> previous=std::atomic_load(&snapshot);
+    next->version=previous ? previous->version+1 : 0;
+    std::atomic_store(&snapshot, std::shared_ptr<const ProcessingSnapshot>(next));
 }
 
 QRect ProcessingThread::getCurrentROI()
 {
-    return QRect(currentROI.x, currentROI.y, currentROI.width, currentROI.height);
+    std::shared_ptr<const ProcessingSnapshot> current=std::atomic_load(&snapshot);
+    return QRect(current->roi.x, current->roi.y, current->roi.width, current->roi.height);
 }
 
 void ProcessingThread::cascadeLoadFiles(cv::String faceCascadeFilename,
@@ -389,4 +746,147 @@ void ProcessingThread::cascadeLoadFiles(cv::String faceCascadeFilename,
     {
         std::cout << "Error Loading" << eyeCascadeFilename << std::endl;
     }
+
+    // Private copies for parallel detection
+    faceCascadeBands.resize(CASCADE_SCALE_BANDS);
+    eyeCascadeBands.resize(CASCADE_SCALE_BANDS);
+    for(int i=0; i<CASCADE_SCALE_BANDS; i++)
+    {
+        faceCascadeBands[i].load(faceCascadeFilename);
+        eyeCascadeBands[i].load(eyeCascadeFilename);
+    }
+}
+
+template<typename Filter> void ProcessingThread::applyFilter(FrameContext &ctx, int outputType, const Filter &filter, bool tiled)
+{
+    // Filtered frame goes into the other frame buffer (no in-place copies, no new buffer per filter)
+    Mat &filteredFrame=ctx.arena.frameBuffer(ctx.frame, ctx.frame.size(), outputType);
+    // Split frame into horizontal bands (at least PARALLEL_MIN_TILE_ROWS rows each)
+    int nTiles=min(WorkerPool::instance()->maxThreadCount(), ctx.frame.rows/PARALLEL_MIN_TILE_ROWS);
+    // Run on whole frame
+    if(!tiled || !ctx.flags.parallelOn || nTiles<2)
+    {
+        AllocationTrackerPause pause;
+        filter(ctx.frame, filteredFrame);
+        ctx.frame=filteredFrame;
+        return;
+    }
+
+    // Tiles are views into the frame, so filters still read neighbouring rows across tile edges
+    WorkerPool::instance()->parallelFor(nTiles, [&](int i) {
+        Range rows(ctx.frame.rows*i/nTiles, ctx.frame.rows*(i+1)/nTiles);
+        Mat dst=filteredFrame.rowRange(rows);
+        // OpenCV internals are not counted (filters are OpenCV calls)
+        AllocationTrackerPause pause;
+        filter(ctx.frame.rowRange(rows), dst);
+    });
+    ctx.frame=filteredFrame;
+}
+
+void ProcessingThread::detectMarkersInTiles(FrameContext &ctx)
+{
+    const Mat &image=ctx.luma;
+    // Tile grid
+    int nTiles=max(1, WorkerPool::instance()->maxThreadCount());
+    int gridCols=(int)ceil(sqrt((double)nTiles));
+    int gridRows=(nTiles+gridCols-1)/gridCols;
+    nTiles=gridCols*gridRows;
+    // Markers smaller than the overlap always lie wholly inside at least one tile
+    int overlap=(int)(ARUCO_TILE_OVERLAP*max(image.cols, image.rows));
+    Rect frameRect(0, 0, image.cols, image.rows);
+
+    // Per-tile results and parameters are kept in the arena (tiles only change with the frame size)
+    vector<vector<int>> &tileIds=ctx.arena.tileIds;
+    vector<vector<vector<Point2f>>> &tileCorners=ctx.arena.tileCorners;
+    vector<Ptr<DetectorParameters>> &tileParameters=ctx.arena.tileParameters;
+    tileIds.resize(nTiles);
+    tileCorners.resize(nTiles);
+    tileParameters.resize(nTiles);
+    WorkerPool::instance()->parallelFor(nTiles, [&](int i) {
+        int col=i%gridCols;
+        int row=i/gridCols;
+        Rect tile(image.cols*col/gridCols-overlap/2, image.rows*row/gridRows-overlap/2,
+                  image.cols/gridCols+overlap, image.rows/gridRows+overlap);
+        tile&=frameRect;
+        // Perimeter limits are relative to the image size: keep them relative to the full frame
+        Ptr<DetectorParameters> &parameters=tileParameters[i];
+        if(!parameters)
+        {
+            parameters=DetectorParameters::create();
+            double scale=(double)max(image.cols, image.rows)/max(tile.width, tile.height);
+            parameters->minMarkerPerimeterRate*=scale;
+            parameters->maxMarkerPerimeterRate*=scale;
+        }
+        {
+            AllocationTrackerPause pause;
+            detectMarkers(image(tile), dictionary, tileCorners[i], tileIds[i], parameters);
+        }
+        // Move corners back to frame coordinates
+        for(size_t j=0; j<tileCorners[i].size(); j++)
+            for(size_t k=0; k<tileCorners[i][j].size(); k++)
+                tileCorners[i][j][k]+=Point2f(tile.x, tile.y);
+    });
+
+    // Merge tiles, dropping markers found twice in an overlap region
+    ctx.ids.clear();
+    ctx.corners.clear();
+    for(int i=0; i<nTiles; i++)
+    {
+        for(size_t j=0; j<tileIds[i].size(); j++)
+        {
+            bool duplicate=false;
+            for(size_t k=0; k<ctx.ids.size() && !duplicate; k++)
+                duplicate=(ctx.ids[k]==tileIds[i][j]) && (norm(ctx.corners[k][0]-tileCorners[i][j][0])<2.0);
+            if(!duplicate)
+            {
+                ctx.ids.push_back(tileIds[i][j]);
+                ctx.corners.push_back(tileCorners[i][j]);
+            }
+        }
+    }
+}
+
+void ProcessingThread::detectFacesInBands(FrameContext &ctx, Size minSize)
+{
+    const Mat &greyImage=ctx.greyImage;
+    // Split the range of window sizes [minSize, frame size] into geometric bands
+    int nBands=(int)faceCascadeBands.size();
+    double ratio=pow((double)greyImage.rows/max(minSize.height, 1), 1.0/nBands);
+
+    vector<vector<Rect>> &bandFaces=ctx.arena.bandFaces;
+    bandFaces.resize(nBands);
+    WorkerPool::instance()->parallelFor(nBands, [&](int i) {
+        Size bandMinSize(cvRound(minSize.width*pow(ratio, i)), cvRound(minSize.height*pow(ratio, i)));
+        Size bandMaxSize=(i==nBands-1) ? greyImage.size() :
+                         Size(cvRound(minSize.width*pow(ratio, i+1)), cvRound(minSize.height*pow(ratio, i+1)));
+        AllocationTrackerPause pause;
+        faceCascadeBands[i].detectMultiScale(greyImage, bandFaces[i], 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE,
+                                             bandMinSize, bandMaxSize);
+    });
+
+    // Merge bands, keeping the larger of two faces found on either side of a band edge
+    ctx.faces.clear();
+    for(int i=nBands-1; i>=0; i--)
+    {
+        for(size_t j=0; j<bandFaces[i].size(); j++)
+        {
+            bool duplicate=false;
+            for(size_t k=0; k<ctx.faces.size() && !duplicate; k++)
+                duplicate=(ctx.faces[k] & bandFaces[i][j]).area() > 0.5*bandFaces[i][j].area();
+            if(!duplicate)
+                ctx.faces.push_back(bandFaces[i][j]);
+        }
+    }
+}
+
+void ProcessingThread::detectEyesInFaces(FrameContext &ctx)
+{
+    ctx.faceEyes.resize(ctx.faces.size());
+    // Each task handles every nTasks-th face with its own classifier
+    int nTasks=min((int)ctx.faces.size(), (int)eyeCascadeBands.size());
+    WorkerPool::instance()->parallelFor(nTasks, [&](int i) {
+        AllocationTrackerPause pause;
+        for(size_t j=i; j<ctx.faces.size(); j+=nTasks)
+            eyeCascadeBands[i].detectMultiScale(ctx.luma(ctx.faces[j]), ctx.faceEyes[j], 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE, cv::Size(30, 30));
+    });
 }
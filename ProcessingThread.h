@@ -36,6 +36,7 @@
 // Qt
 #include <QtCore/QThread>
 #include <QtCore/QTime>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QQueue>
 #include <QObject>
 #include <QBasicTimer>
@@ -51,6 +52,7 @@
 #include <opencv2/highgui/highgui.hpp>
 // Local
 #include "Structures.h"
+#include "ThreadPlacement.h"
 
 #include "Config.h"
 #include "Buffer.h"
@@ -58,12 +60,64 @@
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 #include "MatToQImage.h"
+#include "WorkerPool.h"
+#include "DetectionGovernor.h"
+#include "ResultPublisher.h"
+#include "FrameRecorder.h"
+#include "StatsRegistry.h"
+#include "RateEstimator.h"
+#include "TraceRecorder.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
 #include <opencv2/aruco.hpp>
+// C++
+#include <memory>
 
 using namespace cv;
 using namespace std;
 using namespace aruco;
 
+// Immutable set of processing settings. A new snapshot is published on every
+// change; the processing loop picks up the latest one at the start of each frame.
+struct ProcessingSnapshot{
+    ProcessingSnapshot() : flags(), settings(), version(0) {}
+    struct ImageProcessingFlags flags;
+    struct ImageProcessingSettings settings;
+    Rect roi;
+    quint64 version;
+};
+
+// Everything one frame needs on its way through the processing stages
+struct FrameContext{
+    FrameContext() : settingsVersion(0), sequence(0), timestamp(0), geometryChanged(false), frameModified(false), arucoTime(0), inFlight(false) {}
+    struct ImageProcessingFlags flags;
+    struct ImageProcessingSettings settings;
+    quint64 settingsVersion;
+    // Frame as captured (held until detection is done, its luma plane may still be needed)
+    Frame source;
+    // Sequence number and capture time of the source (kept after the source is released)
+    quint64 sequence;
+    qint64 timestamp;
+    Rect roi;
+    // Resolution or ROI differs from the last frame through this context (results of earlier frames do not apply)
+    bool geometryChanged;
+    Mat frame;
+    bool frameModified;
+    // Grey image used by detection, equalized copy used by face detection
+    Mat luma;
+    Mat greyImage;
+    vector<int> ids;
+    vector<vector<Point2f>> corners;
+    vector<Vec3d> rvecs, tvecs;
+    std::vector<cv::Rect> faces;
+    std::vector<std::vector<cv::Rect>> faceEyes;
+    double arucoTime;
+    QImage image;
+    bool inFlight;
+    // Scratch buffers reused by every frame passing through this context
+    FrameArena arena;
+};
+
 class ProcessingThread : public QThread
 {
     Q_OBJECT
@@ -72,9 +126,9 @@ class ProcessingThread : public QThread
     QString eyecascade_filename_;
     cv::CascadeClassifier faceCascade;
     cv::CascadeClassifier eyeCascade;
-    std::vector<cv::Rect> faces;
-    cv::Mat faceROI;
-    std::vector<cv::Rect> eyes;
+    // One classifier per parallel task (CascadeClassifier is not safe to share between threads)
+    std::vector<cv::CascadeClassifier> faceCascadeBands;
+    std::vector<cv::CascadeClassifier> eyeCascadeBands;
 
     void process(cv::Mat frame);
     void cascadeLoadFiles(cv::String faceCascadeFilename, cv::String eyesCascadeFilename);
@@ -86,29 +140,53 @@ class ProcessingThread : public QThread
         ProcessingThread(SharedImageBuffer *sharedImageBuffer, int deviceNumber);
         QRect getCurrentROI();
         void stop();
+        void setThreadPlacement(struct ThreadPlacement threadPlacement);
+        void setFrameRecorder(FrameRecorder *frameRecorder);
+        // Process one frame (called by run() or, in pool mode, by a processing pool worker)
+        void processFrame(const Frame &grabbedFrame);
 
     private:
-        void updateFPS(int);
+        void updateFPS();
         void setROI();
         void resetROI();
+        void startFrame(FrameContext &ctx, const Frame &grabbedFrame);
+        void prepareLuma(FrameContext &ctx);
+        void preprocessFrame(FrameContext &ctx);
+        void detectFrame(FrameContext &ctx);
+        void finishFrame(FrameContext &ctx);
+        void emitFrame(FrameContext &ctx);
+        void checkRecorderTriggers(const FrameContext &ctx);
+        template<typename Filter> void applyFilter(FrameContext &ctx, int outputType, const Filter &filter, bool tiled=true);
+        void detectMarkersInTiles(FrameContext &ctx);
+        void detectFacesInBands(FrameContext &ctx, Size minSize);
+        void detectEyesInFaces(FrameContext &ctx);
+        void publishSnapshot(ProcessingSnapshot *next);
         SharedImageBuffer *sharedImageBuffer;
-        Mat currentFrame;
-        Mat currentFrameGrayscale;
-        Rect currentROI;
-        QImage frame;
-        QTime t;
-        QQueue<int> fps;
+        StatsBlock stats;
+        FrameContext pipeline[3];
+        FrameContext *preprocessCtx;
+        FrameContext *detectCtx;
+        FrameContext *finishCtx;
+        std::shared_ptr<const ProcessingSnapshot> snapshot;
+        QMutex snapshotWriteMutex;
+        DetectionGovernor governor;
+        QElapsedTimer busyTimer;
+        // Results of the last run of each detection stage (reused when the governor skips a stage)
+        vector<int> lastIds;
+        vector<vector<Point2f>> lastCorners;
+        std::vector<cv::Rect> lastFaces;
+        std::vector<std::vector<cv::Rect>> lastFaceEyes;
+        // Detections of the previous frame (event recording triggers on changes)
+        vector<int> triggerIds;
+        int triggerFaces;
+        RateEstimator rate;
         QMutex doStopMutex;
-        QMutex processingMutex;
         Size frameSize;
         Point framePoint;
-        struct ImageProcessingFlags imgProcFlags;
-        struct ImageProcessingSettings imgProcSettings;
         struct ThreadStatisticsData statsData;
+        struct ThreadPlacement threadPlacement;
+        FrameRecorder *frameRecorder;
         volatile bool doStop;
-        int processingTime;
-        int fpsSum;
-        int sampleNumber;
         int deviceNumber;
         bool enableFrameProcessing;
         Mat sharpeningKernel;
@@ -127,10 +205,6 @@ class ProcessingThread : public QThread
             zrot01 = false,
             yrot02 = false;
 
-        vector<int> ids;
-        vector<vector<Point2f>> corners;
-        double t_aruco;
-
     protected:
         void run();
 
@@ -142,6 +216,7 @@ class ProcessingThread : public QThread
     signals:
         void newFrame(const QImage &frame);
         void updateStatisticsInGUI(struct ThreadStatisticsData);
+        void updateThreadPlacementInGUI(QString);
         void updateFaceDetected(int faceDetectedAmount);
 };
 
@@ -0,0 +1,195 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* RateEstimator.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "RateEstimator.h"
+
+// C++
+#include <chrono>
+#include <cmath>
+
+RateEstimator::RateEstimator()
+{
+    reset();
+}
+
+void RateEstimator::reset()
+{
+    intervals.clear();
+    latencies.clear();
+    last=0;
+    count=0;
+    averageInterval=0;
+    averageLatency=0;
+}
+
+void RateEstimator::tick(qint64 now)
+{
+    count++;
+    // First frame: nothing to measure yet
+    if(count>1)
+    {
+        qint64 interval=now-last;
+        intervals.add(interval);
+        averageInterval=(count==2) ? interval : RATE_ESTIMATOR_EWMA_ALPHA*interval+(1.0-RATE_ESTIMATOR_EWMA_ALPHA)*averageInterval;
+    }
+    last=now;
+}
+
+void RateEstimator::addLatency(qint64 latency)
+{
+    averageLatency=(latencies.size()==0) ? latency : RATE_ESTIMATOR_EWMA_ALPHA*latency+(1.0-RATE_ESTIMATOR_EWMA_ALPHA)*averageLatency;
+    latencies.add(latency);
+}
+
+quint64 RateEstimator::getCount()
+{
+    return count;
+}
+
+double RateEstimator::getRate()
+{
+    return averageInterval>0 ? 1e9/averageInterval : 0;
+}
+
+double RateEstimator::getWindowRate()
+{
+    double mean=intervals.mean();
+    return mean>0 ? 1e9/mean : 0;
+}
+
+double RateEstimator::getJitterMs()
+{
+    return intervals.stddev()/1e6;
+}
+
+double RateEstimator::getMinIntervalMs()
+{
+    return intervals.min()/1e6;
+}
+
+double RateEstimator::getMaxIntervalMs()
+{
+    return intervals.max()/1e6;
+}
+
+double RateEstimator::getLatencyMs()
+{
+    return averageLatency/1e6;
+}
+
+double RateEstimator::getMaxLatencyMs()
+{
+    return latencies.max()/1e6;
+}
+
+qint64 RateEstimator::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RateEstimator::Window::Window()
+{
+    clear();
+}
+
+void RateEstimator::Window::clear()
+{
+    count=0;
+    next=0;
+    summarized=false;
+}
+
+void RateEstimator::Window::add(qint64 sample)
+{
+    samples[next]=sample;
+    next=(next+1)%RATE_ESTIMATOR_WINDOW;
+    if(count<RATE_ESTIMATOR_WINDOW)
+        count++;
+    summarized=false;
+}
+
+int RateEstimator::Window::size()
+{
+    return count;
+}
+
+double RateEstimator::Window::mean()
+{
+    summarize();
+    return sampleMean;
+}
+
+double RateEstimator::Window::stddev()
+{
+    summarize();
+    return sampleStddev;
+}
+
+qint64 RateEstimator::Window::min()
+{
+    summarize();
+    return sampleMin;
+}
+
+qint64 RateEstimator::Window::max()
+{
+    summarize();
+    return sampleMax;
+}
+
+void RateEstimator::Window::summarize()
+{
+    if(summarized)
+        return;
+    summarized=true;
+    sampleMean=0;
+    sampleStddev=0;
+    sampleMin=0;
+    sampleMax=0;
+    if(count==0)
+        return;
+    // Two passes (intervals are large numbers with small differences)
+    double sum=0;
+    sampleMin=samples[0];
+    sampleMax=samples[0];
+    for(int i=0; i<count; i++)
+    {
+        sum+=samples[i];
+        sampleMin=qMin(sampleMin, samples[i]);
+        sampleMax=qMax(sampleMax, samples[i]);
+    }
+    sampleMean=sum/count;
+    double sumSquares=0;
+    for(int i=0; i<count; i++)
+        sumSquares+=(samples[i]-sampleMean)*(samples[i]-sampleMean);
+    sampleStddev=std::sqrt(sumSquares/count);
+}
@@ -0,0 +1,101 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* RateEstimator.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef RATEESTIMATOR_H
+#define RATEESTIMATOR_H
+
+// Qt
+#include <QtCore/QtGlobal>
+// Local
+#include "Config.h"
+
+// Rate and timing statistics of a stream of frames from steady-clock time in
+// nanoseconds: an exponentially weighted average rate that follows changes
+// smoothly, plus the rate, jitter (standard deviation of the frame interval) and
+// shortest/longest interval over the last RATE_ESTIMATOR_WINDOW frames. Optional
+// per-frame latencies are tracked the same way. Used by one thread only.
+class RateEstimator
+{
+    public:
+        RateEstimator();
+        void reset();
+        // One frame at time now (steady clock, nanoseconds)
+        void tick(qint64 now=RateEstimator::now());
+        // Latency of the last frame (nanoseconds)
+        void addLatency(qint64 latency);
+        quint64 getCount();
+        // Rates in frames per second
+        double getRate();
+        double getWindowRate();
+        // Frame intervals in the window (milliseconds)
+        double getJitterMs();
+        double getMinIntervalMs();
+        double getMaxIntervalMs();
+        // Average and maximum (in the window) latency (milliseconds)
+        double getLatencyMs();
+        double getMaxLatencyMs();
+        static qint64 now();
+
+    private:
+        // Last RATE_ESTIMATOR_WINDOW samples, summarized when asked for (once per change)
+        class Window
+        {
+            public:
+                Window();
+                void clear();
+                void add(qint64 sample);
+                int size();
+                double mean();
+                double stddev();
+                qint64 min();
+                qint64 max();
+
+            private:
+                void summarize();
+                qint64 samples[RATE_ESTIMATOR_WINDOW];
+                int count;
+                int next;
+                bool summarized;
+                double sampleMean;
+                double sampleStddev;
+                qint64 sampleMin;
+                qint64 sampleMax;
+        };
+        Window intervals;
+        Window latencies;
+        qint64 last;
+        quint64 count;
+        double averageInterval;
+        double averageLatency;
+};
+
+#endif // RATEESTIMATOR_H
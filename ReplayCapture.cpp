@@ -0,0 +1,357 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ReplayCapture.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ReplayCapture.h"
+// Qt
+#include <QAtomicInt>
+#include <QDebug>
+// Local
+#include "Config.h"
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+// C++
+#include <chrono>
+#include <thread>
+
+namespace {
+
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+// Owns the mapped file. Also acts as the allocator of the Mats wrapping frames in
+// the mapping, so it is reference counted: by ReplayCapture and by every frame
+// currently held by the application. The last reference unmaps the file.
+class ReplayMapping : public DeviceBufferAllocator
+{
+    public:
+        ReplayMapping(void *start, size_t length) : start((uchar*)start), length(length), refs(1) {}
+
+        UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           AccessFlag flags, UMatUsageFlags usageFlags) const
+        {
+            // Mats reallocated in place (e.g. by an in-place colour conversion) get ordinary memory
+            return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        bool allocate(UMatData* data, AccessFlag accessflags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+        }
+
+        void deallocate(UMatData* u) const
+        {
+            delete u;
+            const_cast<ReplayMapping*>(this)->unref();
+        }
+
+        // Wrap frame data in a Mat without copying
+        Mat wrap(const ReplayIndexEntry &entry)
+        {
+            UMatData *u=new UMatData(this);
+            u->data=u->origdata=start+entry.offset;
+            u->size=entry.dataSize;
+            u->flags|=UMatData::USER_ALLOCATED;
+            u->refcount=1;
+            ref();
+            Mat frame(entry.rows, entry.cols, entry.cvType, start+entry.offset);
+            frame.u=u;
+            frame.allocator=this;
+            return frame;
+        }
+
+        void ref()
+        {
+            refs.ref();
+        }
+
+        void unref()
+        {
+            if(!refs.deref())
+            {
+                munmap(start, length);
+                delete this;
+            }
+        }
+
+        uchar *start;
+        size_t length;
+
+    private:
+        QAtomicInt refs;
+};
+
+ReplayCapture::ReplayCapture()
+{
+    // Initialize members
+    mapping=NULL;
+    index=NULL;
+    nFrames=0;
+    next=0;
+    readaheadFrom=0;
+    sequence=0;
+    paceFileStart=0;
+    paceStart=0;
+}
+
+ReplayCapture::~ReplayCapture()
+{
+    close();
+}
+
+bool ReplayCapture::open(const QString &path)
+{
+    close();
+    int fd=::open(path.toLocal8Bit().constData(), O_RDONLY);
+    if(fd==-1)
+    {
+        qDebug() << "ERROR: Could not open" << path << ":" << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st)==-1 || (size_t)st.st_size<sizeof(ReplayFileHeader))
+    {
+        qDebug() << "ERROR:" << path << "is not a replay file.";
+        ::close(fd);
+        return false;
+    }
+    // Private mapping: frames modified in place by processing never reach the file
+    void *start=mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(start==MAP_FAILED)
+    {
+        qDebug() << "ERROR: Could not map" << path << ":" << strerror(errno);
+        return false;
+    }
+    mapping=new ReplayMapping(start, st.st_size);
+
+    // Header and index must be complete (index is only written when the recording is closed)
+    const ReplayFileHeader *header=(const ReplayFileHeader*)start;
+    if(header->magic!=REPLAY_MAGIC || header->version!=REPLAY_VERSION || header->headerSize<sizeof(ReplayFileHeader) ||
+       header->indexEntrySize!=sizeof(ReplayIndexEntry) || header->indexOffset==0 || header->nFrames==0 ||
+       header->indexOffset+header->nFrames*sizeof(ReplayIndexEntry)>(quint64)st.st_size)
+    {
+        qDebug() << "ERROR:" << path << "is not a complete replay file.";
+        close();
+        return false;
+    }
+    index=(const ReplayIndexEntry*)(mapping->start+header->indexOffset);
+    nFrames=header->nFrames;
+    for(quint64 i=0; i<nFrames; i++)
+    {
+        if(index[i].offset+index[i].dataSize>header->indexOffset ||
+           (quint64)index[i].rows*index[i].cols*CV_ELEM_SIZE(index[i].cvType)>index[i].dataSize)
+        {
+            qDebug() << "ERROR:" << path << "has a corrupt index (frame" << i << ").";
+            close();
+            return false;
+        }
+    }
+
+    // Small files are read into the page cache up front (loops then run at memory speed), large ones as they are played
+    if(st.st_size<=REPLAY_PRELOAD_MAX_BYTES)
+        madvise(start, st.st_size, MADV_WILLNEED);
+    else
+        madvise(start, st.st_size, MADV_SEQUENTIAL);
+    next=0;
+    readaheadFrom=0;
+    paceStart=0;
+    qDebug() << "Replaying" << path << ":" << nFrames << "frames";
+    return true;
+}
+
+void ReplayCapture::close()
+{
+    if(mapping)
+    {
+        // Frames still held by the application keep the mapping alive until they are released
+        mapping->unref();
+        mapping=NULL;
+    }
+    index=NULL;
+    nFrames=0;
+}
+
+bool ReplayCapture::isOpened()
+{
+    return mapping!=NULL;
+}
+
+bool ReplayCapture::grab(Frame &frame)
+{
+    if(!mapping)
+        return false;
+    // End of file: start again (or report the source as gone)
+    if(next==nFrames)
+    {
+        if(!REPLAY_LOOP)
+            return false;
+        next=0;
+        readaheadFrom=0;
+        paceStart=0;
+    }
+    const ReplayIndexEntry &entry=index[next];
+    // Ask the kernel for the next frames before they are needed
+    if(next>=readaheadFrom)
+        readahead();
+    // Pace like the original capture (if enabled)
+    if(REPLAY_REALTIME)
+    {
+        if(paceStart==0)
+        {
+            paceStart=now();
+            paceFileStart=entry.timestamp;
+        }
+        else
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                std::chrono::microseconds(paceStart+(entry.timestamp-paceFileStart))));
+    }
+    frame.data=mapping->wrap(entry);
+    frame.pixelFormat=entry.pixelFormat;
+    frame.width=entry.width;
+    frame.height=entry.height;
+    frame.timestamp=now();
+    frame.sequence=sequence++;
+    next++;
+    return true;
+}
+
+void ReplayCapture::readahead()
+{
+    // Preloaded file: nothing to do
+    if(mapping->length<=(size_t)REPLAY_PRELOAD_MAX_BYTES)
+    {
+        readaheadFrom=nFrames;
+        return;
+    }
+    // Advise the next window of frames, again half way through it (page-aligned start)
+    quint64 last=qMin(next+REPLAY_READAHEAD_FRAMES, nFrames)-1;
+    size_t pageSize=sysconf(_SC_PAGESIZE);
+    size_t begin=index[next].offset/pageSize*pageSize;
+    size_t end=index[last].offset+index[last].dataSize;
+    madvise(mapping->start+begin, end-begin, MADV_WILLNEED);
+    readaheadFrom=next+qMax(REPLAY_READAHEAD_FRAMES/2, 1);
+}
+
+int ReplayCapture::getWidth()
+{
+    return mapping ? index[0].width : 0;
+}
+
+int ReplayCapture::getHeight()
+{
+    return mapping ? index[0].height : 0;
+}
+
+int ReplayCapture::getPixelFormat()
+{
+    return mapping ? index[0].pixelFormat : PIXEL_FORMAT_BGR;
+}
+
+quint64 ReplayCapture::getFrameCount()
+{
+    return nFrames;
+}
+
+#else
+
+ReplayCapture::ReplayCapture()
+{
+    mapping=NULL;
+    index=NULL;
+    nFrames=0;
+    next=0;
+    readaheadFrom=0;
+    sequence=0;
+    paceFileStart=0;
+    paceStart=0;
+}
+
+ReplayCapture::~ReplayCapture()
+{
+}
+
+bool ReplayCapture::open(const QString &)
+{
+    qDebug() << "ERROR: Replay files are only available on Unix.";
+    return false;
+}
+
+void ReplayCapture::close()
+{
+}
+
+bool ReplayCapture::isOpened()
+{
+    return false;
+}
+
+bool ReplayCapture::grab(Frame &)
+{
+    return false;
+}
+
+void ReplayCapture::readahead()
+{
+}
+
+int ReplayCapture::getWidth()
+{
+    return 0;
+}
+
+int ReplayCapture::getHeight()
+{
+    return 0;
+}
+
+int ReplayCapture::getPixelFormat()
+{
+    return PIXEL_FORMAT_BGR;
+}
+
+quint64 ReplayCapture::getFrameCount()
+{
+    return 0;
+}
+
+#endif
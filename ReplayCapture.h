@@ -0,0 +1,80 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ReplayCapture.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef REPLAYCAPTURE_H
+#define REPLAYCAPTURE_H
+
+// Qt
+#include <QtCore/QString>
+// OpenCV
+#include <opencv2/core.hpp>
+// Local
+#include "Frame.h"
+#include "ReplayFormat.h"
+
+using namespace cv;
+
+class ReplayMapping;
+
+// Plays back a frame replay file (ReplayFormat.h) at memory speed for throughput
+// testing. The file is memory-mapped and frames returned by grab() point straight
+// into the mapping (copy-on-write: the file is never modified); the mapping stays
+// valid until the last Mat referencing it is released. Frames get the current
+// time as capture time (REPLAY_REALTIME paces them like the original capture).
+class ReplayCapture
+{
+    public:
+        ReplayCapture();
+        ~ReplayCapture();
+        bool open(const QString &path);
+        void close();
+        bool isOpened();
+        bool grab(Frame &frame);
+        int getWidth();
+        int getHeight();
+        int getPixelFormat();
+        quint64 getFrameCount();
+
+    private:
+        void readahead();
+        ReplayMapping *mapping;
+        const ReplayIndexEntry *index;
+        quint64 nFrames;
+        quint64 next;
+        quint64 readaheadFrom;
+        quint64 sequence;
+        // Pacing (REPLAY_REALTIME): capture time of the first frame played and when it was played
+        qint64 paceFileStart;
+        qint64 paceStart;
+};
+
+#endif // REPLAYCAPTURE_H
@@ -0,0 +1,81 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ReplayFormat.h                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef REPLAYFORMAT_H
+#define REPLAYFORMAT_H
+
+// Layout of the frame replay files written by FrameRecorder (ReplayWriter) and
+// played back by the Replay File capture backend (ReplayCapture). Kept free of
+// Qt/OpenCV so other tools can read the files as well.
+//
+// File: ReplayFileHeader, then the frames, then the index (nFrames entries of
+// ReplayIndexEntry at indexOffset). Frames are stored as captured (raw formats
+// uncompressed, MJPEG packets as delivered), rows without padding, each frame
+// starting at a multiple of dataAlignment so it can be used in place from a
+// memory mapping. The index is appended when the file is closed: a file with
+// indexOffset 0 was not closed properly and cannot be played.
+// All fields little-endian.
+
+#include <stdint.h>
+
+#define REPLAY_MAGIC            0x4C505246 // "FRPL"
+#define REPLAY_VERSION          1
+
+struct ReplayFileHeader{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t indexEntrySize;
+    uint32_t dataAlignment;
+    uint64_t nFrames;
+    uint64_t indexOffset;
+    uint8_t reserved[32];
+};
+
+struct ReplayIndexEntry{
+    uint64_t offset;        // Start of the frame data (from the start of the file)
+    uint64_t dataSize;
+    uint64_t sequence;      // Capture sequence number
+    int64_t timestamp;      // Capture time (monotonic clock, microseconds)
+    int32_t pixelFormat;    // PixelFormat (Frame.h)
+    int32_t width;
+    int32_t height;
+    // Layout of the data: rows x cols of OpenCV type cvType
+    int32_t rows;
+    int32_t cols;
+    int32_t cvType;
+};
+
+static_assert(sizeof(ReplayFileHeader)==64, "ReplayFileHeader layout");
+static_assert(sizeof(ReplayIndexEntry)==56, "ReplayIndexEntry layout");
+
+#endif // REPLAYFORMAT_H
@@ -0,0 +1,144 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ReplayWriter.cpp                                                     */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ReplayWriter.h"
+// Qt
+#include <QtCore/QDebug>
+// Local
+#include "Config.h"
+// C
+#include <string.h>
+
+namespace {
+
+qint64 aligned(qint64 offset)
+{
+    return (offset+REPLAY_DATA_ALIGNMENT-1)/REPLAY_DATA_ALIGNMENT*REPLAY_DATA_ALIGNMENT;
+}
+
+}
+
+ReplayWriter::ReplayWriter()
+{
+}
+
+ReplayWriter::~ReplayWriter()
+{
+    close();
+}
+
+bool ReplayWriter::open(const QString &path)
+{
+    close();
+    file.setFileName(path);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    // Header is completed by close() (index offset 0 marks an unfinished file)
+    ReplayFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic=REPLAY_MAGIC;
+    header.version=REPLAY_VERSION;
+    header.headerSize=sizeof(ReplayFileHeader);
+    header.indexEntrySize=sizeof(ReplayIndexEntry);
+    header.dataAlignment=REPLAY_DATA_ALIGNMENT;
+    if(file.write((const char*)&header, sizeof(header))!=sizeof(header))
+    {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool ReplayWriter::write(const Frame &frame)
+{
+    if(!file.isOpen() || frame.empty())
+        return false;
+    ReplayIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset=aligned(file.pos());
+    entry.sequence=frame.sequence;
+    entry.timestamp=frame.timestamp;
+    entry.pixelFormat=frame.pixelFormat;
+    entry.width=frame.width;
+    entry.height=frame.height;
+    entry.rows=frame.data.rows;
+    entry.cols=frame.data.cols;
+    entry.cvType=frame.data.type();
+    // Rows are stored without padding (driver buffers may have some)
+    size_t rowSize=frame.data.cols*frame.data.elemSize();
+    entry.dataSize=rowSize*frame.data.rows;
+    // Gap up to the aligned offset reads back as zeros
+    if(!file.seek(entry.offset))
+        return false;
+    if(frame.data.isContinuous())
+    {
+        if(file.write((const char*)frame.data.data, entry.dataSize)!=(qint64)entry.dataSize)
+            return false;
+    }
+    else
+    {
+        for(int i=0; i<frame.data.rows; i++)
+        {
+            if(file.write((const char*)frame.data.ptr(i), rowSize)!=(qint64)rowSize)
+                return false;
+        }
+    }
+    index.push_back(entry);
+    return true;
+}
+
+void ReplayWriter::close()
+{
+    if(!file.isOpen())
+        return;
+    // Append index, then complete the header
+    ReplayFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic=REPLAY_MAGIC;
+    header.version=REPLAY_VERSION;
+    header.headerSize=sizeof(ReplayFileHeader);
+    header.indexEntrySize=sizeof(ReplayIndexEntry);
+    header.dataAlignment=REPLAY_DATA_ALIGNMENT;
+    header.nFrames=index.size();
+    header.indexOffset=aligned(file.size());
+    qint64 indexSize=index.size()*sizeof(ReplayIndexEntry);
+    if(!file.seek(header.indexOffset) || file.write((const char*)index.data(), indexSize)!=indexSize ||
+       !file.seek(0) || file.write((const char*)&header, sizeof(header))!=sizeof(header))
+        qDebug() << "ERROR: Could not finish replay file" << file.fileName();
+    file.close();
+    index.clear();
+}
+
+bool ReplayWriter::isOpen()
+{
+    return file.isOpen();
+}
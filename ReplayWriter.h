@@ -0,0 +1,63 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ReplayWriter.h                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef REPLAYWRITER_H
+#define REPLAYWRITER_H
+
+// Qt
+#include <QtCore/QFile>
+#include <QtCore/QString>
+// Local
+#include "Frame.h"
+#include "ReplayFormat.h"
+// C++
+#include <vector>
+
+// Writes frames as captured into a frame replay file (ReplayFormat.h). Nothing is
+// encoded: the cost per frame is one copy into the page cache. The index is kept
+// in memory and appended by close().
+class ReplayWriter
+{
+    public:
+        ReplayWriter();
+        ~ReplayWriter();
+        bool open(const QString &path);
+        bool write(const Frame &frame);
+        void close();
+        bool isOpen();
+
+    private:
+        QFile file;
+        std::vector<ReplayIndexEntry> index;
+};
+
+#endif // REPLAYWRITER_H
@@ -0,0 +1,374 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ResultPublisher.cpp                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ResultPublisher.h"
+#include "ResultRecord.h"
+#include "Config.h"
+
+// Qt
+#include <QtCore/QDebug>
+#include <QtCore/QVector>
+// C++
+#include <chrono>
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+// Linux
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+ResultPublisher::ResultPublisher() : QThread()
+{
+    listenFd=-1;
+    wakeFd=-1;
+    nBatchRecords=0;
+    doStop=false;
+    nRecords=0;
+    nDropped=0;
+}
+
+ResultPublisher* ResultPublisher::instance()
+{
+    static ResultPublisher resultPublisher;
+    return &resultPublisher;
+}
+
+bool ResultPublisher::isOpen()
+{
+    return opened.loadAcquire()!=0;
+}
+
+void ResultPublisher::publish(int deviceNumber, quint64 sequence, qint64 captureTimestamp,
+                              const std::vector<int> &ids, const std::vector<std::vector<cv::Point2f>> &corners,
+                              const std::vector<cv::Vec3d> &rvecs, const std::vector<cv::Vec3d> &tvecs,
+                              const std::vector<cv::Rect> &faces, const std::vector<std::vector<cv::Rect>> &faceEyes)
+{
+    if(!isOpen())
+        return;
+    // Count entries (eyes are only stored if there is a list for every face)
+    int nMarkers=qMin((int)qMin(ids.size(), corners.size()), 0xFFFF);
+    int nFaces=qMin((int)faces.size(), 0xFFFF);
+    int nEyes=0;
+    bool eyesValid=(faceEyes.size()==faces.size());
+    if(eyesValid)
+        for(int i=0; i<nFaces; i++)
+            nEyes+=(int)faceEyes[i].size();
+    nEyes=qMin(nEyes, 0xFFFF);
+    bool poseValid=(rvecs.size()>=(size_t)nMarkers && tvecs.size()>=(size_t)nMarkers);
+    int recordSize=sizeof(ResultRecordHeader)+nMarkers*sizeof(ResultMarker)+nFaces*sizeof(ResultRect)+nEyes*sizeof(ResultEye);
+
+    QMutexLocker locker(&batchMutex);
+    // Writer is behind: drop record rather than wait
+    if(batch.size()+recordSize>RESULT_PUBLISHER_MAX_BATCH_BYTES)
+    {
+        nDropped++;
+        return;
+    }
+    // Encode straight into the batch
+    int offset=batch.size();
+    batch.resize(offset+recordSize);
+    // Records are packed back to back, so each entry is built on the stack and copied in
+    // (a record can start at any 4-byte offset: casting into the batch would misalign the 64-bit fields)
+    char *data=batch.data()+offset;
+    struct ResultRecordHeader header;
+    memset(&header, 0, sizeof(ResultRecordHeader));
+    header.magic=RESULT_RECORD_MAGIC;
+    header.version=RESULT_RECORD_VERSION;
+    header.headerSize=sizeof(ResultRecordHeader);
+    header.recordSize=recordSize;
+    header.deviceNumber=deviceNumber;
+    header.sequence=sequence;
+    header.captureTimestamp=captureTimestamp;
+    header.publishTimestamp=std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    header.nMarkers=nMarkers;
+    header.nFaces=nFaces;
+    header.nEyes=nEyes;
+    header.flags=poseValid ? RESULT_RECORD_POSE_VALID : 0;
+    memcpy(data, &header, sizeof(ResultRecordHeader));
+    data+=sizeof(ResultRecordHeader);
+    // Markers
+    for(int i=0; i<nMarkers; i++, data+=sizeof(ResultMarker))
+    {
+        struct ResultMarker marker;
+        memset(&marker, 0, sizeof(ResultMarker));
+        marker.id=ids[i];
+        for(int j=0; j<4 && j<(int)corners[i].size(); j++)
+        {
+            marker.corners[2*j]=corners[i][j].x;
+            marker.corners[2*j+1]=corners[i][j].y;
+        }
+        if(poseValid)
+        {
+            for(int j=0; j<3; j++)
+            {
+                marker.rvec[j]=(float)rvecs[i][j];
+                marker.tvec[j]=(float)tvecs[i][j];
+            }
+        }
+        memcpy(data, &marker, sizeof(ResultMarker));
+    }
+    // Faces
+    for(int i=0; i<nFaces; i++, data+=sizeof(ResultRect))
+    {
+        struct ResultRect rect;
+        rect.x=faces[i].x;
+        rect.y=faces[i].y;
+        rect.width=faces[i].width;
+        rect.height=faces[i].height;
+        memcpy(data, &rect, sizeof(ResultRect));
+    }
+    // Eyes (detected within the face: stored in frame coordinates)
+    int nWritten=0;
+    for(int i=0; eyesValid && i<nFaces; i++)
+    {
+        for(size_t j=0; j<faceEyes[i].size() && nWritten<nEyes; j++, nWritten++, data+=sizeof(ResultEye))
+        {
+            struct ResultEye eye;
+            eye.face=i;
+            eye.reserved=0;
+            eye.rect.x=faces[i].x+faceEyes[i][j].x;
+            eye.rect.y=faces[i].y+faceEyes[i][j].y;
+            eye.rect.width=faceEyes[i][j].width;
+            eye.rect.height=faceEyes[i][j].height;
+            memcpy(data, &eye, sizeof(ResultEye));
+        }
+    }
+    nBatchRecords++;
+    nRecords++;
+    // Full batch: send now rather than at the end of the batch interval
+    if(batch.size()>=RESULT_PUBLISHER_BATCH_BYTES)
+        wakeWriter();
+}
+
+#ifdef Q_OS_LINUX
+
+bool ResultPublisher::open(const QString &socketPath)
+{
+    if(isOpen())
+        return true;
+    // Create listening socket (stale socket file from an earlier run is replaced)
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family=AF_UNIX;
+    QByteArray path=socketPath.toLocal8Bit();
+    if(path.size()>=(int)sizeof(address.sun_path))
+    {
+        qDebug() << "ERROR: Result socket path too long:" << socketPath;
+        return false;
+    }
+    strcpy(address.sun_path, path.constData());
+    unlink(path.constData());
+    listenFd=socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+    if(listenFd==-1 || bind(listenFd, (struct sockaddr*)&address, sizeof(address))==-1 || listen(listenFd, RESULT_PUBLISHER_MAX_CLIENTS)==-1)
+    {
+        qDebug() << "ERROR: Could not open result socket" << socketPath << ":" << strerror(errno);
+        if(listenFd!=-1)
+            ::close(listenFd);
+        listenFd=-1;
+        return false;
+    }
+    // Lets publishers wake the writer when a batch is full
+    wakeFd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    this->socketPath=socketPath;
+    doStop=false;
+    nRecords=0;
+    nDropped=0;
+    start();
+    opened.storeRelease(1);
+    qDebug() << "Publishing detection results on" << socketPath;
+    return true;
+}
+
+void ResultPublisher::close()
+{
+    if(!isOpen())
+        return;
+    opened.storeRelease(0);
+    // Stop writer
+    doStop=true;
+    wakeWriter();
+    wait();
+    // Close sockets
+    for(int i=0; i<clients.size(); i++)
+        ::close(clients[i].fd);
+    clients.clear();
+    ::close(listenFd);
+    listenFd=-1;
+    unlink(socketPath.toLocal8Bit().constData());
+    // Publishers that saw the publisher open may still be adding a record
+    batchMutex.lock();
+    ::close(wakeFd);
+    wakeFd=-1;
+    batch.clear();
+    nBatchRecords=0;
+    batchMutex.unlock();
+    qDebug() << "Stopped publishing detection results:" << nRecords << "records published," << nDropped << "dropped.";
+}
+
+void ResultPublisher::wakeWriter()
+{
+    uint64_t one=1;
+    if(wakeFd!=-1 && write(wakeFd, &one, sizeof(one))<0)
+    {
+        // Counter already non-zero: writer is being woken anyway
+    }
+}
+
+void ResultPublisher::run()
+{
+    QByteArray sending;
+    QVector<struct pollfd> pfds;
+    while(!doStop)
+    {
+        // Wait for a full batch, a new client or a client ready for more (timeout: send partial batch)
+        pfds.resize(2+clients.size());
+        pfds[0].fd=listenFd;
+        pfds[0].events=POLLIN;
+        pfds[1].fd=wakeFd;
+        pfds[1].events=POLLIN;
+        for(int i=0; i<clients.size(); i++)
+        {
+            pfds[2+i].fd=clients[i].fd;
+            pfds[2+i].events=clients[i].offset<clients[i].backlog.size() ? POLLOUT : 0;
+        }
+        if(poll(pfds.data(), pfds.size(), RESULT_PUBLISHER_BATCH_INTERVAL_MS)<0 && errno!=EINTR)
+            break;
+        // Reset wakeup counter
+        if(pfds[1].revents&POLLIN)
+        {
+            uint64_t count;
+            if(read(wakeFd, &count, sizeof(count))<0)
+            {
+                // Nothing to reset
+            }
+        }
+        // Accept new clients
+        int fd;
+        while((fd=accept4(listenFd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC))!=-1)
+        {
+            if(clients.size()>=RESULT_PUBLISHER_MAX_CLIENTS)
+            {
+                ::close(fd);
+                continue;
+            }
+            Client client;
+            client.fd=fd;
+            client.offset=0;
+            clients.append(client);
+        }
+
+        // Take the batch (publishers start a new one)
+        batchMutex.lock();
+        sending.swap(batch);
+        int nSending=nBatchRecords;
+        nBatchRecords=0;
+        batchMutex.unlock();
+
+        for(int i=clients.size()-1; i>=0; i--)
+        {
+            Client &client=clients[i];
+            if(!sending.isEmpty())
+            {
+                // Client not keeping up: drop the whole batch for this client
+                if(client.backlog.size()-client.offset+sending.size()>RESULT_PUBLISHER_MAX_CLIENT_BACKLOG)
+                {
+                    batchMutex.lock();
+                    nDropped+=nSending;
+                    batchMutex.unlock();
+                }
+                else
+                {
+                    // Discard the part already sent
+                    client.backlog.remove(0, client.offset);
+                    client.offset=0;
+                    client.backlog.append(sending);
+                }
+            }
+            // Client gone
+            if(!flush(client))
+            {
+                ::close(client.fd);
+                clients.removeAt(i);
+            }
+        }
+        // Reuse the allocation for the next batch
+        sending.resize(0);
+    }
+}
+
+bool ResultPublisher::flush(Client &client)
+{
+    // Send as much as the socket takes without blocking
+    while(client.offset<client.backlog.size())
+    {
+        ssize_t n=send(client.fd, client.backlog.constData()+client.offset, client.backlog.size()-client.offset, MSG_DONTWAIT|MSG_NOSIGNAL);
+        if(n<0)
+            return errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR;
+        client.offset+=n;
+    }
+    client.backlog.resize(0);
+    client.offset=0;
+    return true;
+}
+
+#else
+
+bool ResultPublisher::open(const QString &socketPath)
+{
+    qDebug() << "ERROR: Publishing results on" << socketPath << "requires Unix domain sockets (Linux only).";
+    return false;
+}
+
+void ResultPublisher::close()
+{
+}
+
+void ResultPublisher::wakeWriter()
+{
+}
+
+void ResultPublisher::run()
+{
+}
+
+bool ResultPublisher::flush(Client &client)
+{
+    Q_UNUSED(client);
+    return false;
+}
+
+#endif
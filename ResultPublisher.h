@@ -0,0 +1,93 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ResultPublisher.h                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef RESULTPUBLISHER_H
+#define RESULTPUBLISHER_H
+
+// Qt
+#include <QtCore/QAtomicInt>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+// OpenCV
+#include <opencv2/core.hpp>
+// C++
+#include <vector>
+
+// Streams the detections of every processed frame to local consumers over a
+// Unix domain socket (record layout in ResultRecord.h). Processing threads only
+// append the encoded record to a batch; a writer thread sends the batches to all
+// connected clients. Neither side blocks: records are dropped when the batch is
+// full, and a client that does not keep up loses whole batches (the stream stays
+// aligned on record boundaries).
+class ResultPublisher : public QThread
+{
+    public:
+        static ResultPublisher* instance();
+        bool open(const QString &socketPath);
+        void close();
+        bool isOpen();
+        void publish(int deviceNumber, quint64 sequence, qint64 captureTimestamp,
+                     const std::vector<int> &ids, const std::vector<std::vector<cv::Point2f>> &corners,
+                     const std::vector<cv::Vec3d> &rvecs, const std::vector<cv::Vec3d> &tvecs,
+                     const std::vector<cv::Rect> &faces, const std::vector<std::vector<cv::Rect>> &faceEyes);
+
+    protected:
+        void run();
+
+    private:
+        ResultPublisher();
+        void wakeWriter();
+        struct Client
+        {
+            int fd;
+            QByteArray backlog;
+            int offset;
+        };
+        bool flush(Client &client);
+        QList<Client> clients;
+        QString socketPath;
+        int listenFd;
+        int wakeFd;
+        // Records waiting for the writer
+        QMutex batchMutex;
+        QByteArray batch;
+        int nBatchRecords;
+        QAtomicInt opened;
+        volatile bool doStop;
+        quint64 nRecords;
+        quint64 nDropped;
+};
+
+#endif // RESULTPUBLISHER_H
@@ -0,0 +1,103 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ResultRecord.h                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef RESULTRECORD_H
+#define RESULTRECORD_H
+
+// Binary layout of the detection results streamed by ResultPublisher. Kept free
+// of Qt/OpenCV so consumers can include it as is.
+//
+// The stream is a sequence of records (native byte order, no padding between
+// fields). Each record is:
+//   ResultRecordHeader
+//   nMarkers x ResultMarker
+//   nFaces   x ResultRect
+//   nEyes    x ResultEye
+// recordSize covers all of it, so readers can skip records (or trailing fields
+// added by later versions) without understanding them. Records are not padded:
+// a record (and its entries) can start at any 4-byte offset, so readers should
+// memcpy each struct out of the stream rather than cast a pointer into it.
+
+#include <stdint.h>
+
+#define RESULT_RECORD_MAGIC     0x53455241 // "ARES"
+#define RESULT_RECORD_VERSION   1
+
+// Flags
+#define RESULT_RECORD_POSE_VALID    0x0001 // Marker rvec/tvec were estimated (camera calibration loaded)
+
+struct ResultRecordHeader{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t recordSize;
+    int32_t deviceNumber;
+    uint64_t sequence;
+    // Monotonic clock, microseconds
+    int64_t captureTimestamp;
+    int64_t publishTimestamp;
+    uint16_t nMarkers;
+    uint16_t nFaces;
+    uint16_t nEyes;
+    uint16_t flags;
+};
+
+struct ResultMarker{
+    int32_t id;
+    // Corners (x,y) in frame (ROI) coordinates, clockwise from top left
+    float corners[8];
+    // Pose of the marker in the camera frame (Rodrigues vector, metres)
+    float rvec[3];
+    float tvec[3];
+};
+
+// Rectangle in frame (ROI) coordinates
+struct ResultRect{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+struct ResultEye{
+    // Index of the face the eye belongs to
+    uint16_t face;
+    uint16_t reserved;
+    struct ResultRect rect;
+};
+
+static_assert(sizeof(ResultRecordHeader)==48, "ResultRecordHeader layout");
+static_assert(sizeof(ResultMarker)==60, "ResultMarker layout");
+static_assert(sizeof(ResultRect)==16, "ResultRect layout");
+static_assert(sizeof(ResultEye)==20, "ResultEye layout");
+
+#endif // RESULTRECORD_H
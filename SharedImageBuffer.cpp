@@ -39,7 +39,7 @@ SharedImageBuffer::SharedImageBuffer()
     doSync=false;
 }
 
-void SharedImageBuffer::add(int deviceNumber, Buffer<Mat>* imageBuffer, bool sync)
+void SharedImageBuffer::add(int deviceNumber, Buffer<Frame>* imageBuffer, bool sync, bool timestampSync)
 {
     // Device stream is to be synchronized
     if(sync)
@@ -48,11 +48,14 @@ void SharedImageBuffer::add(int deviceNumber, Buffer<Mat>* imageBuffer, bool syn
         syncSet.insert(deviceNumber);
         mutex.unlock();
     }
+    // Device frames are to be grouped with other streams by capture time
+    if(timestampSync)
+        frameSynchronizer.addDevice(deviceNumber);
     // Add image buffer to map
     imageBufferMap[deviceNumber]=imageBuffer;
 }
 
-Buffer<Mat>* SharedImageBuffer::getByDeviceNumber(int deviceNumber)
+Buffer<Frame>* SharedImageBuffer::getByDeviceNumber(int deviceNumber)
 {
     return imageBufferMap[deviceNumber];
 }
@@ -61,6 +64,10 @@ void SharedImageBuffer::removeByDeviceNumber(int deviceNumber)
 {
     // Remove buffer for device from imageBufferMap
     imageBufferMap.remove(deviceNumber);
+    // Remove from timestamp synchronization
+    frameSynchronizer.removeDevice(deviceNumber);
+    // Stop exporting frames to shared memory
+    frameExporter.removeDevice(deviceNumber);
 
     // Also remove from syncSet (if present)
     mutex.lock();
@@ -78,6 +85,7 @@ void SharedImageBuffer::sync(int deviceNumber)
     mutex.lock();
     if(syncSet.contains(deviceNumber))
     {
+        TraceScope trace("sync", "sync barrier", deviceNumber);
         // Increment arrived count
         nArrived++;
         // We are the last to arrive: wake all waiting threads
@@ -117,3 +125,13 @@ bool SharedImageBuffer::containsImageBufferForDeviceNumber(int deviceNumber)
 {
     return imageBufferMap.contains(deviceNumber);
 }
+
+FrameSynchronizer* SharedImageBuffer::getFrameSynchronizer()
+{
+    return &frameSynchronizer;
+}
+
+FrameExporter* SharedImageBuffer::getFrameExporter()
+{
+    return &frameExporter;
+}
@@ -43,6 +43,10 @@
 #include <opencv2/highgui.hpp>
 // Local
 #include <Buffer.h>
+#include "Frame.h"
+#include "FrameSynchronizer.h"
+#include "FrameExporter.h"
+#include "TraceRecorder.h"
 
 using namespace cv;
 
@@ -50,8 +54,8 @@ class SharedImageBuffer
 {
     public:
         SharedImageBuffer();
-        void add(int deviceNumber, Buffer<Mat> *imageBuffer, bool sync=false);
-        Buffer<Mat>* getByDeviceNumber(int deviceNumber);
+        void add(int deviceNumber, Buffer<Frame> *imageBuffer, bool sync=false, bool timestampSync=false);
+        Buffer<Frame>* getByDeviceNumber(int deviceNumber);
         void removeByDeviceNumber(int deviceNumber);
         void sync(int deviceNumber);
         void wakeAll();
@@ -59,10 +63,14 @@ class SharedImageBuffer
         bool isSyncEnabledForDeviceNumber(int deviceNumber);
         bool getSyncEnabled();
         bool containsImageBufferForDeviceNumber(int deviceNumber);
+        FrameSynchronizer* getFrameSynchronizer();
+        FrameExporter* getFrameExporter();
 
     private:
-        QHash<int, Buffer<Mat>*> imageBufferMap;
+        QHash<int, Buffer<Frame>*> imageBufferMap;
         QSet<int> syncSet;
+        FrameSynchronizer frameSynchronizer;
+        FrameExporter frameExporter;
         QWaitCondition wc;
         QMutex mutex;
         int nArrived;
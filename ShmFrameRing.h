@@ -0,0 +1,95 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ShmFrameRing.h                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef SHMFRAMERING_H
+#define SHMFRAMERING_H
+
+// Layout of the POSIX shared-memory frame rings written by FrameExporter. Kept
+// free of Qt/OpenCV so readers (tools/shm_reader) can include it as is.
+//
+// Shared memory object: ShmRingHeader followed by nSlots slots of slotStride
+// bytes. Each slot is a ShmSlotHeader followed by the frame data. Frame n goes
+// to slot n % nSlots.
+//
+// Every slot is protected by a sequence lock: the writer makes seq odd before
+// writing the slot and even again once done. A reader takes seq (acquire),
+// uses the slot (in place, no copy needed) and then checks seq is unchanged:
+// otherwise the slot was overwritten while being read and must be discarded.
+// The writer never waits for readers.
+//
+// A ring is replaced (new object under the same name) when frames no longer fit
+// its slots. The old ring is marked closed first: readers then reopen the name.
+
+#include <atomic>
+#include <stdint.h>
+
+#define SHM_RING_MAGIC      0x474E5246 // "FRNG"
+#define SHM_RING_VERSION    1
+
+// Ring state
+#define SHM_RING_LIVE       1
+#define SHM_RING_CLOSED     2
+
+struct ShmRingHeader{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t nSlots;
+    uint32_t slotStride;    // Bytes per slot (slot header included)
+    uint32_t slotHeaderSize;
+    std::atomic<uint32_t> state;
+    // Number of frames written (frame n is in slot n % nSlots once writeIndex>n)
+    std::atomic<uint64_t> writeIndex;
+};
+
+struct ShmSlotHeader{
+    std::atomic<uint64_t> seq;
+    // Frame number in this ring (detects slots lapped by the writer)
+    uint64_t index;
+    uint64_t sequence;      // Capture sequence number
+    int64_t timestamp;      // Capture time (monotonic clock, microseconds)
+    int32_t pixelFormat;    // PixelFormat (Frame.h)
+    int32_t width;
+    int32_t height;
+    // Layout of the data: rows x cols of OpenCV type cvType, rows stored without padding
+    int32_t rows;
+    int32_t cols;
+    int32_t cvType;
+    uint32_t dataSize;
+    uint32_t reserved;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE==2 && ATOMIC_INT_LOCK_FREE==2, "Shared-memory ring needs lock-free atomics");
+static_assert(sizeof(ShmRingHeader)==32, "ShmRingHeader layout");
+static_assert(sizeof(ShmSlotHeader)==64, "ShmSlotHeader layout");
+
+#endif // SHMFRAMERING_H
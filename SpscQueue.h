@@ -0,0 +1,102 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* SpscQueue.h                                                          */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+// C++
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue. Neither side ever blocks or
+// takes a lock: tryPush() fails when the queue is full, tryPop() when it is
+// empty. One thread may push and one (other) thread may pop at a time.
+template<class T> class SpscQueue
+{
+    public:
+        SpscQueue(int size);
+        bool tryPush(const T& data);
+        bool tryPop(T& data);
+        int size();
+        int maxSize();
+
+    private:
+        std::vector<T> slots;
+        // Next slot to pop (written by consumer) and to push (written by producer)
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+};
+
+template<class T> SpscQueue<T>::SpscQueue(int size) : slots(size+1), head(0), tail(0)
+{
+    // One slot stays empty to tell a full queue from an empty one
+}
+
+template<class T> bool SpscQueue<T>::tryPush(const T& data)
+{
+    size_t t=tail.load(std::memory_order_relaxed);
+    size_t next=(t+1)%slots.size();
+    // Full
+    if(next==head.load(std::memory_order_acquire))
+        return false;
+    slots[t]=data;
+    tail.store(next, std::memory_order_release);
+    return true;
+}
+
+template<class T> bool SpscQueue<T>::tryPop(T& data)
+{
+    size_t h=head.load(std::memory_order_relaxed);
+    // Empty
+    if(h==tail.load(std::memory_order_acquire))
+        return false;
+    data=slots[h];
+    // Release the item held by the slot (frames keep their buffers alive)
+    slots[h]=T();
+    head.store((h+1)%slots.size(), std::memory_order_release);
+    return true;
+}
+
+template<class T> int SpscQueue<T>::size()
+{
+    size_t h=head.load(std::memory_order_acquire);
+    size_t t=tail.load(std::memory_order_acquire);
+    return (int)((t+slots.size()-h)%slots.size());
+}
+
+template<class T> int SpscQueue<T>::maxSize()
+{
+    return (int)slots.size()-1;
+}
+
+#endif // SPSCQUEUE_H
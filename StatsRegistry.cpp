@@ -0,0 +1,146 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* StatsRegistry.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "StatsRegistry.h"
+
+namespace {
+
+enum MetricType{
+    COUNTER,
+    GAUGE
+};
+
+struct MetricInfo{
+    const char *name;
+    const char *help;
+    int type;
+    int component;
+    // Exported value is the stored value times this (e.g. nanoseconds to seconds)
+    double scale;
+};
+
+// By StatsMetric
+const MetricInfo metrics[STATS_METRICS]={
+    {"qtcv_capture_frames_total", "Frames captured.", COUNTER, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_capture_fps", "Capture rate (frames per second, exponentially weighted).", GAUGE, STATS_COMPONENT_CAPTURE, 1e-3},
+    {"qtcv_capture_interval_jitter_seconds", "Standard deviation of the interval between captured frames.", GAUGE, STATS_COMPONENT_CAPTURE, 1e-9},
+    {"qtcv_capture_health", "Camera health (0: connected, 1: stalled, 2: reconnecting, 3: failed).", GAUGE, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_capture_reconnects_total", "Times the camera was reconnected.", COUNTER, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_buffer_depth", "Frames waiting in the image buffer.", GAUGE, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_buffer_capacity", "Size of the image buffer.", GAUGE, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_buffer_dropped_total", "Frames dropped because the image buffer was full.", COUNTER, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_buffer_high_water_mark", "Most frames ever held by the image buffer.", GAUGE, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_buffer_producer_wait_seconds_total", "Time capture was blocked on a full image buffer.", COUNTER, STATS_COMPONENT_CAPTURE, 1e-9},
+    {"qtcv_buffer_consumer_wait_seconds_total", "Time processing waited on an empty image buffer.", COUNTER, STATS_COMPONENT_CAPTURE, 1e-9},
+    {"qtcv_decoder_dropped_total", "Compressed frames dropped because every MJPEG decoder was busy.", COUNTER, STATS_COMPONENT_CAPTURE, 1},
+    {"qtcv_processing_frames_total", "Frames processed.", COUNTER, STATS_COMPONENT_PROCESSING, 1},
+    {"qtcv_processing_fps", "Processing rate (frames per second, exponentially weighted).", GAUGE, STATS_COMPONENT_PROCESSING, 1e-3},
+    {"qtcv_processing_interval_jitter_seconds", "Standard deviation of the interval between processed frames.", GAUGE, STATS_COMPONENT_PROCESSING, 1e-9},
+    {"qtcv_processing_preprocess_seconds_total", "Time spent in the preprocessing stage (filters).", COUNTER, STATS_COMPONENT_PROCESSING, 1e-9},
+    {"qtcv_processing_detect_seconds_total", "Time spent in the detection stage (markers, faces, eyes).", COUNTER, STATS_COMPONENT_PROCESSING, 1e-9},
+    {"qtcv_processing_finish_seconds_total", "Time spent in the finishing stage (poses, drawing, conversion).", COUNTER, STATS_COMPONENT_PROCESSING, 1e-9},
+    {"qtcv_processing_latency_seconds_total", "Sum over processed frames of the time from capture to results.", COUNTER, STATS_COMPONENT_PROCESSING, 1e-9},
+    {"qtcv_markers_detected_total", "Markers detected (sum over processed frames).", COUNTER, STATS_COMPONENT_PROCESSING, 1},
+    {"qtcv_faces_detected_total", "Faces detected (sum over processed frames).", COUNTER, STATS_COMPONENT_PROCESSING, 1},
+    {"qtcv_eyes_detected_total", "Eyes detected (sum over processed frames).", COUNTER, STATS_COMPONENT_PROCESSING, 1}
+};
+
+}
+
+StatsBlock::StatsBlock(int deviceNumber, int component)
+{
+    this->deviceNumber=deviceNumber;
+    this->component=component;
+    for(int i=0; i<STATS_METRICS; i++)
+        values[i].store(0);
+    StatsRegistry::instance()->add(this);
+}
+
+StatsBlock::~StatsBlock()
+{
+    StatsRegistry::instance()->remove(this);
+}
+
+int StatsBlock::getDeviceNumber()
+{
+    return deviceNumber;
+}
+
+int StatsBlock::getComponent()
+{
+    return component;
+}
+
+StatsRegistry::StatsRegistry()
+{
+}
+
+StatsRegistry* StatsRegistry::instance()
+{
+    static StatsRegistry statsRegistry;
+    return &statsRegistry;
+}
+
+void StatsRegistry::add(StatsBlock *block)
+{
+    QMutexLocker locker(&mutex);
+    blocks.append(block);
+}
+
+void StatsRegistry::remove(StatsBlock *block)
+{
+    // Waits for a scrape in progress (block must not be read once gone)
+    QMutexLocker locker(&mutex);
+    blocks.removeAll(block);
+}
+
+QByteArray StatsRegistry::scrape()
+{
+    QByteArray text;
+    QMutexLocker locker(&mutex);
+    for(int i=0; i<STATS_METRICS; i++)
+    {
+        const MetricInfo &metric=metrics[i];
+        text+=QByteArray("# HELP ")+metric.name+" "+metric.help+"\n";
+        text+=QByteArray("# TYPE ")+metric.name+(metric.type==COUNTER ? " counter\n" : " gauge\n");
+        // One sample per camera
+        for(int j=0; j<blocks.size(); j++)
+        {
+            if(blocks[j]->getComponent()!=metric.component)
+                continue;
+            qint64 value=blocks[j]->get(i);
+            text+=QByteArray(metric.name)+"{device=\""+QByteArray::number(blocks[j]->getDeviceNumber())+"\"} "+
+                  (metric.scale==1 ? QByteArray::number(value) : QByteArray::number(value*metric.scale, 'f', 9))+"\n";
+        }
+    }
+    return text;
+}
@@ -0,0 +1,139 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* StatsRegistry.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef STATSREGISTRY_H
+#define STATSREGISTRY_H
+
+// Qt
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+
+enum StatsMetric{
+    // Capture thread
+    STATS_CAPTURE_FRAMES=0,
+    STATS_CAPTURE_FPS,
+    STATS_CAPTURE_JITTER_NS,
+    STATS_CAPTURE_HEALTH,
+    STATS_CAPTURE_RECONNECTS,
+    STATS_BUFFER_DEPTH,
+    STATS_BUFFER_CAPACITY,
+    STATS_BUFFER_DROPPED,
+    STATS_BUFFER_HIGH_WATER_MARK,
+    STATS_BUFFER_PRODUCER_WAIT_NS,
+    STATS_BUFFER_CONSUMER_WAIT_NS,
+    STATS_DECODER_DROPPED,
+    // Processing thread
+    STATS_PROCESSING_FRAMES,
+    STATS_PROCESSING_FPS,
+    STATS_PROCESSING_JITTER_NS,
+    STATS_PREPROCESS_NS,
+    STATS_DETECT_NS,
+    STATS_FINISH_NS,
+    STATS_LATENCY_NS,
+    STATS_MARKERS,
+    STATS_FACES,
+    STATS_EYES,
+    STATS_METRICS
+};
+
+enum StatsComponent{
+    STATS_COMPONENT_CAPTURE=0,
+    STATS_COMPONENT_PROCESSING=1
+};
+
+// Metrics of one thread of one camera (registered for its whole lifetime).
+// Updated without locks (relaxed atomics, each block has its own); the
+// registry only reads them when scraped.
+class StatsBlock
+{
+    public:
+        StatsBlock(int deviceNumber, int component);
+        ~StatsBlock();
+        void add(int metric, qint64 n=1)
+        {
+            values[metric].fetchAndAddRelaxed(n);
+        }
+        void set(int metric, qint64 value)
+        {
+            values[metric].store(value);
+        }
+        qint64 get(int metric)
+        {
+            return values[metric].load();
+        }
+        int getDeviceNumber();
+        int getComponent();
+
+    private:
+        int deviceNumber;
+        int component;
+        QAtomicInteger<qint64> values[STATS_METRICS];
+};
+
+// Adds the time from construction to destruction (nanoseconds) to a metric
+class StatsTimer
+{
+    public:
+        StatsTimer(StatsBlock &block, int metric) : block(block), metric(metric)
+        {
+            timer.start();
+        }
+        ~StatsTimer()
+        {
+            block.add(metric, timer.nsecsElapsed());
+        }
+
+    private:
+        StatsBlock &block;
+        int metric;
+        QElapsedTimer timer;
+};
+
+// All blocks of all cameras, rendered in Prometheus text format on a scrape.
+class StatsRegistry
+{
+    public:
+        static StatsRegistry* instance();
+        void add(StatsBlock *block);
+        void remove(StatsBlock *block);
+        QByteArray scrape();
+
+    private:
+        StatsRegistry();
+        QMutex mutex;
+        QList<StatsBlock*> blocks;
+};
+
+#endif // STATSREGISTRY_H
@@ -0,0 +1,234 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* StatsServer.cpp                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "StatsServer.h"
+#include "StatsRegistry.h"
+#include "Config.h"
+
+// Qt
+#include <QtCore/QDebug>
+#include <QtCore/QElapsedTimer>
+// C++
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+// Linux
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+StatsServer::StatsServer() : QThread()
+{
+    listenFd=-1;
+    wakeFd=-1;
+    doStop=false;
+    nScrapes=0;
+}
+
+StatsServer* StatsServer::instance()
+{
+    static StatsServer statsServer;
+    return &statsServer;
+}
+
+bool StatsServer::isOpen()
+{
+    return opened.loadAcquire()!=0;
+}
+
+#ifdef Q_OS_LINUX
+
+bool StatsServer::open(const QString &address, int port)
+{
+    if(isOpen())
+        return true;
+    // Create listening socket
+    struct sockaddr_in socketAddress;
+    memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family=AF_INET;
+    socketAddress.sin_port=htons(port);
+    if(inet_pton(AF_INET, address.toLatin1().constData(), &socketAddress.sin_addr)!=1)
+    {
+        qDebug() << "ERROR: Invalid statistics server address:" << address;
+        return false;
+    }
+    listenFd=socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+    int reuse=1;
+    if(listenFd!=-1)
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if(listenFd==-1 || bind(listenFd, (struct sockaddr*)&socketAddress, sizeof(socketAddress))==-1 || listen(listenFd, 8)==-1)
+    {
+        qDebug() << "ERROR: Could not serve statistics on" << address << "port" << port << ":" << strerror(errno);
+        if(listenFd!=-1)
+            ::close(listenFd);
+        listenFd=-1;
+        return false;
+    }
+    // Lets close() wake the server
+    wakeFd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    doStop=false;
+    nScrapes=0;
+    start(QThread::LowPriority);
+    opened.storeRelease(1);
+    qDebug() << "Serving statistics on" << QString("http://%1:%2/metrics").arg(address).arg(port);
+    return true;
+}
+
+void StatsServer::close()
+{
+    if(!isOpen())
+        return;
+    opened.storeRelease(0);
+    // Stop server
+    doStop=true;
+    uint64_t one=1;
+    if(write(wakeFd, &one, sizeof(one))<0)
+    {
+        // Counter already non-zero: server is being woken anyway
+    }
+    wait();
+    ::close(listenFd);
+    listenFd=-1;
+    ::close(wakeFd);
+    wakeFd=-1;
+    qDebug() << "Stopped serving statistics:" << nScrapes << "scrapes.";
+}
+
+void StatsServer::run()
+{
+    struct pollfd pfds[2];
+    while(!doStop)
+    {
+        // Wait for a client (or close())
+        pfds[0].fd=listenFd;
+        pfds[0].events=POLLIN;
+        pfds[1].fd=wakeFd;
+        pfds[1].events=POLLIN;
+        if(poll(pfds, 2, -1)<0 && errno!=EINTR)
+            break;
+        int fd;
+        while(!doStop && (fd=accept4(listenFd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC))!=-1)
+        {
+            serveClient(fd);
+            ::close(fd);
+        }
+    }
+}
+
+void StatsServer::serveClient(int fd)
+{
+    // Read request head (client gets STATS_SERVER_REQUEST_TIMEOUT_MS, the body of a GET is ignored)
+    QByteArray request;
+    char data[1024];
+    QElapsedTimer timer;
+    timer.start();
+    while(!request.contains("\r\n\r\n") && request.size()<STATS_SERVER_MAX_REQUEST_BYTES)
+    {
+        int remaining=STATS_SERVER_REQUEST_TIMEOUT_MS-(int)timer.elapsed();
+        struct pollfd pfd;
+        pfd.fd=fd;
+        pfd.events=POLLIN;
+        if(remaining<=0 || poll(&pfd, 1, remaining)<=0)
+            return;
+        ssize_t n=recv(fd, data, sizeof(data), 0);
+        if(n<=0)
+        {
+            if(n<0 && (errno==EAGAIN || errno==EINTR))
+                continue;
+            return;
+        }
+        request.append(data, n);
+    }
+    // Only the metrics are served
+    QByteArray status;
+    QByteArray body;
+    QList<QByteArray> requestLine=request.left(request.indexOf("\r\n")).split(' ');
+    if(requestLine.size()<2 || (requestLine[0]!="GET" && requestLine[0]!="HEAD"))
+        status="405 Method Not Allowed";
+    else if(requestLine[1]!="/metrics" && !requestLine[1].startsWith("/metrics?"))
+        status="404 Not Found";
+    else
+    {
+        status="200 OK";
+        body=StatsRegistry::instance()->scrape();
+        nScrapes++;
+    }
+    QByteArray response="HTTP/1.0 "+status+"\r\n"
+                        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: "+QByteArray::number(body.size())+"\r\n"
+                        "Connection: close\r\n\r\n";
+    if(requestLine.size()>0 && requestLine[0]!="HEAD")
+        response+=body;
+    // Send response (a client that stops reading is given up on after the timeout)
+    int offset=0;
+    while(offset<response.size())
+    {
+        ssize_t n=send(fd, response.constData()+offset, response.size()-offset, MSG_NOSIGNAL);
+        if(n<0)
+        {
+            struct pollfd pfd;
+            pfd.fd=fd;
+            pfd.events=POLLOUT;
+            if((errno!=EAGAIN && errno!=EINTR) || poll(&pfd, 1, STATS_SERVER_REQUEST_TIMEOUT_MS)<=0)
+                return;
+            continue;
+        }
+        offset+=n;
+    }
+}
+
+#else
+
+bool StatsServer::open(const QString &address, int port)
+{
+    qDebug() << "ERROR: Serving statistics on" << address << "port" << port << "is only supported on Linux.";
+    return false;
+}
+
+void StatsServer::close()
+{
+}
+
+void StatsServer::run()
+{
+}
+
+void StatsServer::serveClient(int)
+{
+}
+
+#endif
@@ -35,6 +35,8 @@
 
 // Qt
 #include <QtCore/QRect>
+#include <QtCore/QString>
+#include <QtCore/QVector>
 
 struct ImageProcessingSettings{
     int smoothType;
@@ -49,6 +51,8 @@ struct ImageProcessingSettings{
     double cannyThreshold2;
     int cannyApertureSize;
     bool cannyL2gradient;
+    // Frame rate the detection governor keeps processing at
+    int governorTargetFPS;
 };
 
 struct ImageProcessingFlags{
@@ -62,6 +66,9 @@ struct ImageProcessingFlags{
     bool ArucoOn;
     bool faceDetectionOn;
     bool eyeDetectionOn;
+    bool parallelOn;
+    bool pipelineOn;
+    bool governorOn;
 };
 
 struct MouseData{
@@ -70,9 +77,208 @@ struct MouseData{
     bool rightButtonRelease;
 };
 
+enum CaptureBackend{
+    CAPTURE_BACKEND_OPENCV=0,
+    CAPTURE_BACKEND_V4L2=1,
+    CAPTURE_BACKEND_REPLAY=2
+};
+
+enum ThreadingMode{
+    THREADING_DEDICATED=0,
+    THREADING_SHARED=1
+};
+
+enum CaptureHealth{
+    CAPTURE_HEALTH_CONNECTED=0,
+    CAPTURE_HEALTH_STALLED=1,
+    CAPTURE_HEALTH_RECONNECTING=2,
+    CAPTURE_HEALTH_FAILED=3
+};
+
+enum MjpegDecodeMode{
+    MJPEG_DECODE_DEFERRED=0,
+    MJPEG_DECODE_POOL_COLOUR=1,
+    MJPEG_DECODE_POOL_GREY=2
+};
+
+struct MjpegDecoding{
+    int mode;
+    int scaleDenom;
+};
+
+enum FrameExportStage{
+    FRAME_EXPORT_RAW=0,
+    FRAME_EXPORT_PROCESSED=1
+};
+
+enum RecorderStream{
+    RECORDER_STREAM_RAW=0,
+    RECORDER_STREAM_ANNOTATED=1,
+    // Raw frames kept (compressed) in the pre-event ring, written out around triggers
+    RECORDER_STREAM_EVENTS=2,
+    // Raw frames as captured (uncompressed) in a replay file
+    RECORDER_STREAM_REPLAY=3,
+    RECORDER_STREAMS=4
+};
+
+enum RecorderDropPolicy{
+    RECORDER_DROP_NEWEST=0,
+    RECORDER_DROP_DECIMATE=1
+};
+
+struct BufferStatistics{
+    int size;
+    int maxSize;
+    // Most items ever held at once
+    int highWaterMark;
+    quint64 nAdded;
+    // Items not added because the buffer was full (add() with dropIfFull)
+    quint64 nDropped;
+    // Times (and total nanoseconds) producers waited on a full buffer / consumers on an empty one
+    quint64 nProducerWaits;
+    qint64 producerWaitNs;
+    quint64 nConsumerWaits;
+    qint64 consumerWaitNs;
+    // Time since the buffer was created
+    qint64 elapsedNs;
+};
+
+struct RecorderStatistics{
+    // By RecorderStream
+    quint64 nRecorded[RECORDER_STREAMS];
+    quint64 nDropped[RECORDER_STREAMS];
+    int nQueued[RECORDER_STREAMS];
+    // Event clips written, size of the pre-event ring
+    quint64 nClips;
+    qint64 eventBufferBytes;
+};
+
+enum RecorderTriggerReason{
+    RECORDER_TRIGGER_MARKER_APPEARED=0,
+    RECORDER_TRIGGER_MARKER_DISAPPEARED=1,
+    RECORDER_TRIGGER_FACE_COUNT_CHANGED=2
+};
+
+struct RecorderTrigger{
+    int reason;
+    // Marker id or new face count
+    int detail;
+    // Capture time of the frame the change was seen in
+    qint64 timestamp;
+};
+
+enum PoolPriority{
+    POOL_PRIORITY_LOW=0,
+    POOL_PRIORITY_NORMAL=1,
+    POOL_PRIORITY_HIGH=2
+};
+
+struct PoolScheduling{
+    int targetFps; // 0: as fast as possible
+    int priority;
+};
+
+struct PoolSchedulingStatistics{
+    int targetFps;
+    int weight;
+    double averageCostMs;
+    quint64 nSkipped;
+};
+
+enum SchedulingPolicy{
+    SCHED_POLICY_DEFAULT=0,
+    SCHED_POLICY_FIFO=1,
+    SCHED_POLICY_RR=2
+};
+
+struct ThreadPlacement{
+    QString cpuList;
+    int schedPolicy;
+    int rtPriority;
+};
+
+enum HugePageMode{
+    HUGE_PAGES_OFF=0,
+    // Transparent huge pages (2 MB aligned regions, madvise)
+    HUGE_PAGES_TRANSPARENT=1,
+    // Explicit huge pages (MAP_HUGETLB, reserved in /proc/sys/vm/nr_hugepages), transparent if none are left
+    HUGE_PAGES_EXPLICIT=2
+};
+
+struct HugePageStatistics{
+    // Regions mapped with explicit/transparent huge pages, reused from the cache, and frame buffers left to the default allocator
+    quint64 nExplicit;
+    quint64 nTransparent;
+    quint64 nReused;
+    quint64 nFallbacks;
+    // Bytes currently mapped (in use or cached)
+    quint64 bytesMapped;
+};
+
+// Scratch images kept by a FrameArena
+enum FrameArenaImage{
+    // Captured frame converted for processing (full size)
+    FRAME_ARENA_SOURCE=0,
+    // Filtered frame (ROI size): filters write into the buffer the frame is not in
+    FRAME_ARENA_FRAME_A=1,
+    FRAME_ARENA_FRAME_B=2,
+    // Grey image for detection, equalized copy for face detection
+    FRAME_ARENA_LUMA=3,
+    FRAME_ARENA_EQUALIZED=4,
+    FRAME_ARENA_IMAGES=5
+};
+
+// Allocations counted by AllocationTracker (heap: operator new/malloc, Mat: Mat data)
+struct AllocationCounts{
+    quint64 nHeap;
+    quint64 heapBytes;
+    quint64 nMat;
+    quint64 matBytes;
+};
+
 struct ThreadStatisticsData{
-    int averageFPS;
+    // Rates (frames per second) and frame intervals/latencies (milliseconds, see RateEstimator)
+    double averageFPS;
+    double windowFPS;
+    double jitterMs;
+    double minIntervalMs;
+    double maxIntervalMs;
+    double latencyMs;
+    double maxLatencyMs;
     int nFramesProcessed;
+    double arucoDetectionRate;
+    double faceDetectionRate;
+    double eyeDetectionRate;
+    int currentCPU;
+    int captureHealth;
+    int nReconnects;
+    // Compressed frames dropped because every MJPEG decoder was busy (capture only)
+    quint64 nDecoderDropped;
+    // Allocations made for the last frame (allocation tracking builds only)
+    struct AllocationCounts frameAllocations;
+};
+
+// Marker pose in the common (world) frame of the calibrated cameras
+struct MultiViewPose{
+    int id;
+    int nViews;
+    double rvec[3];
+    double tvec[3];
+    // Pixels (RMS over all views) and metres (RMS of the rigid fit)
+    double reprojectionError;
+    double fitError;
+};
+
+struct MultiViewResults{
+    quint64 setIndex;
+    double spreadMs;
+    QVector<struct MultiViewPose> poses;
+};
+
+struct FrameSyncStatistics{
+    quint64 nSets;
+    quint64 nUnmatchedFrames;
+    quint64 nDroppedSets;
 };
 
 #endif // STRUCTURES_H
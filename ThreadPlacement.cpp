@@ -0,0 +1,180 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ThreadPlacement.cpp                                                  */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ThreadPlacement.h"
+// Qt
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QDebug>
+// Local
+#include "Config.h"
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+namespace {
+
+// QString::SplitBehavior moved to the Qt namespace in Qt 5.14
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+const Qt::SplitBehavior skipEmptyParts=Qt::SkipEmptyParts;
+#else
+const QString::SplitBehavior skipEmptyParts=QString::SkipEmptyParts;
+#endif
+
+// Cores of a NUMA node, e.g. "node1" -> "8-15"
+QString readNodeCpuList(const QString &node)
+{
+    QFile file(QString("/sys/devices/system/node/%1/cpulist").arg(node));
+    if(!file.open(QIODevice::ReadOnly))
+        return QString();
+    return QString(file.readAll()).trimmed();
+}
+
+// Parse a list of cores ("0-3,6", "node0", "node0,12") into a CPU set
+bool parseCpuList(const QString &list, cpu_set_t *cpuSet)
+{
+    CPU_ZERO(cpuSet);
+    QStringList items=list.split(',', skipEmptyParts);
+    for(int i=0; i<items.size(); i++)
+    {
+        QString item=items.at(i).trimmed();
+        // NUMA node: expand to its cores
+        if(item.startsWith("node"))
+        {
+            QString nodeCpus=readNodeCpuList(item);
+            if(nodeCpus.isEmpty())
+                return false;
+            items.append(nodeCpus.split(',', skipEmptyParts));
+            continue;
+        }
+        bool ok1, ok2=true;
+        int first=item.section('-', 0, 0).toInt(&ok1);
+        int last=item.contains('-') ? item.section('-', 1, 1).toInt(&ok2) : first;
+        if(!ok1 || !ok2 || first<0 || last<first || last>=CPU_SETSIZE)
+            return false;
+        for(int cpu=first; cpu<=last; cpu++)
+            CPU_SET(cpu, cpuSet);
+    }
+    return CPU_COUNT(cpuSet)>0;
+}
+
+// Compact description of a CPU set, e.g. "0-3,6"
+QString describeCpuSet(const cpu_set_t *cpuSet)
+{
+    QStringList ranges;
+    for(int cpu=0; cpu<CPU_SETSIZE; cpu++)
+    {
+        if(!CPU_ISSET(cpu, cpuSet))
+            continue;
+        int last=cpu;
+        while(last+1<CPU_SETSIZE && CPU_ISSET(last+1, cpuSet))
+            last++;
+        ranges.append(last==cpu ? QString::number(cpu) : QString("%1-%2").arg(cpu).arg(last));
+        cpu=last;
+    }
+    return ranges.join(",");
+}
+
+}
+
+QString applyThreadPlacement(const struct ThreadPlacement &placement)
+{
+    QString description;
+    cpu_set_t cpuSet;
+
+    // Affinity
+    if(!placement.cpuList.isEmpty())
+    {
+        if(!parseCpuList(placement.cpuList, &cpuSet))
+            qDebug() << "WARNING: Invalid CPU list:" << placement.cpuList;
+        else
+        {
+            int result=pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+            if(result!=0)
+                qDebug() << "WARNING: Could not set thread affinity:" << strerror(result);
+        }
+    }
+    if(pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet)==0)
+        description=QString("CPUs ")+describeCpuSet(&cpuSet);
+
+    // Scheduling policy
+    if(placement.schedPolicy!=SCHED_POLICY_DEFAULT)
+    {
+        struct sched_param param;
+        param.sched_priority=placement.rtPriority;
+        int policy=(placement.schedPolicy==SCHED_POLICY_FIFO) ? SCHED_FIFO : SCHED_RR;
+        int result=pthread_setschedparam(pthread_self(), policy, &param);
+        // Real-time policies need CAP_SYS_NICE or an RTPRIO rlimit
+        if(result!=0)
+        {
+            qDebug() << "WARNING: Could not set real-time scheduling:" << strerror(result);
+            description+=(result==EPERM) ? QString(", RT denied") : QString(", RT failed");
+        }
+    }
+    int policy;
+    struct sched_param param;
+    if(pthread_getschedparam(pthread_self(), &policy, &param)==0)
+    {
+        if(policy==SCHED_FIFO)
+            description+=QString(", SCHED_FIFO ")+QString::number(param.sched_priority);
+        else if(policy==SCHED_RR)
+            description+=QString(", SCHED_RR ")+QString::number(param.sched_priority);
+        else
+            description+=QString(", SCHED_OTHER");
+    }
+    return description;
+}
+
+int getCurrentCPU()
+{
+    return sched_getcpu();
+}
+
+#else
+
+QString applyThreadPlacement(const struct ThreadPlacement &placement)
+{
+    // Thread placement is only implemented for Linux
+    if(!placement.cpuList.isEmpty() || placement.schedPolicy!=SCHED_POLICY_DEFAULT)
+        qDebug() << "WARNING: Thread placement is not supported on this platform.";
+    return QString("Not pinned");
+}
+
+int getCurrentCPU()
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,231 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* TraceRecorder.cpp                                                    */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "TraceRecorder.h"
+// Qt
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QVector>
+// C++
+#include <chrono>
+// Local
+#include "Config.h"
+
+namespace {
+
+struct TraceEvent{
+    const char *category;
+    const char *name;
+    qint64 begin;
+    // -1: instant event
+    qint64 duration;
+    quint64 sequence;
+    int deviceNumber;
+};
+
+}
+
+// Ring of the latest events of one thread (written by that thread only)
+class TraceBuffer
+{
+    public:
+        TraceBuffer(int threadId, const QString &threadName) :
+            threadId(threadId), threadName(threadName), events(TRACE_BUFFER_EVENTS), head(0), retired(0) {}
+        void add(const TraceEvent &event)
+        {
+            quint64 index=head.load();
+            events[index%TRACE_BUFFER_EVENTS]=event;
+            head.storeRelease(index+1);
+        }
+        // Events in the ring, oldest first (entries the writer may have overwritten while they were copied are left out)
+        QVector<TraceEvent> snapshot()
+        {
+            quint64 end=head.loadAcquire();
+            quint64 start=end>TRACE_BUFFER_EVENTS ? end-TRACE_BUFFER_EVENTS : 0;
+            QVector<TraceEvent> copy;
+            copy.reserve(end-start);
+            for(quint64 i=start; i<end; i++)
+                copy.append(events[i%TRACE_BUFFER_EVENTS]);
+            quint64 firstValid=head.loadAcquire()+1;
+            firstValid=firstValid>TRACE_BUFFER_EVENTS ? firstValid-TRACE_BUFFER_EVENTS : 0;
+            if(firstValid>start)
+                copy.remove(0, qMin((int)(firstValid-start), copy.size()));
+            return copy;
+        }
+        int threadId;
+        QString threadName;
+        QVector<TraceEvent> events;
+        QAtomicInteger<quint64> head;
+        // Owning thread has exited
+        QAtomicInt retired;
+};
+
+namespace {
+
+// Buffer of the calling thread (created on its first event while tracing)
+struct ThreadTrace{
+    ThreadTrace() : buffer(NULL) {}
+    ~ThreadTrace()
+    {
+        if(buffer)
+            buffer->retired.store(1);
+    }
+    TraceBuffer *buffer;
+    QString name;
+};
+
+thread_local ThreadTrace threadTrace;
+
+// JSON string (names are chosen by us: only quotes and backslashes need escaping)
+QByteArray quoted(const QString &string)
+{
+    QString escaped=string;
+    escaped.replace("\\", "\\\\").replace("\"", "\\\"");
+    return QByteArray("\"")+escaped.toUtf8()+QByteArray("\"");
+}
+
+}
+
+QAtomicInt TraceRecorder::enabled(0);
+
+TraceRecorder* TraceRecorder::instance()
+{
+    static TraceRecorder recorder;
+    return &recorder;
+}
+
+TraceRecorder::TraceRecorder() : nThreads(0), traceStart(0)
+{
+}
+
+void TraceRecorder::setEnabled(bool enable)
+{
+    QMutexLocker locker(&mutex);
+    if(enable)
+    {
+        // Buffers of threads that have exited are only kept for the trace they took part in
+        for(int i=buffers.size()-1; i>=0; i--)
+        {
+            if(buffers[i]->retired.load())
+                delete buffers.takeAt(i);
+        }
+        // Events from before this point (previous trace) are not dumped
+        traceStart.store(now());
+    }
+    enabled.store(enable ? 1 : 0);
+}
+
+void TraceRecorder::setThreadName(const QString &name)
+{
+    threadTrace.name=name;
+    // Buffer already created: rename it
+    if(threadTrace.buffer)
+    {
+        QMutexLocker locker(&instance()->mutex);
+        threadTrace.buffer->threadName=name;
+    }
+}
+
+qint64 TraceRecorder::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceRecorder::record(const char *category, const char *name, qint64 begin, qint64 duration, int deviceNumber, quint64 sequence)
+{
+    if(!threadTrace.buffer)
+        threadTrace.buffer=instance()->addBuffer(threadTrace.name);
+    TraceEvent event={category, name, begin, duration, sequence, deviceNumber};
+    threadTrace.buffer->add(event);
+}
+
+void TraceRecorder::instant(const char *category, const char *name, int deviceNumber, quint64 sequence)
+{
+    if(isEnabled())
+        record(category, name, now(), -1, deviceNumber, sequence);
+}
+
+TraceBuffer* TraceRecorder::addBuffer(const QString &threadName)
+{
+    QMutexLocker locker(&mutex);
+    nThreads++;
+    TraceBuffer *buffer=new TraceBuffer(nThreads, threadName.isEmpty() ? QString("Thread %1").arg(nThreads) : threadName);
+    buffers.append(buffer);
+    return buffer;
+}
+
+bool TraceRecorder::dump(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QMutexLocker locker(&mutex);
+    QByteArray pid=QByteArray::number(QCoreApplication::applicationPid());
+    qint64 start=traceStart.load();
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first=true;
+    for(int i=0; i<buffers.size(); i++)
+    {
+        TraceBuffer *buffer=buffers[i];
+        QVector<TraceEvent> events=buffer->snapshot();
+        QByteArray tid=QByteArray::number(buffer->threadId);
+        QByteArray json;
+        // Thread name (metadata event)
+        json.append(first ? "" : ",\n");
+        json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"+pid+",\"tid\":"+tid+
+                    ",\"args\":{\"name\":"+quoted(buffer->threadName)+"}}");
+        first=false;
+        for(int j=0; j<events.size(); j++)
+        {
+            const TraceEvent &event=events[j];
+            // Previous trace
+            if(event.begin<start)
+                continue;
+            json.append(",\n{\"cat\":\""+QByteArray(event.category)+"\",\"name\":\""+QByteArray(event.name)+
+                        "\",\"pid\":"+pid+",\"tid\":"+tid+",\"ts\":"+QByteArray::number((event.begin-start)/1000.0, 'f', 3));
+            // Complete event (timestamps and durations in microseconds) or instant event (thread scope)
+            if(event.duration>=0)
+                json.append(",\"ph\":\"X\",\"dur\":"+QByteArray::number(event.duration/1000.0, 'f', 3));
+            else
+                json.append(",\"ph\":\"i\",\"s\":\"t\"");
+            // Camera and frame (lets a frame be followed across threads)
+            if(event.deviceNumber>=0)
+                json.append(",\"args\":{\"camera\":"+QByteArray::number(event.deviceNumber)+
+                            ",\"frame\":"+QByteArray::number(event.sequence)+"}");
+            json.append("}");
+        }
+        file.write(json);
+    }
+    file.write("\n]}\n");
+    return file.error()==QFileDevice::NoError;
+}
@@ -0,0 +1,115 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* TraceRecorder.h                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+// Qt
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+class TraceBuffer;
+
+// Timeline of what every thread spends its time on, for finding out why a
+// frame was late (capture, sync barrier, buffer wait or a processing stage).
+// Each thread writes complete events (begin + duration, camera, frame sequence
+// number) into its own ring of TRACE_BUFFER_EVENTS, without locks; the rings are
+// only read when dumped as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// While disabled a trace point costs one relaxed load.
+class TraceRecorder
+{
+    public:
+        static TraceRecorder* instance();
+        static bool isEnabled()
+        {
+            return enabled.load();
+        }
+        // Starts a new trace (events of the previous one are discarded)
+        void setEnabled(bool enable);
+        // Name of the calling thread in the trace
+        static void setThreadName(const QString &name);
+        // Steady clock, nanoseconds
+        static qint64 now();
+        // Category and name must be string literals (only the pointers are stored)
+        static void record(const char *category, const char *name, qint64 begin, qint64 duration, int deviceNumber=-1, quint64 sequence=0);
+        static void instant(const char *category, const char *name, int deviceNumber=-1, quint64 sequence=0);
+        // Writes the events of the current trace as Chrome trace JSON
+        bool dump(const QString &fileName);
+
+    private:
+        TraceRecorder();
+        TraceBuffer* addBuffer(const QString &threadName);
+        static QAtomicInt enabled;
+        QMutex mutex;
+        QList<TraceBuffer*> buffers;
+        int nThreads;
+        QAtomicInteger<qint64> traceStart;
+};
+
+// Records the time from construction to destruction (if tracing was enabled on construction)
+class TraceScope
+{
+    public:
+        TraceScope(const char *category, const char *name, int deviceNumber=-1, quint64 sequence=0) :
+            name(NULL), begin(0)
+        {
+            if(TraceRecorder::isEnabled())
+            {
+                this->category=category;
+                this->name=name;
+                this->deviceNumber=deviceNumber;
+                this->sequence=sequence;
+                begin=TraceRecorder::now();
+            }
+        }
+        ~TraceScope()
+        {
+            if(name)
+                TraceRecorder::record(category, name, begin, TraceRecorder::now()-begin, deviceNumber, sequence);
+        }
+        // Frame only known at the end of the scope (e.g. grab)
+        void setSequence(quint64 sequence)
+        {
+            this->sequence=sequence;
+        }
+
+    private:
+        const char *category;
+        const char *name;
+        int deviceNumber;
+        quint64 sequence;
+        qint64 begin;
+};
+
+#endif // TRACERECORDER_H
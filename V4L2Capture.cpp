@@ -0,0 +1,424 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* V4L2Capture.cpp                                                      */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "V4L2Capture.h"
+// Qt
+#include <QAtomicInt>
+#include <QDebug>
+// Local
+#include "Config.h"
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+// C++
+#include <chrono>
+
+namespace {
+
+int xioctl(int fd, unsigned long request, void *arg)
+{
+    int result;
+    do
+        result=ioctl(fd, request, arg);
+    while(result==-1 && errno==EINTR);
+    return result;
+}
+
+unsigned int toFourcc(int pixelFormat)
+{
+    switch(pixelFormat)
+    {
+        case PIXEL_FORMAT_YUYV:
+            return V4L2_PIX_FMT_YUYV;
+        case PIXEL_FORMAT_NV12:
+            return V4L2_PIX_FMT_NV12;
+        case PIXEL_FORMAT_GREY:
+            return V4L2_PIX_FMT_GREY;
+        case PIXEL_FORMAT_MJPEG:
+            return V4L2_PIX_FMT_MJPEG;
+        default:
+            return V4L2_PIX_FMT_BGR24;
+    }
+}
+
+}
+
+// Owns the device and its mapped buffers. Also acts as the allocator of the Mats
+// wrapping those buffers, so it is reference counted: by V4L2Capture and by every
+// buffer currently held by the application. The last reference closes the device.
+class V4L2BufferPool : public DeviceBufferAllocator
+{
+    public:
+        V4L2BufferPool(int fd) : fd(fd), nBuffers(0), streaming(0), refs(1) {}
+
+        UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           AccessFlag flags, UMatUsageFlags usageFlags) const
+        {
+            // Mats reallocated in place (e.g. by an in-place colour conversion) get ordinary memory
+            return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        bool allocate(UMatData* data, AccessFlag accessflags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+        }
+
+        void deallocate(UMatData* u) const
+        {
+            // Last reference to a driver buffer released: give it back to the driver
+            V4L2BufferPool *pool=const_cast<V4L2BufferPool*>(this);
+            pool->requeue((int)(intptr_t)u->userdata);
+            delete u;
+            pool->unref();
+        }
+
+        bool mapBuffers(int count)
+        {
+            struct v4l2_requestbuffers req;
+            memset(&req, 0, sizeof(req));
+            req.count=count;
+            req.type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            req.memory=V4L2_MEMORY_MMAP;
+            if(xioctl(fd, VIDIOC_REQBUFS, &req)==-1 || req.count<2)
+                return false;
+            for(nBuffers=0; nBuffers<(int)req.count && nBuffers<V4L2_MAX_BUFFERS; nBuffers++)
+            {
+                struct v4l2_buffer buf;
+                memset(&buf, 0, sizeof(buf));
+                buf.type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                buf.memory=V4L2_MEMORY_MMAP;
+                buf.index=nBuffers;
+                if(xioctl(fd, VIDIOC_QUERYBUF, &buf)==-1)
+                    return false;
+                lengths[nBuffers]=buf.length;
+                starts[nBuffers]=mmap(NULL, buf.length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+                if(starts[nBuffers]==MAP_FAILED)
+                    return false;
+            }
+            return true;
+        }
+
+        bool startStreaming()
+        {
+            for(int i=0; i<nBuffers; i++)
+            {
+                if(!queue(i))
+                    return false;
+            }
+            enum v4l2_buf_type type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            if(xioctl(fd, VIDIOC_STREAMON, &type)==-1)
+                return false;
+            streaming.store(1);
+            return true;
+        }
+
+        void stopStreaming()
+        {
+            enum v4l2_buf_type type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            if(streaming.testAndSetOrdered(1, 0))
+                xioctl(fd, VIDIOC_STREAMOFF, &type);
+        }
+
+        // Wait for the next filled buffer. Returns its index or -1 on timeout/error.
+        int dequeue(size_t *bytesUsed, qint64 *timestamp, quint64 *sequence)
+        {
+            struct pollfd pfd;
+            pfd.fd=fd;
+            pfd.events=POLLIN;
+            if(poll(&pfd, 1, V4L2_DEQUEUE_TIMEOUT_MS)<=0)
+                return -1;
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(buf));
+            buf.type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory=V4L2_MEMORY_MMAP;
+            if(xioctl(fd, VIDIOC_DQBUF, &buf)==-1)
+                return -1;
+            *bytesUsed=buf.bytesused;
+            // Driver timestamps are only comparable with other streams if taken from the monotonic clock
+            if((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK)==V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+                *timestamp=(qint64)buf.timestamp.tv_sec*1000000+buf.timestamp.tv_usec;
+            else
+                *timestamp=std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+            *sequence=buf.sequence;
+            return buf.index;
+        }
+
+        bool requeue(int index)
+        {
+            // Buffers released after streaming stopped are simply dropped
+            if(!streaming.load())
+                return false;
+            return queue(index);
+        }
+
+        bool queue(int index)
+        {
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(buf));
+            buf.type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory=V4L2_MEMORY_MMAP;
+            buf.index=index;
+            return xioctl(fd, VIDIOC_QBUF, &buf)==0;
+        }
+
+        // Wrap buffer in a Mat without copying
+        Mat wrap(int index, int rows, int cols, int type, size_t step)
+        {
+            UMatData *u=new UMatData(this);
+            u->data=u->origdata=(uchar*)starts[index];
+            u->size=lengths[index];
+            u->userdata=(void*)(intptr_t)index;
+            u->flags|=UMatData::USER_ALLOCATED;
+            u->refcount=1;
+            ref();
+            Mat frame(rows, cols, type, starts[index], step);
+            frame.u=u;
+            frame.allocator=this;
+            return frame;
+        }
+
+        void ref()
+        {
+            refs.ref();
+        }
+
+        void unref()
+        {
+            if(!refs.deref())
+            {
+                stopStreaming();
+                for(int i=0; i<nBuffers; i++)
+                    munmap(starts[i], lengths[i]);
+                ::close(fd);
+                delete this;
+            }
+        }
+
+        int fd;
+        int nBuffers;
+        QAtomicInt streaming;
+        void *starts[V4L2_MAX_BUFFERS];
+        size_t lengths[V4L2_MAX_BUFFERS];
+
+    private:
+        QAtomicInt refs;
+};
+
+V4L2Capture::V4L2Capture()
+{
+    // Initialize members
+    bufferPool=NULL;
+    width=0;
+    height=0;
+    bytesPerLine=0;
+    pixelFormat=PIXEL_FORMAT_YUYV;
+}
+
+V4L2Capture::~V4L2Capture()
+{
+    close();
+}
+
+bool V4L2Capture::open(const QString &devicePath, int width, int height, int pixelFormat, int nBuffers)
+{
+    close();
+    int fd=::open(devicePath.toLocal8Bit().constData(), O_RDWR|O_NONBLOCK);
+    if(fd==-1)
+    {
+        qDebug() << "ERROR: Could not open" << devicePath << ":" << strerror(errno);
+        return false;
+    }
+    bufferPool=new V4L2BufferPool(fd);
+
+    // Device must support streaming capture
+    struct v4l2_capability cap;
+    if(xioctl(fd, VIDIOC_QUERYCAP, &cap)==-1 ||
+       !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(cap.capabilities & V4L2_CAP_STREAMING))
+    {
+        qDebug() << "ERROR:" << devicePath << "is not a V4L2 streaming capture device.";
+        close();
+        return false;
+    }
+
+    // Request pixel format at the desired resolution (keep current resolution if not specified)
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type=V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(fd, VIDIOC_G_FMT, &fmt);
+    if(width!=-1)
+        fmt.fmt.pix.width=width;
+    if(height!=-1)
+        fmt.fmt.pix.height=height;
+    fmt.fmt.pix.pixelformat=toFourcc(pixelFormat);
+    fmt.fmt.pix.field=V4L2_FIELD_NONE;
+    if(xioctl(fd, VIDIOC_S_FMT, &fmt)==-1 || fmt.fmt.pix.pixelformat!=toFourcc(pixelFormat))
+    {
+        qDebug() << "ERROR:" << devicePath << "does not support the requested pixel format.";
+        close();
+        return false;
+    }
+    this->width=fmt.fmt.pix.width;
+    this->height=fmt.fmt.pix.height;
+    this->bytesPerLine=fmt.fmt.pix.bytesperline;
+    this->pixelFormat=pixelFormat;
+
+    // Map driver buffers and start streaming
+    if(!bufferPool->mapBuffers(nBuffers) || !bufferPool->startStreaming())
+    {
+        qDebug() << "ERROR: Could not start streaming from" << devicePath << ":" << strerror(errno);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void V4L2Capture::close()
+{
+    if(bufferPool)
+    {
+        // Buffers still held by the application keep the pool alive until they are released
+        bufferPool->stopStreaming();
+        bufferPool->unref();
+        bufferPool=NULL;
+    }
+}
+
+bool V4L2Capture::isOpened()
+{
+    return bufferPool!=NULL;
+}
+
+bool V4L2Capture::grab(Frame &frame)
+{
+    if(!bufferPool)
+        return false;
+    size_t bytesUsed;
+    int index=bufferPool->dequeue(&bytesUsed, &frame.timestamp, &frame.sequence);
+    if(index<0)
+        return false;
+    // Rows and type of the buffer (compressed frames: one row of bytes)
+    int rows=height;
+    int cols=width;
+    int type=CV_8UC3;
+    if(pixelFormat==PIXEL_FORMAT_YUYV)
+        type=CV_8UC2;
+    else if(pixelFormat==PIXEL_FORMAT_NV12)
+    {
+        rows=height*3/2;
+        type=CV_8UC1;
+    }
+    else if(pixelFormat==PIXEL_FORMAT_GREY)
+        type=CV_8UC1;
+    else if(pixelFormat==PIXEL_FORMAT_MJPEG)
+    {
+        rows=1;
+        cols=(int)bytesUsed;
+        type=CV_8UC1;
+    }
+    // Incomplete frame: hand buffer straight back
+    if(bytesUsed==0 || (pixelFormat!=PIXEL_FORMAT_MJPEG && bytesUsed<(size_t)bytesPerLine*rows))
+    {
+        bufferPool->requeue(index);
+        return false;
+    }
+    frame.data=bufferPool->wrap(index, rows, cols, type, pixelFormat==PIXEL_FORMAT_MJPEG ? Mat::AUTO_STEP : bytesPerLine);
+    frame.pixelFormat=pixelFormat;
+    frame.width=width;
+    frame.height=height;
+    return true;
+}
+
+int V4L2Capture::getFd()
+{
+    return bufferPool ? bufferPool->fd : -1;
+}
+
+#else
+
+V4L2Capture::V4L2Capture()
+{
+    bufferPool=NULL;
+    width=0;
+    height=0;
+    bytesPerLine=0;
+    pixelFormat=PIXEL_FORMAT_YUYV;
+}
+
+V4L2Capture::~V4L2Capture()
+{
+}
+
+bool V4L2Capture::open(const QString &, int, int, int, int)
+{
+    qDebug() << "ERROR: V4L2 capture is only available on Linux.";
+    return false;
+}
+
+void V4L2Capture::close()
+{
+}
+
+bool V4L2Capture::isOpened()
+{
+    return false;
+}
+
+bool V4L2Capture::grab(Frame &)
+{
+    return false;
+}
+
+int V4L2Capture::getFd()
+{
+    return -1;
+}
+
+#endif
+
+int V4L2Capture::getWidth()
+{
+    return width;
+}
+
+int V4L2Capture::getHeight()
+{
+    return height;
+}
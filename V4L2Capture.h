@@ -0,0 +1,71 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* V4L2Capture.h                                                        */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef V4L2CAPTURE_H
+#define V4L2CAPTURE_H
+
+// Qt
+#include <QtCore/QString>
+// OpenCV
+#include <opencv2/core.hpp>
+// Local
+#include "Frame.h"
+
+using namespace cv;
+
+class V4L2BufferPool;
+
+// Native Video4Linux2 capture using memory-mapped driver buffers.
+// Frames returned by grab() point straight into a driver buffer; the buffer is
+// handed back to the driver once the last Mat referencing it is released.
+class V4L2Capture
+{
+    public:
+        V4L2Capture();
+        ~V4L2Capture();
+        bool open(const QString &devicePath, int width, int height, int pixelFormat, int nBuffers);
+        void close();
+        bool isOpened();
+        bool grab(Frame &frame);
+        int getWidth();
+        int getHeight();
+        int getFd();
+
+    private:
+        V4L2BufferPool *bufferPool;
+        int width;
+        int height;
+        int bytesPerLine;
+        int pixelFormat;
+};
+
+#endif // V4L2CAPTURE_H
@@ -0,0 +1,215 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* WorkerPool.cpp                                                       */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "WorkerPool.h"
+// Qt
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <QThread>
+// C++
+#include <algorithm>
+// Local
+#include "AllocationTracker.h"
+
+struct ParallelJob
+{
+    void (*function)(const void*, int);
+    const void *task;
+    int nTasks;
+    QAtomicInt nextTask;
+    // Workers currently inside work() (guarded by the pool mutex)
+    int nActive;
+    QWaitCondition finished;
+    // Allocations made by workers are charged to the calling thread (allocation tracking)
+    Qt::HANDLE caller;
+    AllocationTally allocations;
+
+    bool hasTasks()
+    {
+        return nextTask.load()<nTasks;
+    }
+
+    // Claim and run tasks until none are left. Returns once this thread cannot claim any more.
+    void work()
+    {
+        bool worker=AllocationTracker::isEnabled() && QThread::currentThreadId()!=caller;
+        int i;
+        while((i=nextTask.fetchAndAddRelaxed(1))<nTasks)
+        {
+            struct AllocationCounts before=AllocationTracker::threadCounts();
+            function(task, i);
+            // Counted before the caller can be woken
+            if(worker)
+                allocations.add(AllocationTracker::threadCounts()-before);
+        }
+    }
+};
+
+class WorkerPoolThread : public QThread
+{
+    public:
+        WorkerPoolThread(WorkerPool *workerPool) : workerPool(workerPool) {}
+
+    protected:
+        void run() { workerPool->workerLoop(); }
+
+    private:
+        WorkerPool *workerPool;
+};
+
+WorkerPool::WorkerPool() : nIdle(0), stopping(false)
+{
+    // One worker per core (the calling thread also takes part in every job)
+    int nThreads=QThread::idealThreadCount();
+    // Room for the jobs of several cameras (and nested jobs) without growing
+    openJobs.reserve(4*nThreads);
+    freeJobs.reserve(4*nThreads);
+    for(int i=0; i<nThreads; i++)
+    {
+        threads.push_back(new WorkerPoolThread(this));
+        threads.back()->start();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    // Stop workers
+    mutex.lock();
+    stopping=true;
+    jobAvailable.wakeAll();
+    mutex.unlock();
+    for(size_t i=0; i<threads.size(); i++)
+    {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    // Free jobs (no caller can be inside parallelFor() at this point)
+    for(size_t i=0; i<freeJobs.size(); i++)
+        delete freeJobs[i];
+}
+
+WorkerPool* WorkerPool::instance()
+{
+    static WorkerPool workerPool;
+    return &workerPool;
+}
+
+int WorkerPool::maxThreadCount()
+{
+    return (int)threads.size();
+}
+
+void WorkerPool::workerLoop()
+{
+    QMutexLocker locker(&mutex);
+    while(!stopping)
+    {
+        // Find a job with unclaimed tasks
+        ParallelJob *job=NULL;
+        for(size_t i=0; i<openJobs.size(); i++)
+        {
+            if(openJobs[i]->hasTasks())
+            {
+                job=openJobs[i];
+                break;
+            }
+        }
+        // Nothing to do: wait for the next job
+        if(job==NULL)
+        {
+            nIdle++;
+            jobAvailable.wait(&mutex);
+            nIdle--;
+            continue;
+        }
+        // Run tasks outside the lock
+        job->nActive++;
+        locker.unlock();
+        job->work();
+        locker.relock();
+        // Last worker out wakes the caller
+        if(--job->nActive==0)
+            job->finished.wakeAll();
+    }
+}
+
+void WorkerPool::run(int nTasks, void (*function)(const void*, int), const void *task)
+{
+    // Nothing to split
+    if(nTasks<=1)
+    {
+        if(nTasks==1)
+            function(task, 0);
+        return;
+    }
+
+    // Take a job from the free list (only allocates while warming up)
+    mutex.lock();
+    ParallelJob *job;
+    if(freeJobs.empty())
+        job=new ParallelJob;
+    else
+    {
+        job=freeJobs.back();
+        freeJobs.pop_back();
+    }
+    job->function=function;
+    job->task=task;
+    job->nTasks=nTasks;
+    job->nextTask=0;
+    job->nActive=0;
+    job->caller=QThread::currentThreadId();
+    job->allocations.reset();
+
+    // Recruit idle workers only: if the pool is busy serving other cameras the
+    // remaining tasks are claimed by whichever threads are already running
+    int nWake=std::min(nIdle, nTasks-1);
+    if(nWake>0)
+    {
+        openJobs.push_back(job);
+        for(int i=0; i<nWake; i++)
+            jobAvailable.wakeOne();
+    }
+    mutex.unlock();
+
+    // Calling thread claims tasks too, then waits for workers still running tasks
+    job->work();
+    mutex.lock();
+    std::vector<ParallelJob*>::iterator it=std::find(openJobs.begin(), openJobs.end(), job);
+    if(it!=openJobs.end())
+        openJobs.erase(it);
+    while(job->nActive>0)
+        job->finished.wait(&mutex);
+    freeJobs.push_back(job);
+    mutex.unlock();
+    AllocationTracker::charge(job->allocations.get());
+}
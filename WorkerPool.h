@@ -0,0 +1,80 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* WorkerPool.h                                                         */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+// Qt
+#include <QMutex>
+#include <QWaitCondition>
+// C++
+#include <vector>
+
+class WorkerPoolThread;
+struct ParallelJob;
+
+// Process-wide pool of worker threads shared by all cameras. The pool is sized
+// to the machine (one thread per core), so N cameras on M cores never run more
+// than M helper threads in total. Jobs are taken from a free list and the task
+// is passed by reference, so parallelFor() does not allocate once warmed up.
+class WorkerPool
+{
+    public:
+        static WorkerPool* instance();
+        int maxThreadCount();
+        template<typename Task> void parallelFor(int nTasks, const Task &task)
+        {
+            run(nTasks, &WorkerPool::invoke<Task>, &task);
+        }
+
+    private:
+        WorkerPool();
+        ~WorkerPool();
+        template<typename Task> static void invoke(const void *task, int i)
+        {
+            (*static_cast<const Task*>(task))(i);
+        }
+        void run(int nTasks, void (*function)(const void*, int), const void *task);
+        void workerLoop();
+        QMutex mutex;
+        QWaitCondition jobAvailable;
+        std::vector<WorkerPoolThread*> threads;
+        // Jobs which still have unclaimed tasks, and finished jobs kept for reuse
+        std::vector<ParallelJob*> openJobs;
+        std::vector<ParallelJob*> freeJobs;
+        int nIdle;
+        bool stopping;
+
+    friend class WorkerPoolThread;
+};
+
+#endif // WORKERPOOL_H
@@ -32,9 +32,12 @@
 
 #include "MainWindow.h"
 #include <QApplication>
+#include "AllocationTracker.h"
 
 int main(int argc, char *argv[])
 {
+    // Count Mat allocations (allocation tracking builds only, before any thread is started)
+    AllocationTracker::install();
     // Show main window
     QApplication a(argc, argv);
     MainWindow w;
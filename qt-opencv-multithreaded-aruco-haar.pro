@@ -21,7 +21,30 @@ SOURCES += main.cpp \
     CameraConnectDialog.cpp \
     ImageProcessingSettingsDialog.cpp \
     SharedImageBuffer.cpp \
-    faceDetector.cpp
+    faceDetector.cpp \
+    WorkerPool.cpp \
+    DetectionGovernor.cpp \
+    ThreadPlacement.cpp \
+    V4L2Capture.cpp \
+    Frame.cpp \
+    MjpegDecoder.cpp \
+    CaptureHealthMonitor.cpp \
+    FrameSynchronizer.cpp \
+    MultiViewThread.cpp \
+    CaptureEngine.cpp \
+    ProcessingPool.cpp \
+    ResultPublisher.cpp \
+    FrameExporter.cpp \
+    FrameRecorder.cpp \
+    ReplayCapture.cpp \
+    ReplayWriter.cpp \
+    StatsRegistry.cpp \
+    StatsServer.cpp \
+    RateEstimator.cpp \
+    TraceRecorder.cpp \
+    AllocationTracker.cpp \
+    FrameArena.cpp \
+    HugePageAllocator.cpp
 
 HEADERS += \
     MainWindow.h \
@@ -36,7 +59,34 @@ HEADERS += \
     ImageProcessingSettingsDialog.h \
     SharedImageBuffer.h \
     Buffer.h \
-    faceDetector.h
+    faceDetector.h \
+    WorkerPool.h \
+    DetectionGovernor.h \
+    ThreadPlacement.h \
+    V4L2Capture.h \
+    Frame.h \
+    MjpegDecoder.h \
+    CaptureHealthMonitor.h \
+    FrameSynchronizer.h \
+    MultiViewThread.h \
+    CaptureEngine.h \
+    ProcessingPool.h \
+    ResultPublisher.h \
+    ResultRecord.h \
+    FrameExporter.h \
+    ShmFrameRing.h \
+    FrameRecorder.h \
+    SpscQueue.h \
+    ReplayFormat.h \
+    ReplayCapture.h \
+    ReplayWriter.h \
+    StatsRegistry.h \
+    StatsServer.h \
+    RateEstimator.h \
+    TraceRecorder.h \
+    AllocationTracker.h \
+    FrameArena.h \
+    HugePageAllocator.h
 
 FORMS += \
     MainWindow.ui \
@@ -44,6 +94,12 @@ FORMS += \
     CameraConnectDialog.ui \
     ImageProcessingSettingsDialog.ui
 
+# POSIX shared memory (frame export)
+unix: LIBS += -lrt
+
+# Allocation tracking (qmake CONFIG+=alloc_tracking): allocations per frame shown next to the rates
+alloc_tracking: DEFINES += ALLOCATION_TRACKING
+
     #Linux opencv link
     # OpenCv Configuration opencv-4.2.0
     INCLUDEPATH += "/usr/include/opencv4/opencv2"
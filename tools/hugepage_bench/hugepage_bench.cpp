@@ -0,0 +1,178 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* hugepage_bench.cpp                                                   */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+// Benchmark for the huge-page frame allocator: runs a capture/processing-like
+// workload on 4K frames (copy of the captured frame, grey conversion, blur and a
+// column-wise pass, which touches a new 4 KB page on every row) with each
+// HugePageMode and reports frame rate, dTLB load misses and page faults per frame.
+//
+// Usage: hugepage_bench [width] [height] [seconds per mode] [frames in pool]
+//        (default: 3840 2160 5 8; perf counters need kernel.perf_event_paranoid <= 2)
+
+#include "HugePageAllocator.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <opencv2/imgproc.hpp>
+
+#include <string>
+#include <vector>
+
+static double monotonicSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+// User-space counter of this thread (-1 if not permitted)
+static int openCounter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=type;
+    attr.config=config;
+    attr.disabled=1;
+    attr.exclude_kernel=1;
+    attr.exclude_hv=1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long readCounter(int fd)
+{
+    long long value=0;
+    if(fd<0 || read(fd, &value, sizeof(value))!=sizeof(value))
+        return -1;
+    return value;
+}
+
+static std::string readLine(const char *path)
+{
+    FILE *file=fopen(path, "r");
+    if(!file)
+        return "n/a";
+    char line[256]="";
+    if(!fgets(line, sizeof(line), file))
+        line[0]=0;
+    fclose(file);
+    std::string text(line);
+    if(!text.empty() && text[text.size()-1]=='\n')
+        text.erase(text.size()-1);
+    return text;
+}
+
+int main(int argc, char *argv[])
+{
+    int width=argc>1 ? atoi(argv[1]) : 3840;
+    int height=argc>2 ? atoi(argv[2]) : 2160;
+    double seconds=argc>3 ? atof(argv[3]) : 5;
+    int nFrames=argc>4 ? atoi(argv[4]) : 8;
+
+    printf("Frames: %dx%d BGR, pool of %d, %.0f s per mode\n", width, height, nFrames, seconds);
+    printf("Transparent huge pages: %s\n", readLine("/sys/kernel/mm/transparent_hugepage/enabled").c_str());
+    printf("Explicit huge pages reserved: %s\n\n", readLine("/proc/sys/vm/nr_hugepages").c_str());
+
+    const char *modeNames[]={"off (4 KB pages)", "transparent", "explicit"};
+    HugePageAllocator *allocator=HugePageAllocator::instance();
+    // Captured frames (filled once, contents do not matter)
+    RNG rng(12345);
+    for(int mode=HUGE_PAGES_OFF; mode<=HUGE_PAGES_EXPLICIT; mode++)
+    {
+        allocator->setMode(mode);
+        allocator->trimCache();
+        struct HugePageStatistics before=allocator->getStatistics();
+
+        // Frame pool as the capture/processing threads hold it
+        std::vector<Mat> captured(nFrames), grey(nFrames), blurred(nFrames);
+        for(int i=0; i<nFrames; i++)
+        {
+            captured[i].allocator=grey[i].allocator=blurred[i].allocator=HugePageAllocator::frameAllocator();
+            captured[i].create(height, width, CV_8UC3);
+            rng.fill(captured[i], RNG::UNIFORM, 0, 256);
+        }
+
+        int dtlbMisses=openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                                   (PERF_COUNT_HW_CACHE_OP_READ<<8) | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16));
+        int pageFaults=openCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+        ioctl(dtlbMisses, PERF_EVENT_IOC_ENABLE, 0);
+        ioctl(pageFaults, PERF_EVENT_IOC_ENABLE, 0);
+
+        long frames=0;
+        unsigned long long checksum=0;
+        double start=monotonicSeconds();
+        while(monotonicSeconds()-start<seconds)
+        {
+            int i=frames%nFrames;
+            // Capture: copy out of the driver/backend buffer (allocated and freed every frame)
+            Mat copy;
+            copy.allocator=HugePageAllocator::frameAllocator();
+            captured[i].copyTo(copy);
+            // Processing
+            cvtColor(copy, grey[i], COLOR_BGR2GRAY);
+            GaussianBlur(grey[i], blurred[i], Size(5, 5), 0);
+            // Column-wise pass (e.g. a vertical filter or transposed access): one page per row
+            for(int x=0; x<width; x+=64)
+                for(int y=0; y<height; y++)
+                    checksum+=copy.ptr<uchar>(y)[x*3];
+            frames++;
+        }
+        double elapsed=monotonicSeconds()-start;
+
+        long long misses=readCounter(dtlbMisses);
+        long long faults=readCounter(pageFaults);
+        if(dtlbMisses>=0)
+            close(dtlbMisses);
+        if(pageFaults>=0)
+            close(pageFaults);
+        struct HugePageStatistics after=allocator->getStatistics();
+
+        printf("%-18s %7.2f fps", modeNames[mode], frames/elapsed);
+        if(misses>=0)
+            printf("  %10.0f dTLB load misses/frame", (double)misses/frames);
+        else
+            printf("  %10s dTLB load misses/frame", "n/a");
+        if(faults>=0)
+            printf("  %8.1f page faults/frame", (double)faults/frames);
+        printf("\n%-18s regions: %llu explicit, %llu transparent, %llu reused, %llu fallbacks (checksum %llu)\n", "",
+               after.nExplicit-before.nExplicit, after.nTransparent-before.nTransparent,
+               after.nReused-before.nReused, after.nFallbacks-before.nFallbacks, checksum&0xff);
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+# Huge-page frame memory benchmark: TLB misses and frame rate with and without HugePageAllocator (Linux only)
+TEMPLATE = app
+TARGET = hugepage_bench
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../HugePageAllocator.cpp \
+    hugepage_bench.cpp
+
+HEADERS += \
+    ../../HugePageAllocator.h \
+    ../../Structures.h \
+    ../../Config.h
+
+CONFIG += link_pkgconfig
+PKGCONFIG += opencv4
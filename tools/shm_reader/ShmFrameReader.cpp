@@ -0,0 +1,134 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ShmFrameReader.cpp                                                   */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ShmFrameReader.h"
+
+// Linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+ShmFrameReader::ShmFrameReader() : header(NULL), mappedSize(0), nextIndex(0), missed(0)
+{
+}
+
+ShmFrameReader::~ShmFrameReader()
+{
+    close();
+}
+
+bool ShmFrameReader::open(const std::string &name)
+{
+    close();
+    this->name=name;
+    int fd=shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd==-1)
+        return false;
+    // Map header first to find the size of the ring
+    struct stat st;
+    void *data=MAP_FAILED;
+    if(fstat(fd, &st)==0 && (size_t)st.st_size>=sizeof(ShmRingHeader))
+        data=mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data==MAP_FAILED)
+        return false;
+    const struct ShmRingHeader *ring=(const struct ShmRingHeader*)data;
+    // Writer has not finished setting the ring up, or the ring is of an unknown version
+    if(ring->magic!=SHM_RING_MAGIC || ring->version!=SHM_RING_VERSION ||
+       sizeof(ShmRingHeader)+(size_t)ring->nSlots*ring->slotStride>(size_t)st.st_size)
+    {
+        munmap(data, st.st_size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    header=ring;
+    mappedSize=st.st_size;
+    // Start with the latest frame
+    uint64_t written=header->writeIndex.load(std::memory_order_acquire);
+    nextIndex=written>0 ? written-1 : 0;
+    return true;
+}
+
+void ShmFrameReader::close()
+{
+    if(header)
+        munmap((void*)header, mappedSize);
+    header=NULL;
+    mappedSize=0;
+}
+
+bool ShmFrameReader::isOpen() const
+{
+    return header!=NULL;
+}
+
+bool ShmFrameReader::acquire(ShmFrameView &view)
+{
+    // Ring replaced by the writer (frame size changed) or not there yet: reopen
+    if(!header || header->state.load(std::memory_order_acquire)!=SHM_RING_LIVE)
+    {
+        if(!open(name))
+            return false;
+    }
+    uint64_t written=header->writeIndex.load(std::memory_order_acquire);
+    if(written<=nextIndex)
+        return false;
+    // Latest frame (older ones are skipped)
+    uint64_t index=written-1;
+    missed+=index-nextIndex;
+    const struct ShmSlotHeader *slot=(const struct ShmSlotHeader*)((const char*)header+sizeof(ShmRingHeader)+
+                                                                   (index%header->nSlots)*header->slotStride);
+    uint64_t seq=slot->seq.load(std::memory_order_acquire);
+    // Slot being written (writer has lapped the reader): try again later
+    if(seq&1 || slot->index!=index)
+        return false;
+    nextIndex=index+1;
+    view.info=slot;
+    view.data=(const unsigned char*)slot+sizeof(ShmSlotHeader);
+    view.index=index;
+    view.seq=seq;
+    // Header fields read above may already be torn: checked again in release()
+    return slot->dataSize<=header->slotStride-sizeof(ShmSlotHeader);
+}
+
+bool ShmFrameReader::release(const ShmFrameView &view) const
+{
+    // Everything read from the slot must be done before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.info->seq.load(std::memory_order_relaxed)==view.seq;
+}
+
+uint64_t ShmFrameReader::getMissed() const
+{
+    return missed;
+}
@@ -0,0 +1,83 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* ShmFrameReader.h                                                     */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef SHMFRAMEREADER_H
+#define SHMFRAMEREADER_H
+
+// Reader for the shared-memory frame rings exported by qt-opencv-multithreaded
+// (Options: camera context menu > Export Frames). No Qt/OpenCV needed.
+//
+// Usage:
+//   ShmFrameReader reader;
+//   reader.open("/qt-opencv-frames-0-raw");
+//   ShmFrameView view;
+//   if(reader.acquire(view)) {
+//       ... use view.data (in place, no copy) ...
+//       if(!reader.release(view)) ... frame was overwritten while in use: discard results ...
+//   }
+
+#include "../../ShmFrameRing.h"
+
+#include <stddef.h>
+#include <string>
+
+struct ShmFrameView{
+    const struct ShmSlotHeader *info;   // Frame format, sequence number and capture time
+    const unsigned char *data;          // info->dataSize bytes
+    uint64_t index;
+    uint64_t seq;
+};
+
+class ShmFrameReader
+{
+    public:
+        ShmFrameReader();
+        ~ShmFrameReader();
+        bool open(const std::string &name);
+        void close();
+        bool isOpen() const;
+        // Latest frame not seen yet (false if there is none; reopens a replaced ring)
+        bool acquire(ShmFrameView &view);
+        // True if the frame was intact for the whole time it was used
+        bool release(const ShmFrameView &view) const;
+        // Frames written that were never returned by acquire (reader too slow)
+        uint64_t getMissed() const;
+
+    private:
+        std::string name;
+        const struct ShmRingHeader *header;
+        size_t mappedSize;
+        uint64_t nextIndex;
+        uint64_t missed;
+};
+
+#endif // SHMFRAMEREADER_H
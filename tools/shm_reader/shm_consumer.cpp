@@ -0,0 +1,109 @@
+/************************************************************************/
+/* qt-opencv-multithreaded:                                             */
+/* A multithreaded OpenCV application using the Qt framework.           */
+/*                                                                      */
+/* shm_consumer.cpp                                                     */
+/*                                                                      */
+/* Nick D'Ademo <nickdademo@gmail.com>                                  */
+/*                                                                      */
+/* Copyright (c) 2012-2013 Nick D'Ademo                                 */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files (the "Software"), to deal in the Software without restriction, */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+// Test consumer for the shared-memory frame export: reads the latest frame of a
+// ring as fast as it can and reports rate, missed/torn frames and latency.
+//
+// Usage: shm_consumer [name] [seconds]   (default: /qt-opencv-frames-0-raw, run until killed)
+
+#include "ShmFrameReader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string name=argc>1 ? argv[1] : "/qt-opencv-frames-0-raw";
+    int seconds=argc>2 ? atoi(argv[2]) : 0;
+
+    // Ring may not exist yet (acquire() keeps trying to open it)
+    ShmFrameReader reader;
+    reader.open(name);
+    int64_t start=monotonicUs();
+    int64_t reportTime=start;
+    uint64_t nFrames=0, nTorn=0, lastMissed=0;
+    int64_t latencySum=0;
+    uint32_t checksum=0;
+    while(seconds<=0 || monotonicUs()-start<(int64_t)seconds*1000000)
+    {
+        ShmFrameView view;
+        if(!reader.acquire(view))
+        {
+            if(!reader.isOpen() && monotonicUs()-reportTime>=1000000)
+            {
+                printf("Waiting for %s...\n", name.c_str());
+                reportTime=monotonicUs();
+            }
+            usleep(1000);
+            continue;
+        }
+        // Use the frame in place (touch every cache line, as a real consumer would)
+        for(uint32_t i=0; i<view.info->dataSize; i+=64)
+            checksum+=view.data[i];
+        int64_t latency=monotonicUs()-view.info->timestamp;
+        int width=view.info->width, height=view.info->height, pixelFormat=view.info->pixelFormat;
+        uint64_t sequence=view.info->sequence;
+        // Overwritten while in use: results are not valid
+        if(!reader.release(view))
+        {
+            nTorn++;
+            continue;
+        }
+        nFrames++;
+        latencySum+=latency;
+
+        // Report once per second
+        int64_t now=monotonicUs();
+        if(now-reportTime>=1000000)
+        {
+            printf("%dx%d format %d seq %llu: %.1f fps, latency %.2f ms, missed %llu, torn %llu (checksum %08x)\n",
+                   width, height, pixelFormat, (unsigned long long)sequence,
+                   nFrames*1000000.0/(now-reportTime), nFrames ? latencySum/1000.0/nFrames : 0.0,
+                   (unsigned long long)(reader.getMissed()-lastMissed), (unsigned long long)nTorn, checksum);
+            reportTime=now;
+            nFrames=0;
+            nTorn=0;
+            latencySum=0;
+            lastMissed=reader.getMissed();
+        }
+    }
+    return 0;
+}
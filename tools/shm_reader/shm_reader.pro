@@ -0,0 +1,15 @@
+# Shared-memory frame reader and test consumer (Linux only, no Qt needed)
+TEMPLATE = app
+TARGET = shm_consumer
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+SOURCES += \
+    ShmFrameReader.cpp \
+    shm_consumer.cpp
+
+HEADERS += \
+    ShmFrameReader.h \
+    ../../ShmFrameRing.h
+
+LIBS += -lrt